@@ -0,0 +1,93 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_BENCH_TYPES_HPP__
+#define AFH_BENCH_TYPES_HPP__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+namespace afh {
+namespace bench {
+
+//=============================================================================
+// struct leg;
+// struct order;
+//
+//  Types with a deep member graph.  Moving one leaves every member in an
+//  empty state, so destructing the husk only runs a lot of destructors that
+//  have nothing to do.
+struct leg {
+    std::string                symbol;
+    std::vector<double>        prices;
+    std::unique_ptr<leg>       hedge;
+
+    explicit leg(int i)
+        : symbol("LEG-SYMBOL-" + std::to_string(i))
+        , prices(4, double(i))
+    {}
+};
+
+struct order {
+    std::string                        id;
+    std::string                        account;
+    std::vector<leg>                   legs;
+    std::map<std::string, std::string> tags;
+
+    explicit order(int i)
+        : id("ORDER-ID-" + std::to_string(i) + "-0000000000")
+        , account("ACCOUNT-" + std::to_string(i % 97) + "-0000000000")
+    {
+        legs.emplace_back(i);
+        legs.emplace_back(i + 1);
+        tags.emplace("venue", "XNAS");
+    }
+};
+
+//=============================================================================
+// struct y;
+// struct x;
+//
+//  The X and Y types from the demo, without the output.  Their special
+//  members are user provided, so they are not trivial even though they only
+//  hold scalars.
+struct y {
+    int   m_i;
+    float m_j;
+
+    explicit y(int i) : m_i(i), m_j(float(i)) {}
+    y(y const& o)          : m_i(o.m_i), m_j(o.m_j) {}
+    y(y     && o) noexcept : m_i(o.m_i), m_j(o.m_j) {}
+    y& operator=(y const& o)          { m_i = o.m_i; m_j = o.m_j; return *this; }
+    y& operator=(y     && o) noexcept { m_i = o.m_i; m_j = o.m_j; return *this; }
+    ~y() {}
+};
+
+struct x {
+    int   m_i;
+    float m_j;
+    y     m_y;
+
+    explicit x(int i) : m_i(i), m_j(float(i)), m_y(i + 1) {}
+    x(x const& o)          : m_i(o.m_i), m_j(o.m_j), m_y(o.m_y) {}
+    x(x     && o) noexcept : m_i(o.m_i), m_j(o.m_j), m_y(std::move(o.m_y)) {}
+    x& operator=(x const& o)          { m_i = o.m_i; m_j = o.m_j; m_y = o.m_y; return *this; }
+    x& operator=(x     && o) noexcept { m_i = o.m_i; m_j = o.m_j; m_y = std::move(o.m_y); return *this; }
+    ~x() {}
+};
+
+} // namespace bench
+} // namespace afh
+#endif // #ifndef AFH_BENCH_TYPES_HPP__
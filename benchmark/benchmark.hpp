@@ -0,0 +1,117 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_BENCHMARK_HPP__
+#define AFH_BENCHMARK_HPP__
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace afh {
+namespace bench {
+
+//=============================================================================
+// template <typename T>
+// void do_not_optimize(T const& value);
+//
+//  Stops the optimiser from removing the calculation of value.
+template <typename T>
+inline void do_not_optimize(T const& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char const* sink;
+    sink = reinterpret_cast<char const volatile*>(&value);
+#endif
+}
+
+//=============================================================================
+// struct result;
+//
+//  The timing of one benchmark.  ns_per_op is the best of all the runs.
+struct result {
+    std::string name;
+    std::string variant;
+    std::size_t ops;
+    double      ns_per_op;
+};
+
+//-----------------------------------------------------------------------------
+// template <typename Fn>
+// result run(std::string name, std::string variant, std::size_t ops, Fn&& fn, int runs = 5);
+//
+//  Calls fn() runs times, where each call does ops operations, and records the
+//  fastest time per operation.
+template <typename Fn>
+result run(std::string name, std::string variant, std::size_t ops, Fn&& fn, int runs = 5)
+{
+    using clock = std::chrono::steady_clock;
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        auto start = clock::now();
+        fn();
+        auto stop  = clock::now();
+        double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+        best = std::min(best, ns / double(ops));
+    }
+    return { std::move(name), std::move(variant), ops, best };
+}
+
+//-----------------------------------------------------------------------------
+// template <typename Setup, typename Fn>
+// result run_with_setup(std::string name, std::string variant, std::size_t ops, Setup&& setup, Fn&& fn, int runs = 5);
+//
+//  Same as run(), but calls setup() before each call to fn() without timing
+//  it.
+template <typename Setup, typename Fn>
+result run_with_setup(std::string name, std::string variant, std::size_t ops, Setup&& setup, Fn&& fn, int runs = 5)
+{
+    using clock = std::chrono::steady_clock;
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        setup();
+        auto start = clock::now();
+        fn();
+        auto stop  = clock::now();
+        double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+        best = std::min(best, ns / double(ops));
+    }
+    return { std::move(name), std::move(variant), ops, best };
+}
+
+//-----------------------------------------------------------------------------
+// void write_json(std::ostream& os, std::vector<result> const& results);
+//
+//  Writes the results as a JSON array of objects.
+inline void write_json(std::ostream& os, std::vector<result> const& results)
+{
+    os << "[\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        auto& r = results[i];
+        os << "  {\"name\": \"" << r.name
+           << "\", \"variant\": \"" << r.variant
+           << "\", \"ops\": " << r.ops
+           << ", \"ns_per_op\": " << r.ns_per_op
+           << (i + 1 == results.size() ? "}\n" : "},\n");
+    }
+    os << "]\n";
+}
+
+} // namespace bench
+} // namespace afh
+#endif // #ifndef AFH_BENCHMARK_HPP__
@@ -0,0 +1,105 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares the latency, on the producing thread, of getting rid of an object
+// with a deep destructor: resetting its optional_v2 there, or handing it to
+// an afh::deferred_destroyer that destroys it on a background thread or in a
+// drain() between batches.  Each op is timed on its own, and the p50, p99 and
+// p99.9 latencies are reported as ns_per_op.
+#include "deferred_destroyer.hpp"
+#include "benchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+    std::size_t count = 20000;
+    std::size_t const batch = 256;
+
+    // An order book level: a vector of heap allocated strings.
+    struct deep {
+        explicit deep(int i) : m_orders(32, std::string(40, char('a' + i % 26))) {}
+
+        std::vector<std::string> m_orders;
+    };
+
+    using slot = afh::optional_v2<deep>;
+
+    void add_percentiles(std::vector<afh::bench::result>& results, char const* variant, std::vector<double>& latencies)
+    {
+        std::sort(latencies.begin(), latencies.end());
+        auto at = [&latencies](double fraction) {
+            return latencies[std::min(latencies.size() - 1, std::size_t(fraction * double(latencies.size())))];
+        };
+        results.push_back({ "p50"  , variant, latencies.size(), at(0.5) });
+        results.push_back({ "p99"  , variant, latencies.size(), at(0.99) });
+        results.push_back({ "p99.9", variant, latencies.size(), at(0.999) });
+    }
+
+    // Makes a batch of objects, then times getting rid of each with
+    // destroy(slot&), calling between() after each batch.
+    template <typename Destroy, typename Between>
+    void bench_destroy(std::vector<afh::bench::result>& results, char const* variant, Destroy&& destroy, Between&& between)
+    {
+        using clock = std::chrono::steady_clock;
+        std::vector<double> latencies;
+        latencies.reserve(count);
+        std::vector<slot> slots;
+        slots.reserve(batch);
+        while (latencies.size() < count) {
+            slots.clear();
+            for (std::size_t i = 0; i != batch; ++i) {
+                slots.emplace_back(afh::emplace<deep>(int(i)));
+            }
+            for (auto& s : slots) {
+                auto start = clock::now();
+                destroy(s);
+                auto stop  = clock::now();
+                latencies.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+            }
+            between();
+        }
+        add_percentiles(results, variant, latencies);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::vector<afh::bench::result> results;
+
+    bench_destroy(results, "optional_v2::reset()"
+        , [](slot& s) { s.reset(); }
+        , [] {});
+
+    {
+        afh::deferred_destroyer<deep> destroyer(4 * batch, std::chrono::microseconds(100));
+        bench_destroy(results, "deferred_destroyer, background thread"
+            , [&destroyer](slot& s) { destroyer.defer(s); }
+            , [] {});
+        std::cerr << "background thread overflowed: " << destroyer.overflowed() << '\n';
+    }
+
+    {
+        afh::deferred_destroyer<deep> destroyer(batch);
+        bench_destroy(results, "deferred_destroyer, drain() between batches"
+            , [&destroyer](slot& s) { destroyer.defer(s); }
+            , [&destroyer] { destroyer.drain(); });
+    }
+
+    afh::bench::write_json(std::cout, results);
+}
@@ -0,0 +1,86 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares tearing down a large array of afh::optional_v2<T> with
+// std::destroy() against afh::destroy_range(), for different fractions of
+// live elements scattered among husks.
+#include "relocate.hpp"
+#include "benchmark.hpp"
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+    std::size_t count = 1000000;
+
+    struct entry {
+        explicit entry(int i) : m_name(std::size_t(i % 16 + 24), 'e'), m_values(2, i) {}
+
+        std::string      m_name;
+        std::vector<int> m_values;
+    };
+
+    using slot = afh::optional_v2<entry>;
+
+    // count uninitialised slots.
+    struct table {
+        table() : m_slots(static_cast<slot*>(::operator new(count * sizeof(slot), std::align_val_t(alignof(slot))))) {}
+        ~table() { ::operator delete(m_slots, std::align_val_t(alignof(slot))); }
+
+        slot* m_slots;
+    };
+
+    // Fills the table, leaving live_percent of the slots live, at random, and
+    // the rest as husks that have been moved out of.
+    void fill(table& t, unsigned live_percent)
+    {
+        std::mt19937 rng(42);
+        std::vector<entry> moved;
+        for (std::size_t i = 0; i != count; ++i) {
+            slot* s = new (t.m_slots + i) slot(afh::emplace<entry>(int(i)));
+            if (rng() % 100 >= live_percent) {
+                moved.push_back(std::move(s->value()));
+                s->has_been_moved();
+            }
+        }
+    }
+
+    template <typename Destroy>
+    void bench_destroy(std::vector<afh::bench::result>& results, char const* variant, Destroy&& destroy)
+    {
+        table t;
+        for (unsigned live_percent : { 100u, 50u, 5u }) {
+            std::string const name = "destroy " + std::to_string(live_percent) + "% live";
+            results.push_back(afh::bench::run_with_setup(name, variant, count, [&t, live_percent] {
+                fill(t, live_percent);
+            }, [&t, &destroy] {
+                destroy(t.m_slots, t.m_slots + count);
+                afh::bench::do_not_optimize(t.m_slots);
+            }, 3));
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::vector<afh::bench::result> results;
+    bench_destroy(results, "std::destroy", [](slot* first, slot* last) { std::destroy(first, last); });
+    bench_destroy(results, "afh::destroy_range", [](slot* first, slot* last) { afh::destroy_range(first, last); });
+    afh::bench::write_json(std::cout, results);
+}
@@ -0,0 +1,130 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares afh::sort, afh::stable_sort, afh::nth_element, the afh heap
+// functions and afh::erase_if on an afh::dm_vector<T> against the std ones on a std::vector<T>
+// and a std::vector<afh::optional_v2<T>>, for a type with a deep member
+// graph.
+#include "dm_algorithm.hpp"
+#include "dm_vector.hpp"
+#include "destructively_movable_std.hpp"
+#include "benchmark.hpp"
+#include "bench_types.hpp"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <cstdlib>
+
+using afh::bench::order;
+
+namespace {
+    std::size_t count = 200000;
+
+    struct by_id {
+        bool operator()(order const& a, order const& b) const { return a.id < b.id; }
+    };
+
+    struct std_algorithms {
+        template <typename It> static void sort       (It f, It l)       { std::sort(f, l, by_id()); }
+        template <typename It> static void stable_sort(It f, It l)       { std::stable_sort(f, l, by_id()); }
+        template <typename It> static void nth_element(It f, It n, It l) { std::nth_element(f, n, l, by_id()); }
+        template <typename It> static void push_heap  (It f, It l)       { std::push_heap(f, l, by_id()); }
+        template <typename It> static void pop_heap   (It f, It l)       { std::pop_heap(f, l, by_id()); }
+        template <typename V, typename P> static void erase_if(V& v, P p) { v.erase(std::remove_if(v.begin(), v.end(), p), v.end()); }
+    };
+
+    struct afh_algorithms {
+        template <typename It> static void sort       (It f, It l)       { afh::sort(f, l, by_id()); }
+        template <typename It> static void stable_sort(It f, It l)       { afh::stable_sort(f, l, by_id()); }
+        template <typename It> static void nth_element(It f, It n, It l) { afh::nth_element(f, n, l, by_id()); }
+        template <typename It> static void push_heap  (It f, It l)       { afh::push_heap(f, l, by_id()); }
+        template <typename It> static void pop_heap   (It f, It l)       { afh::pop_heap(f, l, by_id()); }
+        template <typename V, typename P> static void erase_if(V& v, P p) { afh::erase_if(v, p); }
+    };
+
+    template <typename Vector>
+    void fill(Vector& v, std::vector<int> const& keys)
+    {
+        v.clear();
+        v.reserve(keys.size());
+        for (int key : keys) {
+            v.emplace_back(afh::emplace<order>(key));
+        }
+    }
+
+    template <>
+    void fill(std::vector<order>& v, std::vector<int> const& keys)
+    {
+        v.clear();
+        v.reserve(keys.size());
+        for (int key : keys) {
+            v.emplace_back(key);
+        }
+    }
+
+    template <typename Vector, typename Algorithms>
+    void bench_algorithms(std::vector<afh::bench::result>& results, std::vector<int> const& keys, char const* variant)
+    {
+        Vector v;
+        auto setup = [&v, &keys] { fill(v, keys); };
+
+        results.push_back(afh::bench::run_with_setup("sort", variant, count, setup, [&v] {
+            Algorithms::sort(v.data(), v.data() + v.size());
+            afh::bench::do_not_optimize(v.data());
+        }, 3));
+
+        results.push_back(afh::bench::run_with_setup("stable_sort", variant, count, setup, [&v] {
+            Algorithms::stable_sort(v.data(), v.data() + v.size());
+            afh::bench::do_not_optimize(v.data());
+        }, 3));
+
+        results.push_back(afh::bench::run_with_setup("nth_element", variant, count, setup, [&v] {
+            Algorithms::nth_element(v.data(), v.data() + v.size() / 2, v.data() + v.size());
+            afh::bench::do_not_optimize(v.data());
+        }, 3));
+
+        results.push_back(afh::bench::run_with_setup("heap_push_pop", variant, count, setup, [&v] {
+            auto* first = v.data();
+            for (std::size_t i = 1; i <= v.size(); ++i) {
+                Algorithms::push_heap(first, first + i);
+            }
+            for (std::size_t i = v.size(); i > 1; --i) {
+                Algorithms::pop_heap(first, first + i);
+            }
+            afh::bench::do_not_optimize(v.data());
+        }, 3));
+
+        results.push_back(afh::bench::run_with_setup("erase_if", variant, count, setup, [&v] {
+            Algorithms::erase_if(v, [](order const& o) { return o.id.size() % 3 == 0 || o.id[9] == '1'; });
+            afh::bench::do_not_optimize(v.data());
+        }, 3));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::vector<int> keys(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        keys[i] = int(i);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+
+    std::vector<afh::bench::result> results;
+    bench_algorithms<std::vector<order>                  , std_algorithms>(results, keys, "std::vector<T>, std algorithms");
+    bench_algorithms<std::vector<afh::optional_v2<order>>, std_algorithms>(results, keys, "std::vector<optional_v2<T>>, std algorithms");
+    bench_algorithms<afh::dm_vector<order>               , afh_algorithms>(results, keys, "afh::dm_vector<T>, afh algorithms");
+    afh::bench::write_json(std::cout, results);
+}
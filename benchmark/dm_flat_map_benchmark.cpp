@@ -0,0 +1,114 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares afh::dm_flat_map<K, V> against std::unordered_map<K, V> and a
+// SwissTable style map for a value type with a deep member graph.
+#include "dm_flat_map.hpp"
+#include "benchmark.hpp"
+#include "bench_types.hpp"
+#include "swiss_table.hpp"
+#include <unordered_map>
+#include <random>
+#include <algorithm>
+#include <vector>
+
+using afh::bench::order;
+
+namespace {
+    constexpr std::size_t count     = 100000;
+    constexpr std::size_t mixed_ops = 1000000;
+
+    template <typename Map>
+    bool has(Map& map, int key) { return map.find(key) != map.end(); }
+
+    template <typename K, typename V>
+    bool has(afh::bench::swiss_table<K, V>& map, int key) { return map.find(key) != nullptr; }
+
+    struct workload {
+        std::vector<int> keys;      // count distinct keys in random order
+        std::vector<int> mixed;     // keys for the mixed run, about half missing
+        std::vector<int> mixed_op;  // 0-89 lookup, 90-94 erase, 95-99 insert
+
+        workload()
+        {
+            std::mt19937 rng(42);
+            for (std::size_t i = 0; i < count; ++i) {
+                keys.push_back(int(i * 2));
+            }
+            std::shuffle(keys.begin(), keys.end(), rng);
+            std::uniform_int_distribution<int> key_dist(0, int(count * 2));
+            std::uniform_int_distribution<int> op_dist(0, 99);
+            for (std::size_t i = 0; i < mixed_ops; ++i) {
+                mixed.push_back(key_dist(rng));
+                mixed_op.push_back(op_dist(rng));
+            }
+        }
+    };
+
+    template <typename Map>
+    void fill(Map& map, workload const& w)
+    {
+        for (int key : w.keys) {
+            map.try_emplace(key, key);
+        }
+    }
+
+    template <typename Map>
+    void bench_map(std::vector<afh::bench::result>& results, workload const& w, char const* variant)
+    {
+        results.push_back(afh::bench::run("insert", variant, count, [&w] {
+            Map map;
+            fill(map, w);
+            afh::bench::do_not_optimize(map.size());
+        }));
+
+        results.push_back(afh::bench::run("lookup_heavy_mix", variant, mixed_ops, [&w] {
+            Map map;
+            fill(map, w);
+            std::size_t found = 0;
+            for (std::size_t i = 0; i < mixed_ops; ++i) {
+                int key = w.mixed[i];
+                int op  = w.mixed_op[i];
+                if (op < 90) {
+                    found += has(map, key);
+                }
+                else if (op < 95) {
+                    map.erase(key);
+                }
+                else {
+                    map.try_emplace(key, key);
+                }
+            }
+            afh::bench::do_not_optimize(found);
+        }, 3));
+
+        results.push_back(afh::bench::run("insert_then_erase", variant, count, [&w] {
+            Map map;
+            fill(map, w);
+            for (int key : w.keys) {
+                map.erase(key);
+            }
+            afh::bench::do_not_optimize(map.size());
+        }, 3));
+    }
+}
+
+int main()
+{
+    workload w;
+    std::vector<afh::bench::result> results;
+    bench_map<std::unordered_map<int, order>     >(results, w, "std::unordered_map<K, V>");
+    bench_map<afh::bench::swiss_table<int, order>>(results, w, "swiss_table<K, V>");
+    bench_map<afh::dm_flat_map<int, order>       >(results, w, "afh::dm_flat_map<K, V>");
+    afh::bench::write_json(std::cout, results);
+}
@@ -0,0 +1,136 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares moving and invoking afh::dm_function against std::function, for
+// callables that capture an int, a std::string and a large array.
+#include "dm_function.hpp"
+#include "dm_vector.hpp"
+#include "benchmark.hpp"
+#include <array>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+    std::size_t count = 100000;
+
+    // How each kind of callable is made from an int.
+    struct captures_int {
+        static constexpr char const* name = "int capture";
+        static auto make(int i) { return [i](int j) { return i + j; }; }
+    };
+
+    struct captures_string {
+        static constexpr char const* name = "std::string capture";
+        static auto make(int i) { return [s = std::string(std::size_t(i % 8 + 4), 'x')](int j) { return int(s.size()) + j; }; }
+    };
+
+    struct captures_array {
+        static constexpr char const* name = "64 byte capture";
+        static auto make(int i) { return [a = std::array<int, 16>{ i }](int j) { return a[0] + j; }; }
+    };
+
+    // The containers each function type is kept in.
+    template <typename Function>
+    struct std_wrapper {
+        using type   = Function;
+        using vector = std::vector<type>;
+        template <typename Callable> static void push(vector& v, Callable&& c) { v.emplace_back(std::forward<Callable>(c)); }
+        static Function& get(type& f) { return f; }
+    };
+
+    template <typename Function>
+    struct dm_wrapper {
+        using type   = afh::optional_v2<Function>;
+        using vector = afh::dm_vector<Function>;
+        template <typename Callable> static void push(vector& v, Callable&& c) { v.emplace_back(afh::emplace<Function>(std::forward<Callable>(c))); }
+        static Function& get(type& f) { return f.value(); }
+    };
+
+    template <typename Maker, typename W>
+    void fill(typename W::vector& v)
+    {
+        v.clear();
+        v.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            W::push(v, Maker::make(int(i)));
+        }
+    }
+
+    template <typename Maker, typename W>
+    void bench_function(std::vector<afh::bench::result>& results, char const* function_name)
+    {
+        using type   = typename W::type;
+        using vector = typename W::vector;
+        std::string variant = std::string(function_name) + " [" + Maker::name + "]";
+
+        vector source;
+        std::unique_ptr<unsigned char[]> target(new unsigned char[(count + 1) * sizeof(type)]);
+        auto target_data = [&target] {
+            void*       p     = target.get();
+            std::size_t space = (count + 1) * sizeof(type);
+            return static_cast<type*>(std::align(alignof(type), count * sizeof(type), p, space));
+        };
+
+        results.push_back(afh::bench::run_with_setup("move_construct_then_drop", variant, count, [&source] {
+            fill<Maker, W>(source);
+        }, [&source, &target_data] {
+            type* p = target_data();
+            for (std::size_t i = 0; i < count; ++i) {
+                new (p + i) type(std::move(source[i]));
+                afh::bench::do_not_optimize(p + i);
+            }
+            std::destroy(p, p + count);
+        }));
+
+        results.push_back(afh::bench::run("vector_growth", variant, count, [] {
+            vector v;
+            for (std::size_t i = 0; i < count; ++i) {
+                W::push(v, Maker::make(int(i)));
+            }
+            afh::bench::do_not_optimize(v.data());
+        }));
+
+        fill<Maker, W>(source);
+        results.push_back(afh::bench::run("invoke", variant, count, [&source] {
+            int sum = 0;
+            for (auto& f : source) {
+                sum += W::get(f)(1);
+            }
+            afh::bench::do_not_optimize(sum);
+        }));
+    }
+
+    template <typename Maker>
+    void bench_callable(std::vector<afh::bench::result>& results)
+    {
+        bench_function<Maker, std_wrapper<std::function<int(int)>       >>(results, "std::function<int(int)>");
+        bench_function<Maker, dm_wrapper <afh::dm_function<int(int)>    >>(results, "afh::dm_function<int(int)>");
+        bench_function<Maker, dm_wrapper <afh::dm_function<int(int), 48>>>(results, "afh::dm_function<int(int), 48>");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::vector<afh::bench::result> results;
+    bench_callable<captures_int   >(results);
+    bench_callable<captures_string>(results);
+    bench_callable<captures_array >(results);
+    afh::bench::write_json(std::cout, results);
+}
@@ -0,0 +1,78 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares afh::dm_vector<T> against std::vector<T> and
+// std::vector<afh::optional_v2<T>> for a type with a deep member graph.
+#include "dm_vector.hpp"
+#include "benchmark.hpp"
+#include "bench_types.hpp"
+#include <vector>
+
+using afh::bench::order;
+
+namespace {
+    constexpr std::size_t count = 100000;
+
+    template <typename Vector>
+    void grow(Vector& v)
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            v.emplace_back(afh::emplace<order>(int(i)));
+        }
+    }
+
+    template <>
+    void grow(std::vector<order>& v)
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            v.emplace_back(int(i));
+        }
+    }
+
+    // Erase from the front half, so that every erase relocates about
+    // count / 2 elements.
+    template <typename Vector>
+    void erase_front(Vector& v, std::size_t erasures)
+    {
+        for (std::size_t i = 0; i < erasures; ++i) {
+            v.erase(v.begin() + i);
+        }
+    }
+
+    template <typename Vector>
+    void bench_vector(std::vector<afh::bench::result>& results, char const* variant)
+    {
+        results.push_back(afh::bench::run("grow", variant, count, [] {
+            Vector v;
+            grow(v);
+            afh::bench::do_not_optimize(v.data());
+        }));
+
+        constexpr std::size_t erasures = 100;
+        Vector v;
+        grow(v);
+        results.push_back(afh::bench::run("erase_front", variant, erasures * (count / 2), [&v] {
+            erase_front(v, erasures);
+            afh::bench::do_not_optimize(v.data());
+        }, 1));
+    }
+}
+
+int main()
+{
+    std::vector<afh::bench::result> results;
+    bench_vector<std::vector<order>                   >(results, "std::vector<T>");
+    bench_vector<std::vector<afh::optional_v2<order>> >(results, "std::vector<optional_v2<T>>");
+    bench_vector<afh::dm_vector<order>                >(results, "afh::dm_vector<T>");
+    afh::bench::write_json(std::cout, results);
+}
@@ -0,0 +1,106 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares the end of batch cleanup of a scratch table, once every element
+// has been moved out of, between afh::optional_v2_dynarray, which tombstones
+// each element, and afh::optional_v2_epoch_array, whose drop_all() just moves
+// to the next epoch.  ns_per_op is per table slot.
+#include "optional_v2_array.hpp"
+#include "optional_v2_epoch_array.hpp"
+#include "benchmark.hpp"
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+    std::size_t count = 1000000;
+
+    struct entry {
+        explicit entry(int i) : m_key(i), m_values(2, i) {}
+
+        int              m_key;
+        std::vector<int> m_values;
+    };
+
+    // How each table is emptied once its elements have been moved out of.
+    template <typename T>
+    struct dynarray_table {
+        using type = afh::optional_v2_dynarray<T>;
+        static constexpr char const* name = "afh::optional_v2_dynarray<T>";
+        static void drop_all(type& table)
+        {
+            for (std::size_t i = 0, n = table.size(); i != n; ++i) {
+                table.has_been_moved(i);
+            }
+        }
+    };
+
+    template <typename T>
+    struct epoch_table {
+        using type = afh::optional_v2_epoch_array<T>;
+        static constexpr char const* name = "afh::optional_v2_epoch_array<T>";
+        static void drop_all(type& table) { table.drop_all(); }
+    };
+
+    template <typename T> T make(int i) { return T(i); }
+
+    // Moves every element out of table, keeping the last one.
+    template <typename T, typename Table>
+    void drain(Table& table, T& last)
+    {
+        for (std::size_t i = 0, n = table.size(); i != n; ++i) {
+            last = std::move(table[i]);
+        }
+    }
+
+    template <typename T, template <typename> class Table>
+    void bench_table(char const* type_name, std::vector<afh::bench::result>& results)
+    {
+        using table_type = typename Table<T>::type;
+        std::string const variant = std::string(Table<T>::name) + " T=" + type_name;
+
+        table_type table(count);
+        T          last = make<T>(0);
+        results.push_back(afh::bench::run_with_setup("drop_all", variant, count, [&table, &last] {
+            for (std::size_t i = 0; i != count; ++i) {
+                table.emplace(i, make<T>(int(i)));
+            }
+            drain(table, last);
+        }, [&table] {
+            Table<T>::drop_all(table);
+            afh::bench::do_not_optimize(table.data());
+        }));
+
+        results.push_back(afh::bench::run("batch", variant, count, [&table, &last] {
+            for (std::size_t i = 0; i != count; ++i) {
+                table.emplace(i, make<T>(int(i)));
+            }
+            drain(table, last);
+            Table<T>::drop_all(table);
+            afh::bench::do_not_optimize(table.data());
+        }));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::vector<afh::bench::result> results;
+    bench_table<int  , dynarray_table>("int"  , results);
+    bench_table<int  , epoch_table   >("int"  , results);
+    bench_table<entry, dynarray_table>("entry", results);
+    bench_table<entry, epoch_table   >("entry", results);
+    afh::bench::write_json(std::cout, results);
+}
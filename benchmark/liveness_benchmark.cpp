@@ -0,0 +1,107 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares walking a table full of holes one is_tombstoned() call at a time
+// against the liveness kernels over a tombstone bitmap and byte flags, and
+// compaction of a dm_vector against an optional_v2_dynarray.
+#include "dm_vector.hpp"
+#include "optional_v2_array.hpp"
+#include "liveness.hpp"
+#include "benchmark.hpp"
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+    struct record {
+        std::unique_ptr<int> p;
+        std::uint64_t        key;
+        explicit record(std::uint64_t k) : key(k) {}
+    };
+
+    // Every element whose hole[i] is true is moved out.
+    std::vector<bool> make_holes(std::size_t count)
+    {
+        std::mt19937_64   rng(42);
+        std::vector<bool> holes(count);
+        for (std::size_t i = 0; i != count; ++i) {
+            holes[i] = rng() % 2 == 0;
+        }
+        return holes;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t const count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::size_t(1) << 22;
+    std::vector<bool> const holes = make_holes(count);
+
+    afh::dm_vector<record>            slots;
+    afh::optional_v2_dynarray<record> table(count);
+    std::unique_ptr<bool[]>           flags(new bool[count]);
+    slots.reserve(count);
+    for (std::size_t i = 0; i != count; ++i) {
+        slots.emplace_back(i);
+        table.emplace(i, i);
+        flags[i] = holes[i];
+        if (holes[i]) {
+            record moved = std::move(slots[i].value());
+            slots[i].has_been_moved();
+            table.has_been_moved(i);
+        }
+    }
+
+    std::vector<afh::bench::result> results;
+    std::vector<std::uint32_t>      indices(count);
+
+    results.push_back(afh::bench::run("count_live", "optional_v2<T>::is_tombstoned()", count, [&] {
+        std::size_t live = 0;
+        for (auto& slot : slots) {
+            live += !slot.is_tombstoned();
+        }
+        afh::bench::do_not_optimize(live);
+    }));
+    results.push_back(afh::bench::run("count_live", std::string("bitmap/") + afh::liveness_kernels_name(), count, [&] {
+        afh::bench::do_not_optimize(table.count());
+    }));
+    results.push_back(afh::bench::run("count_live", std::string("bytes/") + afh::liveness_kernels_name(), count, [&] {
+        afh::bench::do_not_optimize(afh::count_live(flags.get(), count));
+    }));
+
+    results.push_back(afh::bench::run("live_indices", "optional_v2<T>::is_tombstoned()", count, [&] {
+        std::size_t written = 0;
+        for (std::size_t i = 0; i != count; ++i) {
+            if (!slots[i].is_tombstoned()) {
+                indices[written++] = std::uint32_t(i);
+            }
+        }
+        afh::bench::do_not_optimize(written);
+    }));
+    results.push_back(afh::bench::run("live_indices", std::string("bitmap/") + afh::liveness_kernels_name(), count, [&] {
+        afh::bench::do_not_optimize(table.live_indices(indices.data()));
+    }));
+    results.push_back(afh::bench::run("live_indices", std::string("bytes/") + afh::liveness_kernels_name(), count, [&] {
+        afh::bench::do_not_optimize(afh::live_indices(flags.get(), count, indices.data()));
+    }));
+
+    // Compaction changes the container, so it is only run once.
+    results.push_back(afh::bench::run("compact", "dm_vector<T>", count, [&] {
+        afh::bench::do_not_optimize(slots.compact());
+    }, 1));
+    results.push_back(afh::bench::run("compact", "optional_v2_dynarray<T>", count, [&] {
+        afh::bench::do_not_optimize(table.compact());
+    }, 1));
+
+    afh::bench::write_json(std::cout, results);
+}
@@ -0,0 +1,140 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares a record of four optional members held as an afh::optional_pack
+// against one held as a struct of afh::optional_v2 members: filling,
+// scanning, partly resetting and moving a vector of them.  The size of each
+// record is part of its variant name.
+#include "optional_pack.hpp"
+#include "benchmark.hpp"
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+    std::size_t count = 100000;
+
+    struct payload {
+        explicit payload(int i) : m_values(4, i), m_total(4L * i) {}
+
+        std::vector<int> m_values;
+        long             m_total;
+    };
+
+    struct label {
+        explicit label(int i) : m_text(std::size_t(i % 16 + 8), 'l'), m_id(i) {}
+
+        std::string m_text;
+        int         m_id;
+    };
+
+    // How each record holds its members.
+    struct struct_record {
+        struct type {
+            afh::optional_v2<payload> m_a{afh::tombstone_tag()};
+            afh::optional_v2<payload> m_b{afh::tombstone_tag()};
+            afh::optional_v2<label>   m_c{afh::tombstone_tag()};
+            afh::optional_v2<label>   m_d{afh::tombstone_tag()};
+        };
+        static constexpr char const* name = "struct of afh::optional_v2";
+        static void fill(type& r, int i)
+        {
+            r.m_a.emplace(afh::emplace<payload>(i));
+            r.m_b.emplace(afh::emplace<payload>(i + 1));
+            r.m_c.emplace(afh::emplace<label>(i));
+            r.m_d.emplace(afh::emplace<label>(i + 1));
+        }
+        static int  count_set(type const& r) { return r.m_a.has_value() + r.m_b.has_value() + r.m_c.has_value() + r.m_d.has_value(); }
+        static void reset_some(type& r) { r.m_b.reset(); r.m_d.reset(); }
+    };
+
+    struct pack_record {
+        using type = afh::optional_pack<payload, payload, label, label>;
+        static constexpr char const* name = "afh::optional_pack";
+        static void fill(type& r, int i)
+        {
+            r.emplace<0>(i);
+            r.emplace<1>(i + 1);
+            r.emplace<2>(i);
+            r.emplace<3>(i + 1);
+        }
+        static int  count_set(type const& r) { return r.has_value<0>() + r.has_value<1>() + r.has_value<2>() + r.has_value<3>(); }
+        static void reset_some(type& r) { r.reset<1>(); r.reset<3>(); }
+    };
+
+    template <typename Record>
+    void fill(std::vector<typename Record::type>& v)
+    {
+        v.clear();
+        v.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            Record::fill(v[i], int(i));
+        }
+    }
+
+    template <typename Record>
+    void bench_record(std::vector<afh::bench::result>& results)
+    {
+        using vector = std::vector<typename Record::type>;
+        std::string const variant = std::string(Record::name)
+            + " (sizeof " + std::to_string(sizeof(typename Record::type)) + ")";
+
+        results.push_back(afh::bench::run("fill", variant, count, [] {
+            vector v;
+            fill<Record>(v);
+            afh::bench::do_not_optimize(v.data());
+        }));
+
+        vector records;
+        fill<Record>(records);
+        results.push_back(afh::bench::run("scan", variant, count, [&records] {
+            long set = 0;
+            for (auto const& r : records) {
+                set += Record::count_set(r);
+            }
+            afh::bench::do_not_optimize(set);
+        }));
+
+        results.push_back(afh::bench::run_with_setup("reset_some", variant, count, [&records] {
+            fill<Record>(records);
+        }, [&records] {
+            for (auto& r : records) {
+                Record::reset_some(r);
+            }
+            afh::bench::do_not_optimize(records.data());
+        }));
+
+        vector other;
+        results.push_back(afh::bench::run_with_setup("move", variant, count, [&records, &other] {
+            fill<Record>(records);
+            other.clear();
+            other.reserve(count);
+        }, [&records, &other] {
+            for (auto& r : records) {
+                other.push_back(std::move(r));
+            }
+            afh::bench::do_not_optimize(other.data());
+        }));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::vector<afh::bench::result> results;
+    bench_record<struct_record>(results);
+    bench_record<pack_record  >(results);
+    afh::bench::write_json(std::cout, results);
+}
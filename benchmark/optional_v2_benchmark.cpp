@@ -0,0 +1,192 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares afh::optional_v2<T> against a plain T and std::optional<T> for
+// types that go from trivial to a deep member graph.
+#include "destructively_movable.hpp"
+#include "benchmark.hpp"
+#include "bench_types.hpp"
+#include <optional>
+#include <memory>
+#include <new>
+#include <vector>
+#include <cstdlib>
+
+using afh::bench::x;
+using afh::bench::y;
+using afh::bench::order;
+
+namespace {
+    std::size_t count = 100000;
+
+    // How each wrapper is made from an int and emptied.  A plain T can't be
+    // emptied, so it is moved from instead, leaving a husk behind.
+    template <typename T>
+    struct plain {
+        using type = T;
+        static constexpr char const* name = "T";
+        static type make(int i) { return T(i); }
+        static void reset(type& object) { T dropped(std::move(object)); }
+    };
+
+    template <>
+    struct plain<int> {
+        using type = int;
+        static constexpr char const* name = "T";
+        static type make(int i) { return i; }
+        static void reset(type& object) { object = 0; }
+    };
+
+    template <typename T>
+    struct std_optional {
+        using type = std::optional<T>;
+        static constexpr char const* name = "std::optional<T>";
+        static type make(int i) { return type(std::in_place, i); }
+        static void reset(type& object) { object.reset(); }
+    };
+
+    template <typename T>
+    struct dm_optional {
+        using type = afh::optional_v2<T>;
+        static constexpr char const* name = "afh::optional_v2<T>";
+        static type make(int i) { return type(afh::emplace<T>(i)); }
+        static void reset(type& object) { object.reset(); }
+    };
+
+    // Uninitialized storage for count objects.
+    template <typename W>
+    struct buffer {
+        using type = typename W::type;
+
+        std::unique_ptr<unsigned char[]> m_storage;
+
+        buffer() : m_storage(new unsigned char[(count + 1) * sizeof(type)]) {}
+
+        type* data() noexcept
+        {
+            void*       p     = m_storage.get();
+            std::size_t space = (count + 1) * sizeof(type);
+            return static_cast<type*>(std::align(alignof(type), count * sizeof(type), p, space));
+        }
+    };
+
+    template <typename W>
+    void fill(std::vector<typename W::type>& v)
+    {
+        v.clear();
+        v.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            v.push_back(W::make(int(i)));
+        }
+    }
+
+    template <typename T, template <typename> class Wrapper>
+    void bench_wrapper(std::vector<afh::bench::result>& results, char const* type_name)
+    {
+        using W    = Wrapper<T>;
+        using type = typename W::type;
+        std::string variant = std::string(W::name) + " [T = " + type_name + "]";
+
+        results.push_back(afh::bench::run("construct", variant, count, [] {
+            buffer<W> b;
+            type*     p = b.data();
+            for (std::size_t i = 0; i < count; ++i) {
+                new (p + i) type(W::make(int(i)));
+                afh::bench::do_not_optimize(p + i);
+            }
+            std::destroy(p, p + count);
+        }));
+
+        // The source husks are destroyed in the timed loop, as that's the
+        // cost optional_v2 is meant to cut.
+        buffer<W> from;
+        buffer<W> target;
+        results.push_back(afh::bench::run_with_setup("move_construct_then_drop", variant, count, [&from] {
+            type* s = from.data();
+            for (std::size_t i = 0; i < count; ++i) {
+                new (s + i) type(W::make(int(i)));
+            }
+        }, [&from, &target] {
+            type* s = from.data();
+            type* p = target.data();
+            for (std::size_t i = 0; i < count; ++i) {
+                new (p + i) type(std::move(s[i]));
+                std::destroy_at(s + i);
+                afh::bench::do_not_optimize(p + i);
+            }
+            std::destroy(p, p + count);
+        }));
+
+        std::vector<type> source;
+
+        std::vector<type> other;
+        results.push_back(afh::bench::run_with_setup("assign", variant, count, [&source, &other] {
+            fill<W>(source);
+            fill<W>(other);
+        }, [&source, &other] {
+            for (std::size_t i = 0; i < count; ++i) {
+                source[i] = std::move(other[i]);
+            }
+            afh::bench::do_not_optimize(source.data());
+        }));
+
+        results.push_back(afh::bench::run_with_setup("swap", variant, count, [&source, &other] {
+            fill<W>(source);
+            fill<W>(other);
+        }, [&source, &other] {
+            using std::swap;
+            for (std::size_t i = 0; i < count; ++i) {
+                swap(source[i], other[count - 1 - i]);
+            }
+            afh::bench::do_not_optimize(source.data());
+        }));
+
+        results.push_back(afh::bench::run_with_setup("reset", variant, count, [&source] {
+            fill<W>(source);
+        }, [&source] {
+            for (std::size_t i = 0; i < count; ++i) {
+                W::reset(source[i]);
+            }
+            afh::bench::do_not_optimize(source.data());
+        }));
+
+        results.push_back(afh::bench::run("vector_growth", variant, count, [] {
+            std::vector<type> v;
+            for (std::size_t i = 0; i < count; ++i) {
+                v.push_back(W::make(int(i)));
+            }
+            afh::bench::do_not_optimize(v.data());
+        }));
+    }
+
+    template <typename T>
+    void bench_type(std::vector<afh::bench::result>& results, char const* type_name)
+    {
+        bench_wrapper<T, plain       >(results, type_name);
+        bench_wrapper<T, std_optional>(results, type_name);
+        bench_wrapper<T, dm_optional >(results, type_name);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::vector<afh::bench::result> results;
+    bench_type<int  >(results, "int");
+    bench_type<y    >(results, "y");
+    bench_type<x    >(results, "x");
+    bench_type<order>(results, "order");
+    afh::bench::write_json(std::cout, results);
+}
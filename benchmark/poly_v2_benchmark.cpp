@@ -0,0 +1,137 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Compares a queue of polymorphic messages held as afh::poly_v2<message>
+// against one of std::unique_ptr<message>: making them, dispatching them and
+// handing them over to another queue.
+#include "poly_v2.hpp"
+#include "dm_vector.hpp"
+#include "benchmark.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+    std::size_t count = 100000;
+
+    struct message {
+        explicit message(int id) : m_id(id) {}
+        virtual ~message() = default;
+        virtual long handle() const = 0;
+
+        int m_id;
+    };
+
+    struct tick : message {
+        explicit tick(int id) : message(id), m_time(id * 3) {}
+        long handle() const override { return m_time; }
+
+        long m_time;
+    };
+
+    struct text : message {
+        explicit text(int id) : message(id), m_text(std::size_t(id % 16 + 8), 't') {}
+        long handle() const override { return long(m_text.size()); }
+
+        std::string m_text;
+    };
+
+    // How each queue holds a message.
+    struct unique_ptr_queue {
+        using vector = std::vector<std::unique_ptr<message>>;
+        static constexpr char const* name = "std::vector<std::unique_ptr<message>>";
+        template <typename Message> static void push(vector& v, int id) { v.push_back(std::make_unique<Message>(id)); }
+        static message const& get(std::unique_ptr<message> const& m) { return *m; }
+        static void hand_over(vector& to, std::unique_ptr<message>& m) { to.push_back(std::move(m)); }
+    };
+
+    struct poly_v2_queue {
+        using vector = std::vector<afh::poly_v2<message>>;
+        static constexpr char const* name = "std::vector<afh::poly_v2<message>>";
+        template <typename Message> static void push(vector& v, int id) { v.emplace_back(std::in_place_type<Message>, id); }
+        static message const& get(afh::poly_v2<message> const& m) { return *m; }
+        static void hand_over(vector& to, afh::poly_v2<message>& m) { to.push_back(std::move(m)); }
+    };
+
+    struct dm_vector_queue {
+        using vector = afh::dm_vector<afh::poly_v2<message>>;
+        static constexpr char const* name = "afh::dm_vector<afh::poly_v2<message>>";
+        template <typename Message> static void push(vector& v, int id) { v.emplace_back(afh::emplace<afh::poly_v2<message>>(std::in_place_type<Message>, id)); }
+        static message const& get(afh::optional_v2<afh::poly_v2<message>> const& m) { return *m.value(); }
+        static void hand_over(vector& to, afh::optional_v2<afh::poly_v2<message>>& m) { to.emplace_back(std::move(m)); }
+    };
+
+    template <typename Queue>
+    void fill(typename Queue::vector& v)
+    {
+        v.clear();
+        v.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            if (i % 2) {
+                Queue::template push<tick>(v, int(i));
+            }
+            else {
+                Queue::template push<text>(v, int(i));
+            }
+        }
+    }
+
+    template <typename Queue>
+    void bench_queue(std::vector<afh::bench::result>& results)
+    {
+        using vector = typename Queue::vector;
+        char const* variant = Queue::name;
+
+        results.push_back(afh::bench::run("make", variant, count, [] {
+            vector v;
+            fill<Queue>(v);
+            afh::bench::do_not_optimize(v.data());
+        }));
+
+        vector queue;
+        fill<Queue>(queue);
+        results.push_back(afh::bench::run("dispatch", variant, count, [&queue] {
+            long sum = 0;
+            for (auto const& m : queue) {
+                sum += Queue::get(m).handle();
+            }
+            afh::bench::do_not_optimize(sum);
+        }));
+
+        vector other;
+        results.push_back(afh::bench::run_with_setup("hand_over", variant, count, [&queue, &other] {
+            fill<Queue>(queue);
+            other.clear();
+            other.reserve(count);
+        }, [&queue, &other] {
+            for (auto& m : queue) {
+                Queue::hand_over(other, m);
+            }
+            queue.clear();
+            afh::bench::do_not_optimize(other.data());
+        }));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::vector<afh::bench::result> results;
+    bench_queue<unique_ptr_queue>(results);
+    bench_queue<poly_v2_queue   >(results);
+    bench_queue<dm_vector_queue >(results);
+    afh::bench::write_json(std::cout, results);
+}
@@ -0,0 +1,204 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_SWISS_TABLE_HPP__
+#define AFH_SWISS_TABLE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#include <functional>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace afh {
+namespace bench {
+
+//=============================================================================
+// template <typename K, typename V, typename Hash = std::hash<K>>
+// class swiss_table;
+//
+//  A minimal SwissTable style map to compare against.  A separate array of
+//  control bytes holds 7 bits of the hash of each full slot, or an empty or
+//  deleted marker, and lookups scan 16 control bytes at a time.  Erasing
+//  leaves a deleted marker and moves are ordinary moves followed by
+//  destructor calls.  Only what the benchmarks use is implemented.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class swiss_table
+{
+public:
+    using value_type = std::pair<K, V>;
+
+    swiss_table() = default;
+    swiss_table(swiss_table const&) = delete;
+    swiss_table& operator=(swiss_table const&) = delete;
+
+    ~swiss_table()
+    {
+        destroy();
+    }
+
+    std::size_t size() const noexcept { return m_size; }
+
+    value_type* find(K const& key) noexcept
+    {
+        if (m_capacity == 0) {
+            return nullptr;
+        }
+        std::size_t hash = mix(key);
+        auto        h2   = std::int8_t(hash & 0x7f);
+        for (std::size_t pos = h1(hash), step = 0; ; step += group_size, pos = (pos + step) & (m_capacity - 1)) {
+            for (unsigned match = match_byte(pos, h2); match; match &= match - 1) {
+                std::size_t i = (pos + countr_zero(match)) & (m_capacity - 1);
+                if (m_slots[i].first == key) {
+                    return m_slots + i;
+                }
+            }
+            if (match_byte(pos, empty)) {
+                return nullptr;
+            }
+        }
+    }
+
+    template <typename...Ts>
+    std::pair<value_type*, bool> try_emplace(K const& key, Ts&&...args)
+    {
+        if (value_type* found = find(key)) {
+            return { found, false };
+        }
+        if ((m_size + m_deleted + 1) * 8 > m_capacity * 7) {
+            rehash(m_capacity ? m_capacity * 2 : group_size);
+        }
+        std::size_t hash = mix(key);
+        std::size_t i    = find_free(hash);
+        if (m_ctrl[i] == deleted) {
+            --m_deleted;
+        }
+        set_ctrl(i, std::int8_t(hash & 0x7f));
+        new (m_slots + i) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Ts>(args)...));
+        ++m_size;
+        return { m_slots + i, true };
+    }
+
+    std::size_t erase(K const& key)
+    {
+        value_type* found = find(key);
+        if (!found) {
+            return 0;
+        }
+        std::size_t i = found - m_slots;
+        found->~value_type();
+        set_ctrl(i, deleted);
+        --m_size;
+        ++m_deleted;
+        return 1;
+    }
+
+private:
+    static constexpr std::size_t group_size = 16;
+    static constexpr std::int8_t empty      = -128;
+    static constexpr std::int8_t deleted    = -2;
+
+    std::size_t mix(K const& key) const noexcept
+    {
+        return std::size_t(std::uint64_t(Hash()(key)) * 0x9E3779B97F4A7C15ull);
+    }
+
+    std::size_t h1(std::size_t hash) const noexcept
+    {
+        return (hash >> 7) & (m_capacity - 1);
+    }
+
+    static unsigned countr_zero(unsigned x) noexcept
+    {
+        return unsigned(__builtin_ctz(x));
+    }
+
+    // Bit n is set if control byte pos + n is value.  The control array has
+    // a copy of the first group after the end, so that a group never wraps.
+    unsigned match_byte(std::size_t pos, std::int8_t value) const noexcept
+    {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<__m128i const*>(m_ctrl + pos));
+        return unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value))));
+#else
+        unsigned result = 0;
+        for (unsigned n = 0; n < group_size; ++n) {
+            result |= unsigned(m_ctrl[pos + n] == value) << n;
+        }
+        return result;
+#endif
+    }
+
+    std::size_t find_free(std::size_t hash) const noexcept
+    {
+        for (std::size_t pos = h1(hash), step = 0; ; step += group_size, pos = (pos + step) & (m_capacity - 1)) {
+            unsigned match = match_byte(pos, empty) | match_byte(pos, deleted);
+            if (match) {
+                return (pos + countr_zero(match)) & (m_capacity - 1);
+            }
+        }
+    }
+
+    void set_ctrl(std::size_t i, std::int8_t value) noexcept
+    {
+        m_ctrl[i] = value;
+        if (i < group_size) {
+            m_ctrl[m_capacity + i] = value;
+        }
+    }
+
+    void rehash(std::size_t new_capacity)
+    {
+        std::int8_t* old_ctrl     = std::exchange(m_ctrl, new std::int8_t[new_capacity + group_size]);
+        value_type*  old_slots    = std::exchange(m_slots, static_cast<value_type*>(::operator new(new_capacity * sizeof(value_type))));
+        std::size_t  old_capacity = std::exchange(m_capacity, new_capacity);
+        std::memset(m_ctrl, empty, new_capacity + group_size);
+        m_deleted = 0;
+        for (std::size_t i = 0; i < old_capacity; ++i) {
+            if (old_ctrl[i] >= 0) {
+                std::size_t hash = mix(old_slots[i].first);
+                std::size_t j    = find_free(hash);
+                set_ctrl(j, std::int8_t(hash & 0x7f));
+                new (m_slots + j) value_type(std::move(old_slots[i]));
+                old_slots[i].~value_type();
+            }
+        }
+        delete[] old_ctrl;
+        ::operator delete(old_slots);
+    }
+
+    void destroy() noexcept
+    {
+        for (std::size_t i = 0; i < m_capacity; ++i) {
+            if (m_ctrl[i] >= 0) {
+                m_slots[i].~value_type();
+            }
+        }
+        delete[] m_ctrl;
+        ::operator delete(m_slots);
+    }
+
+    std::int8_t* m_ctrl     = nullptr;
+    value_type*  m_slots    = nullptr;
+    std::size_t  m_capacity = 0;
+    std::size_t  m_size     = 0;
+    std::size_t  m_deleted  = 0;
+};
+
+} // namespace bench
+} // namespace afh
+#endif // #ifndef AFH_SWISS_TABLE_HPP__
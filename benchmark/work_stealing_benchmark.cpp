@@ -0,0 +1,156 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Measures how afh::work_stealing_pool scales from 1 thread up to the number
+// of hardware threads, against a pool sharing one locked std::deque, on a
+// fork/join tree of tasks that capture a string and a buffer.
+#include "work_stealing_pool.hpp"
+#include "benchmark.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    int depth = 14; // 2^(depth + 1) - 1 tasks per tree
+
+    //-------------------------------------------------------------------------
+    // A pool whose workers take tasks from one std::deque behind a mutex,
+    // moving each task out and destructing the husk.
+    class locked_queue_pool
+    {
+    public:
+        explicit locked_queue_pool(std::size_t threads)
+        {
+            for (std::size_t i = 0; i < threads; ++i) {
+                m_threads.emplace_back([this] { work(); });
+            }
+        }
+
+        ~locked_queue_pool()
+        {
+            wait_idle();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (auto& t : m_threads) {
+                t.join();
+            }
+        }
+
+        template <typename Fn>
+        void submit(Fn&& fn)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_pending;
+                m_tasks.emplace_back(std::forward<Fn>(fn));
+            }
+            m_wake.notify_one();
+        }
+
+        void wait_idle()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this] { return m_pending == 0; });
+        }
+
+    private:
+        void work()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (;;) {
+                m_wake.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+                if (m_tasks.empty()) {
+                    return;
+                }
+                std::function<void()> task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+                lock.unlock();
+                task();
+                task = nullptr;
+                lock.lock();
+                if (--m_pending == 0) {
+                    m_idle.notify_all();
+                }
+            }
+        }
+
+        std::vector<std::thread>          m_threads;
+        std::deque<std::function<void()>> m_tasks;
+        std::size_t                       m_pending = 0;
+        bool                              m_stop    = false;
+        std::mutex                        m_mutex;
+        std::condition_variable           m_wake;
+        std::condition_variable           m_idle;
+    };
+
+    std::atomic<long> checksum{ 0 };
+
+    template <typename Pool>
+    void spawn(Pool& pool, int level, std::string label, std::vector<int> buffer)
+    {
+        if (level == 0) {
+            checksum.fetch_add(long(label.size()) + std::accumulate(buffer.begin(), buffer.end(), 0L), std::memory_order_relaxed);
+            return;
+        }
+        for (int child = 0; child < 2; ++child) {
+            buffer[std::size_t(level) % buffer.size()] += child;
+            pool.submit([&pool, level, label = label + char('0' + child), buffer]() mutable {
+                spawn(pool, level - 1, std::move(label), std::move(buffer));
+            });
+        }
+    }
+
+    template <typename Pool>
+    void bench_pool(std::vector<afh::bench::result>& results, std::size_t threads, char const* variant)
+    {
+        std::size_t tasks = (std::size_t(2) << depth) - 1;
+        Pool pool(threads);
+        results.push_back(afh::bench::run("fork_join_" + std::to_string(threads) + "_threads", variant, tasks, [&pool] {
+            pool.submit([&pool] { spawn(pool, depth, std::string(24, 'a'), std::vector<int>(32, 1)); });
+            pool.wait_idle();
+            afh::bench::do_not_optimize(checksum);
+        }, 3));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        depth = std::atoi(argv[1]);
+    }
+    std::size_t max_threads = std::thread::hardware_concurrency();
+    max_threads = max_threads ? max_threads : 1;
+
+    std::vector<std::size_t> thread_counts;
+    for (std::size_t threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::vector<afh::bench::result> results;
+    for (std::size_t threads : thread_counts) {
+        bench_pool<locked_queue_pool                             >(results, threads, "std::deque behind a mutex");
+        bench_pool<afh::work_stealing_pool<std::function<void()>>>(results, threads, "afh::work_stealing_pool");
+    }
+    afh::bench::write_json(std::cout, results);
+}
@@ -0,0 +1,163 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DEFERRED_DESTROYER_HPP__
+#define AFH_DEFERRED_DESTROYER_HPP__
+
+#include "destructively_movable.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+namespace afh {
+
+//=============================================================================
+// template <typename T>
+// class deferred_destroyer;
+//
+//  Takes objects that have to be destroyed off a latency critical thread.
+//  Deferring relocates the value out of its optional_v2<T> slot into an
+//  spsc_ring<T> with relocate_at(), which is a memcpy if T
+//  is_trivially_relocatable, leaving the slot tombstoned.  The real
+//  destructors are run later, in batches, on the values where they sit in
+//  the ring (spsc_ring::discard_n()), by either a background thread or calls
+//  to drain().
+//
+//  Deferring is lock-free and must only be done from one thread at a time.
+//  The ring's capacity is the backpressure limit: once that many values are
+//  waiting, try_defer() refuses more and defer() destroys the value on the
+//  calling thread instead.
+//
+////
+// Members
+////
+//  explicit deferred_destroyer(size_type capacity);
+//
+//   Values are only destroyed by drain().  capacity is rounded up to a power
+//   of 2, as for spsc_ring.
+//
+//  deferred_destroyer(size_type capacity
+//      , std::chrono::microseconds poll, size_type batch = 64);
+//
+//   Starts a background thread that destroys up to batch values at a time,
+//   sleeping for poll whenever there are none.
+//
+//  bool try_defer(optional_v2<T>& slot);
+//
+//   Relocates slot's value to the queue and returns true, or returns false,
+//   leaving slot alone, if the queue is full.  A tombstoned slot is left
+//   alone and true is returned.
+//
+//  void defer(optional_v2<T>& slot);
+//
+//   As try_defer(), but if the queue is full, slot is reset on the calling
+//   thread and overflowed() is incremented.
+//
+//  size_type drain(size_type max = -1);
+//
+//   Destroys up to max of the queued values on the calling thread and
+//   returns how many were destroyed.  Must not be used while there is a
+//   background thread.
+//
+//  size_type depth() const noexcept;
+//
+//   The number of values waiting to be destroyed.  Approximate while the
+//   other side is busy.
+//
+//  size_type overflowed() const noexcept;
+//
+//   The number of values defer() had to destroy itself.
+//
+//  The destructor stops the background thread, if any, and destroys what is
+//  left in the queue.
+template <typename T>
+class deferred_destroyer
+{
+public:
+    using value_type = optional_v2<T>;
+    using contained  = T;
+    using size_type  = std::size_t;
+
+    explicit deferred_destroyer(size_type capacity)
+        : m_ring(capacity)
+    {}
+
+    deferred_destroyer(size_type capacity, std::chrono::microseconds poll, size_type batch = 64)
+        : m_ring(capacity)
+    {
+        m_thread = std::thread([this, poll, batch] {
+            while (!m_stop.load(std::memory_order_acquire)) {
+                if (m_ring.discard_n(batch) == 0) {
+                    std::this_thread::sleep_for(poll);
+                }
+            }
+        });
+    }
+
+    deferred_destroyer(deferred_destroyer const&) = delete;
+    deferred_destroyer& operator=(deferred_destroyer const&) = delete;
+
+    ~deferred_destroyer()
+    {
+        if (m_thread.joinable()) {
+            m_stop.store(true, std::memory_order_release);
+            m_thread.join();
+        }
+    }
+
+    bool try_defer(value_type& slot)
+    {
+        if (!slot.has_value()) {
+            return true;
+        }
+        if (!m_ring.try_relocate(std::addressof(slot))) {
+            return false;
+        }
+        // relocate_at() left the caller's slot uninitialised.
+        new (std::addressof(slot)) value_type(tombstone_tag{});
+        return true;
+    }
+
+    void defer(value_type& slot)
+    {
+        if (!try_defer(slot)) {
+            slot.reset();
+            m_overflowed.store(m_overflowed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    size_type drain(size_type max = size_type(-1))
+    {
+        assert(!m_thread.joinable());
+        return m_ring.discard_n(max);
+    }
+
+    size_type depth     () const noexcept { return m_ring.size(); }
+    size_type capacity  () const noexcept { return m_ring.capacity(); }
+    size_type overflowed() const noexcept { return m_overflowed.load(std::memory_order_relaxed); }
+
+private:
+    spsc_ring<T>           m_ring;
+    std::atomic<size_type> m_overflowed{ 0 };
+    std::atomic<bool>      m_stop{ false };
+    std::thread            m_thread;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_DEFERRED_DESTROYER_HPP__
@@ -13,6 +13,7 @@
 
 // destructive_move.cpp : This file contains the 'main' function. Program execution begins and ends there.
 //
+#include "destructively_movable_std.hpp"
 #include "destructively_movable.hpp"
 #include <iostream>
 
@@ -104,12 +105,74 @@ std::ostream& operator<<(std::ostream& os, T const& obj)
 }
 
 template <>
-struct ::afh::destructively_movable_traits<X>
+struct afh::destructively_movable_traits<X>
 {
     using Tombstone_functions = void;
     //constexpr static auto destructive_move_exempt = afh::destructive_move_exempt(&X::m_i, &X::m_j);
 };
 
+// Has a tombstone of m_id being 0.
+struct Message {
+    int         m_id;
+    std::string m_text;
+    using Tombstone_functions = afh::tombstone_via_member<&Message::m_id>;
+};
+static_assert(sizeof(afh::optional_v2<Message>) == sizeof(Message), "");
+
+// Has a tombstone of m_next having its low bit set, as m_next can be null.
+struct Node {
+    Node*       m_next;
+    std::string m_name;
+};
+
+template <>
+struct afh::destructively_movable_traits<Node>
+{
+    using Tombstone_functions = afh::tombstone_via_low_bit<&Node::m_next>;
+};
+static_assert(sizeof(afh::optional_v2<Node>) == sizeof(Node), "");
+
+// Has a tombstone flag in the tail padding after m_i.
+struct Padded {
+    std::string m_s;
+    int         m_i;
+    static constexpr bool tombstone_in_tail_padding = true;
+};
+static_assert(afh::optional_v2_layout<Padded >::kind == afh::optional_v2_layout_kind::tail_padding_tombstone, "");
+static_assert(afh::optional_v2_layout<Padded >::overhead == 0, "");
+static_assert(afh::optional_v2_layout<Message>::kind == afh::optional_v2_layout_kind::internal_tombstone, "");
+static_assert(afh::optional_v2_layout<Message>::overhead == 0, "");
+
+// Checks that the internal tombstone of T is only set when the optional_v2
+// has been moved from, reset or tombstone constructed.  other is another live
+// value, e.g. one in the moved from state of T.
+template <typename T>
+void check_tombstone(T value, T other)
+{
+    afh::optional_v2<T> a(std::move(value));
+    afh::optional_v2<T> e(std::move(other));
+    assert(a.has_value() && e.has_value());
+
+    // Moved by the optional_v2.
+    afh::optional_v2<T> b(std::move(a));
+    assert(a.is_tombstoned() && b.has_value());
+    a = std::move(b);
+    assert(a.has_value() && b.is_tombstoned());
+
+    // Moved without the optional_v2 knowing about it.
+    T taken(std::move(a).value());
+    assert(a.has_value());
+    a.has_been_moved();
+    assert(a.is_tombstoned());
+
+    afh::optional_v2<T> c(afh::tombstone_tag{});
+    assert(c.is_tombstoned());
+    c = std::move(taken);
+    assert(c.has_value());
+    c.reset();
+    assert(c.is_tombstoned());
+}
+
 template <bool TL, typename T> decltype(auto) make_lvalue_conditionally(T&& x) { return static_cast<std::conditional_t<TL, T&, T&&>>(x); }
 
 // T is what is being passed in.
@@ -126,6 +189,20 @@ int main()
 {
     static_assert(std::is_void_v<afh::optional_v2_tombstone_functions<X>>, "");
     static_assert(!std::is_trivially_destructible_v<X>, "");
+    static_assert(afh::optional_v2_layout<X>::kind == afh::optional_v2_layout_kind::external_tombstone, "");
+    std::cout << "optional_v2<X> layout: " << afh::optional_v2_layout<X>::kind_name
+        << ", " << afh::optional_v2_layout<X>::overhead << " bytes overhead\n";
+
+    check_tombstone<std::string         >("a string that won't fit in the local buffer", "");
+    check_tombstone<std::string         >("short", "");
+    check_tombstone<std::wstring        >(L"a string that won't fit in the local buffer", L"");
+    check_tombstone<std::vector<int>    >({ 1, 2, 3 }, {});
+    check_tombstone<std::vector<bool>   >({ true, false }, {});
+    check_tombstone<std::unique_ptr<int>>(std::make_unique<int>(1), nullptr);
+    check_tombstone<std::shared_ptr<int>>(std::make_shared<int>(1), nullptr);
+    check_tombstone<Message             >({ 1, "text" }, { 2, "" });
+    check_tombstone<Node                >({ nullptr, "head" }, { nullptr, "" });
+    check_tombstone<Padded              >({ "a string that won't fit in the local buffer", 1 }, { "", 2 });
 
     afh::optional_v2<X> x;
     std::cout << "\n--] lvalues [----------\n";
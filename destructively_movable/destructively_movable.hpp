@@ -15,9 +15,12 @@
 #define AFH_DESTRUCTIVE_MOVE_HPP__
 
 #include "utility.hpp"
+#include "trace.hpp"
+#include "dm_stats.hpp"
 #include <new> // for launder
 #include <tuple>
 #include <cwchar>
+#include <cstdint>
 #include <cassert>
 
 namespace afh {
@@ -47,7 +50,7 @@ struct emplace_params
     template <std::size_t I, typename...Us>
     friend constexpr auto&& get(emplace_params<Us...>& params);
 
-    constexpr emplace_params(Ts&&...args)
+    constexpr emplace_params(Ts&&...args) noexcept
         : ref_storage(std::forward<Ts>(args)...)
     {}
 
@@ -118,7 +121,7 @@ private:
 //  If nither of these options sound good, then consider constructing them on
 //  the fly.
 template <typename T, typename const_tag = make_lvalue_const_tag, typename...Ts>
-constexpr auto emplace(Ts&& ...args)
+constexpr auto emplace(Ts&& ...args) noexcept
 {
     return emplace_params<T, const_tag, Ts...>(std::forward<Ts>(args)...);
 }
@@ -179,14 +182,21 @@ struct tombstone_tag {};
 //   Declaring this means that the object has an internal tombstone marker.
 //   This function object, states if that tombstone marker is set (first two
 //   overloads) or will explictly set it (last two overloads).
+//   afh::tombstone_via_member<&X::m> and afh::tombstone_via_low_bit<&X::m>
+//   generate all of these from a single member.
 //
 //   The getters are used to confirm the state in debug mode, and when
 //   determining if there is an object there to delete or assign to a
-//   optional_v2.  The setters are only used when the
-//   optional_v2 object is initialised with the tombstone_tag object
-//   (means that the type is not constructed at definition).
-//
-//   When the contents of an object is moved, the getter must return false.
+//   optional_v2.  The setters are used when the optional_v2 object is
+//   initialised with the tombstone_tag object (means that the type is not
+//   constructed at definition), after it has been reset() and after its
+//   contents have been moved out by the optional_v2 (or has_been_moved() is
+//   called).  So a setter must work on uninitialised memory as well as on a
+//   moved from object, and the getter must return false for every live
+//   object.  destructively_movable_std.hpp has ready made ones for some
+//   standard library types.
+//
+//   When the contents of an object is moved, the getter may return true.
 //   This state doesn't invalidate the "valid but otherwise indeterminate
 //   state" mantra.  This tombstoned state is part of that state.  If,
 //   however, the Contained class is never used without the
@@ -221,12 +231,65 @@ struct tombstone_tag {};
 //         are defined in the class, so they would be destroyed in the same
 //         order as if the destructor called it.  Shouldn't be really necessary,
 //         but may prevent possible weirdness.
+//
+////
+//  is_trivially_relocatable (optional constexpr static bool, default
+//  std::is_trivially_copyable_v<T>)
+//
+//   Specifies that moving an object to a new address and then dropping the
+//   source on the floor has the same effect as copying its bytes.  Most types
+//   that don't hold a pointer to themselves or to one of their members are
+//   like this, even if they are not trivially copyable (std::unique_ptr,
+//   most std::vector implementations, etc.).  When set, the relocation
+//   algorithms in relocate.hpp use memcpy/memmove instead of a move
+//   constructor followed by a tombstone write.
+//
+////
+//  tombstone_in_tail_padding (optional constexpr static bool, default false)
+//
+//   Specifies that the last byte of the object is tail padding that nothing
+//   writes to, so that an external tombstone can be stored there instead of
+//   in a bool appended to the object.  sizeof(optional_v2<T>) is then
+//   sizeof(T).  Only used if there is no Tombstone_functions trait and T is
+//   not trivially destructible.
+//
+//   NOTE: The library can't check this, and nothing in standard C++ makes
+//         padding stable, so this is the user's promise, not something that
+//         is proven.  Don't set it unless the last member ends before the
+//         last byte, and T is never assigned to as a whole (such as
+//         *opt = t) other than through optional_v2's assignment operators, as
+//         a copy of the whole object may copy padding too.  optional_v2's own
+//         assignments rewrite the flag afterwards.  A type derived from T can
+//         put its own members in that padding (the Itanium C++ ABI does), so
+//         emplacing a derived type into an optional_v2<T> fails to compile
+//         when this is set.
+//
+////
+//  Trace_policy (optional type, default AFH_OPTIONAL_V2_TRACE_POLICY)
+//
+//   A type with a static trace(trace_event, void const volatile*, char const*)
+//   function that is told about the lifecycle events of each optional_v2<T>
+//   (see trace.hpp).  The default, afh::no_trace, is never called.
+//   afh::trace_ring<> (in trace_ring.hpp) records them in per thread ring
+//   buffers.
+//
+////
+//  collect_stats (optional constexpr static bool, default AFH_DM_STATS)
+//
+//   Specifies that afh::dm_stats<T> counts the constructions, destructive
+//   moves, elided destructions and tombstone checks of each optional_v2<T>
+//   (see dm_stats.hpp).  When false, nothing is counted and nothing is added
+//   to the generated code.
 template <typename T>
 struct destructively_movable_traits
 {
     using Tombstone_functions = void;
     // static constexpr bool is_destructive_move_disabled = true;
+    // static constexpr bool tombstone_in_tail_padding = true;
     // static constexpr auto destructive_move_exempt = afh::destructive_move_exempt(&X::m_i, &X::m_j);
+    // static constexpr bool is_trivially_relocatable = true;
+    // using Trace_policy = afh::trace_ring<>;
+    // static constexpr bool collect_stats = true;
 };
 
 //-----------------------------------------------------------------------------
@@ -264,7 +327,7 @@ namespace detail {
             for_each(Take_from::destructive_move_exempt, fn);
         }
 
-        static constexpr bool is_empty = std::tuple_size_v<decltype(Take_from::destructive_move_exempt)> = 0;
+        static constexpr bool is_empty = std::tuple_size_v<decltype(Take_from::destructive_move_exempt)> == 0;
     };
 
     template <typename T, typename = void>
@@ -317,7 +380,7 @@ namespace detail {
 
     template <typename T>
     struct has_tombstone_functions<T
-        , std::void_t<typename T::Is_tombstone>
+        , std::void_t<typename T::Tombstone_functions>
     > : std::true_type {};
 
     // default
@@ -396,34 +459,308 @@ template <typename T>
 constexpr bool is_destructive_move_disabled = detail::is_destructive_move_disabled_impl<T>::value;
 
 //-----------------------------------------------------------------------------
+namespace detail {
+    template <typename Take_from>
+    struct is_trivially_relocatable {
+        static constexpr bool value = Take_from::is_trivially_relocatable;
+    };
+
+    template <typename T, typename = void>
+    struct has_is_trivially_relocatable : std::false_type {};
+
+    template <typename T>
+    struct has_is_trivially_relocatable<T
+        , std::void_t<decltype(T::is_trivially_relocatable)>
+    > : std::true_type {};
+
+    // default
+    template <typename T, typename = void>
+    struct is_trivially_relocatable_impl
+    {
+        static constexpr bool value = std::is_trivially_copyable_v<T>;
+    };
+
+    // Can exist in destructively_movable_traits<T> or T.  If exists in both,
+    // the one in T overrides.
+    template <typename T>
+    struct is_trivially_relocatable_impl<T, std::enable_if_t<
+        has_is_trivially_relocatable<T>::value
+    >> : is_trivially_relocatable<T>
+    {
+    };
+
+    template <typename T>
+    struct is_trivially_relocatable_impl<T, std::enable_if_t<
+        !has_is_trivially_relocatable<T>::value
+        && has_is_trivially_relocatable<destructively_movable_traits<T>>::value
+    >> : is_trivially_relocatable<destructively_movable_traits<T>>
+    {
+    };
+}
+// By default, if there is no is_trivially_relocatable trait defined in either
+// the destructively_movable_traits<type> or the type itself, then it is true
+// only if the type is trivially copyable.  An optional_v2<T> is trivially
+// relocatable if T is.
+template <typename T>
+constexpr bool is_trivially_relocatable = detail::is_trivially_relocatable_impl<T>::value;
+
+//-----------------------------------------------------------------------------
+namespace detail {
+    template <typename Take_from>
+    struct tombstone_in_tail_padding {
+        static constexpr bool value = Take_from::tombstone_in_tail_padding;
+    };
+
+    template <typename T, typename = void>
+    struct has_tombstone_in_tail_padding : std::false_type {};
+
+    template <typename T>
+    struct has_tombstone_in_tail_padding<T
+        , std::void_t<decltype(T::tombstone_in_tail_padding)>
+    > : std::true_type {};
+
+    // default
+    template <typename T, typename = void>
+    struct tombstone_in_tail_padding_impl
+    {
+        static constexpr bool value = false;
+    };
+
+    // Can exist in destructively_movable_traits<T> or T.  If exists in both,
+    // the one in T overrides.
+    template <typename T>
+    struct tombstone_in_tail_padding_impl<T, std::enable_if_t<
+        has_tombstone_in_tail_padding<T>::value
+    >> : tombstone_in_tail_padding<T>
+    {
+    };
+
+    template <typename T>
+    struct tombstone_in_tail_padding_impl<T, std::enable_if_t<
+        !has_tombstone_in_tail_padding<T>::value
+        && has_tombstone_in_tail_padding<destructively_movable_traits<T>>::value
+    >> : tombstone_in_tail_padding<destructively_movable_traits<T>>
+    {
+    };
+}
+// By default, if there is no tombstone_in_tail_padding trait defined in
+// either the destructively_movable_traits<type> or the type itself, then it
+// is false.
+template <typename T>
+constexpr bool tombstone_in_tail_padding = detail::tombstone_in_tail_padding_impl<T>::value;
+
+//-----------------------------------------------------------------------------
+namespace detail {
+    template <typename Take_from>
+    struct trace_policy
+    {
+        using type = typename Take_from::Trace_policy;
+    };
+
+    template <typename T, typename = void>
+    struct has_trace_policy : std::false_type {};
+
+    template <typename T>
+    struct has_trace_policy<T
+        , std::void_t<typename T::Trace_policy>
+    > : std::true_type {};
+
+    // default
+    template <typename T, typename = void>
+    struct get_trace_policy
+    {
+        using type = AFH_OPTIONAL_V2_TRACE_POLICY;
+    };
+
+    // Can exist in destructively_movable_traits<T> or T.  If exists in both,
+    // the one in T overrides.
+    template <typename T>
+    struct get_trace_policy<T, std::enable_if_t<
+        has_trace_policy<T>::value
+    >> : trace_policy<T>
+    {
+    };
+
+    template <typename T>
+    struct get_trace_policy<T, std::enable_if_t<
+        !has_trace_policy<T>::value
+        && has_trace_policy<destructively_movable_traits<T>>::value
+    >> : trace_policy<destructively_movable_traits<T>>
+    {
+    };
+}
+// By default, if there is no Trace_policy trait defined in either the
+// destructively_movable_traits<type> or the type itself, then it is
+// AFH_OPTIONAL_V2_TRACE_POLICY.
+template <typename T>
+using optional_v2_trace_policy = typename detail::get_trace_policy<T>::type;
+
+//-----------------------------------------------------------------------------
+namespace detail {
+    template <typename Take_from>
+    struct collect_stats {
+        static constexpr bool value = Take_from::collect_stats;
+    };
+
+    template <typename T, typename = void>
+    struct has_collect_stats : std::false_type {};
+
+    template <typename T>
+    struct has_collect_stats<T
+        , std::void_t<decltype(T::collect_stats)>
+    > : std::true_type {};
+
+    // default
+    template <typename T, typename = void>
+    struct collect_stats_impl
+    {
+        static constexpr bool value = AFH_DM_STATS != 0;
+    };
+
+    // Can exist in destructively_movable_traits<T> or T.  If exists in both,
+    // the one in T overrides.
+    template <typename T>
+    struct collect_stats_impl<T, std::enable_if_t<
+        has_collect_stats<T>::value
+    >> : collect_stats<T>
+    {
+    };
+
+    template <typename T>
+    struct collect_stats_impl<T, std::enable_if_t<
+        !has_collect_stats<T>::value
+        && has_collect_stats<destructively_movable_traits<T>>::value
+    >> : collect_stats<destructively_movable_traits<T>>
+    {
+    };
+}
+// By default, if there is no collect_stats trait defined in either the
+// destructively_movable_traits<type> or the type itself, then it is
+// AFH_DM_STATS.
+template <typename T>
+constexpr bool collect_stats = detail::collect_stats_impl<T>::value;
+
+namespace detail {
+    // Counts counter for optional_v2<T>.  Does nothing at all unless T
+    // collects stats.
+    template <typename T>
+    constexpr void count(dm_counter counter) noexcept
+    {
+        if constexpr (::afh::collect_stats<T>) {
+            dm_stats<T>::count(counter);
+        }
+    }
+
+    // Reports event for the optional_v2<T> at object, and counts it.  Does
+    // nothing at all with no_trace and no stats.
+    template <typename T>
+    constexpr void trace(trace_event event, void const volatile* object) noexcept
+    {
+        using policy = optional_v2_trace_policy<T>;
+        if constexpr (!std::is_same_v<policy, ::afh::no_trace>) {
+            policy::trace(event, object, trace_type_name<T>());
+        }
+        if constexpr (::afh::collect_stats<T>) {
+            switch (event) {
+            case trace_event::emplace:            dm_stats<T>::count(dm_counter::constructions);       break;
+            case trace_event::move_out:           dm_stats<T>::count(dm_counter::destructive_moves);   break;
+            case trace_event::elided_destruction: dm_stats<T>::count(dm_counter::elided_destructions); break;
+            default:                              break;
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// is_destructive_move_disabled<C> is true when C can be destructively moved,
+// which is when the members are kept.
 template<typename C, typename MT
-    , std::enable_if_t<!is_destructive_move_disabled<C>, int> = 0>
+    , std::enable_if_t< is_destructive_move_disabled<C>, int> = 0>
 constexpr auto destructive_move_exempt(MT C::* mp)
 {
     return std::tuple{ mp };
 }
 
 template<typename C, typename MT
-    , std::enable_if_t< is_destructive_move_disabled<C>, int> = 0>
-constexpr auto destructive_move_exempt(MT C::* mp)
+    , std::enable_if_t<!is_destructive_move_disabled<C>, int> = 0>
+constexpr auto destructive_move_exempt(MT C::*)
 {
     return std::tuple{ };
 }
 
 template<typename C, typename MT, typename...Ts
-    , std::enable_if_t<!is_destructive_move_disabled<C>, int> = 0>
+    , std::enable_if_t< is_destructive_move_disabled<C>, int> = 0>
 constexpr auto destructive_move_exempt(MT C::* mp, Ts...args)
 {
     return std::tuple_cat(std::tuple{ mp }, destructive_move_exempt(args...));
 }
 
 template<typename C, typename MT, typename...Ts
-    , std::enable_if_t< is_destructive_move_disabled<C>, int> = 0>
-constexpr auto destructive_move_exempt(MT C::* mp, Ts...args)
+    , std::enable_if_t<!is_destructive_move_disabled<C>, int> = 0>
+constexpr auto destructive_move_exempt(MT C::*, Ts...args)
 {
     return std::tuple_cat(std::tuple{ }, destructive_move_exempt(args...));
 }
 
+//-----------------------------------------------------------------------------
+namespace detail {
+    template <typename MP>
+    struct member_pointer;
+
+    template <typename C, typename MT>
+    struct member_pointer<MT C::*>
+    {
+        using class_type  = C;
+        using member_type = MT;
+    };
+}
+
+//-----------------------------------------------------------------------------
+// template <auto Member>
+// struct tombstone_via_member;
+//
+//  A Tombstone_functions type where the tombstone is the scalar member pointed
+//  to by Member being null or zero.  Only use this if that member is never
+//  null or zero in a live object:
+//
+//    using Tombstone_functions = afh::tombstone_via_member<&X::m_buf>;
+template <auto Member>
+struct tombstone_via_member
+{
+    using class_type  = typename detail::member_pointer<decltype(Member)>::class_type;
+    using member_type = typename detail::member_pointer<decltype(Member)>::member_type;
+    static_assert(std::is_scalar_v<member_type>, "Member must be a pointer, integer or enum.");
+
+    constexpr bool operator()(class_type const         & obj               ) const noexcept { return obj.*Member == member_type(); }
+    constexpr bool operator()(class_type const volatile& obj               ) const noexcept { return obj.*Member == member_type(); }
+    constexpr void operator()(class_type               & obj, tombstone_tag) const noexcept {        obj.*Member =  member_type(); }
+    constexpr void operator()(class_type       volatile& obj, tombstone_tag) const noexcept {        obj.*Member =  member_type(); }
+};
+
+//-----------------------------------------------------------------------------
+// template <auto Member>
+// struct tombstone_via_low_bit;
+//
+//  A Tombstone_functions type where the tombstone is the lowest bit of the
+//  pointer member pointed to by Member being set.  As the pointed to type is
+//  aligned on at least 2 bytes, a live object never has that bit set, so the
+//  pointer can still be null:
+//
+//    using Tombstone_functions = afh::tombstone_via_low_bit<&X::m_ptr>;
+template <auto Member>
+struct tombstone_via_low_bit
+{
+    using class_type  = typename detail::member_pointer<decltype(Member)>::class_type;
+    using member_type = typename detail::member_pointer<decltype(Member)>::member_type;
+    static_assert(std::is_pointer_v<member_type>, "Member must be a pointer.");
+    static_assert(alignof(std::remove_pointer_t<member_type>) >= 2, "Member must point at a type that has a spare alignment bit.");
+
+    bool operator()(class_type const         & obj               ) const noexcept { return (reinterpret_cast<std::uintptr_t>(obj.*Member) & 1) != 0; }
+    bool operator()(class_type const volatile& obj               ) const noexcept { return (reinterpret_cast<std::uintptr_t>(obj.*Member) & 1) != 0; }
+    void operator()(class_type               & obj, tombstone_tag) const noexcept {         obj.*Member = reinterpret_cast<member_type>(std::uintptr_t(1)); }
+    void operator()(class_type       volatile& obj, tombstone_tag) const noexcept {         obj.*Member = reinterpret_cast<member_type>(std::uintptr_t(1)); }
+};
+
 //-----------------------------------------------------------------------------
 // template <typename Contained>
 // class optional_v2;
@@ -473,7 +810,8 @@ constexpr auto destructive_move_exempt(MT C::* mp, Ts...args)
 //  optional_v2* optional_v2_impl::emplace(emplace_params<T, const_tag, Ts...>&& emplace)
 ////
 //   Constructes Contained, or any type that is derived from Contained that is
-//   the same size as Contained.
+//   the same size as Contained.  Derived types are rejected if the
+//   tombstone is in Contained's tail padding (see tombstone_in_tail_padding).
 //
 //  template <typename T, typename...Ts
 //      , std::enable_if_t<
@@ -481,7 +819,8 @@ constexpr auto destructive_move_exempt(MT C::* mp, Ts...args)
 //      , int> = 0>
 //  optional_v2* optional_v2_impl::emplace(emplace_params<T, Ts...> const& emplace)
 //   Constructes Contained, or any type that is derived from Contained that is
-//   the same size as Contained.
+//   the same size as Contained.  Derived types are rejected if the
+//   tombstone is in Contained's tail padding (see tombstone_in_tail_padding).
 //
 ////
 // Destructors
@@ -637,6 +976,7 @@ class optional_v2
     : public detail::optional_v2_impl<Contained>
 {
     using base = detail::optional_v2_impl<Contained>;
+    using Tombstone_functions = optional_v2_tombstone_functions<Contained>;
 public:
     // Note: By defining the copy/move constructor/assignment operator members
     //       explicitly like this, the base copy constructor/assignmnt
@@ -661,10 +1001,10 @@ public:
     constexpr optional_v2&& operator=(optional_v2     && obj) volatile && noexcept(noexcept(std::move(*this).base::operator=(std::move(obj)))) { return std::move(*this).base::operator=(std::move(obj)); }
     constexpr optional_v2&& operator=(optional_v2 const& obj) volatile && noexcept(noexcept(std::move(*this).base::operator=(          obj ))) { return std::move(*this).base::operator=(          obj ); }
 
-    constexpr void is_tombstoned(bool value)                noexcept { assert(value);        Tombstone_functions(*this, tombstone_tag()); }
-    constexpr void is_tombstoned(bool value)       volatile noexcept { assert(value);        Tombstone_functions(*this, tombstone_tag()); }
-    constexpr bool is_tombstoned(          ) const          noexcept {                return Tombstone_functions(*this); }
-    constexpr bool is_tombstoned(          ) const volatile noexcept {                return Tombstone_functions(*this); }
+    constexpr void is_tombstoned(bool value)                noexcept { assert(value);        Tombstone_functions()(base::unchecked_value(), tombstone_tag()); }
+    constexpr void is_tombstoned(bool value)       volatile noexcept { assert(value);        Tombstone_functions()(base::unchecked_value(), tombstone_tag()); }
+    constexpr bool is_tombstoned(          ) const          noexcept { detail::count<Contained>(dm_counter::internal_tombstone_checks); return Tombstone_functions()(base::unchecked_value()); }
+    constexpr bool is_tombstoned(          ) const volatile noexcept { detail::count<Contained>(dm_counter::internal_tombstone_checks); return Tombstone_functions()(base::unchecked_value()); }
 
     using base::base;
 };
@@ -721,6 +1061,7 @@ class optional_v2<Contained
     , std::enable_if_t<
         !std::is_trivially_destructible_v<Contained>
         && std::is_void_v<optional_v2_tombstone_functions<Contained>>
+        && !tombstone_in_tail_padding<Contained>
     >
 >
     : public detail::optional_v2_impl<Contained>
@@ -758,12 +1099,98 @@ public:
 
     constexpr void is_tombstoned(bool value)                noexcept {        m_isTombstoned = value; }
     constexpr void is_tombstoned(bool value)       volatile noexcept {        m_isTombstoned = value; }
-    constexpr bool is_tombstoned(          ) const          noexcept { return m_isTombstoned; }
-    constexpr bool is_tombstoned(          ) const volatile noexcept { return m_isTombstoned; }
+    constexpr bool is_tombstoned(          ) const          noexcept { detail::count<Contained>(dm_counter::external_tombstone_checks); return m_isTombstoned; }
+    constexpr bool is_tombstoned(          ) const volatile noexcept { detail::count<Contained>(dm_counter::external_tombstone_checks); return m_isTombstoned; }
+
+    using base::base;
+};
+
+// External tombstone kept in the last byte of Contained, which the
+// tombstone_in_tail_padding trait says is unused tail padding.
+template <typename Contained>
+class optional_v2<Contained
+    , std::enable_if_t<
+        !std::is_trivially_destructible_v<Contained>
+        && std::is_void_v<optional_v2_tombstone_functions<Contained>>
+        && tombstone_in_tail_padding<Contained>
+    >
+>
+    : public detail::optional_v2_impl<Contained>
+{
+    using base = detail::optional_v2_impl<Contained>;
+    static_assert(sizeof(Contained) > 1, "Contained is too small to have tail padding.");
+
+    unsigned char                * flag()                noexcept { return reinterpret_cast<unsigned char                *>(std::addressof(base::unchecked_value())) + sizeof(Contained) - 1; }
+    unsigned char       volatile * flag()       volatile noexcept { return reinterpret_cast<unsigned char       volatile *>(std::addressof(base::unchecked_value())) + sizeof(Contained) - 1; }
+    unsigned char const          * flag() const          noexcept { return reinterpret_cast<unsigned char const          *>(std::addressof(base::unchecked_value())) + sizeof(Contained) - 1; }
+    unsigned char const volatile * flag() const volatile noexcept { return reinterpret_cast<unsigned char const volatile *>(std::addressof(base::unchecked_value())) + sizeof(Contained) - 1; }
+public:
+    // See the external tombstone specialisation for why these are needed.
+    constexpr optional_v2(optional_v2     && obj) noexcept(noexcept(base(std::move(obj)))) : base(std::move(obj)) {}
+    constexpr optional_v2(optional_v2 const& obj) noexcept(noexcept(base(          obj ))) : base(          obj ) {}
+
+    constexpr optional_v2&  operator=(optional_v2 const& obj)          &  noexcept(noexcept(                 base::operator=(          obj ))) { return                  base::operator=(          obj ); }
+    constexpr optional_v2&  operator=(optional_v2     && obj)          &  noexcept(noexcept(                 base::operator=(std::move(obj)))) { return                  base::operator=(std::move(obj)); }
+    constexpr optional_v2&  operator=(optional_v2 const& obj) volatile &  noexcept(noexcept(                 base::operator=(          obj ))) { return                  base::operator=(          obj ); }
+    constexpr optional_v2&  operator=(optional_v2     && obj) volatile &  noexcept(noexcept(                 base::operator=(std::move(obj)))) { return                  base::operator=(std::move(obj)); }
+
+    // Does it even make sense to assign to a rvalue?  Limited value?
+    constexpr optional_v2&& operator=(optional_v2 const& obj)          && noexcept(noexcept(std::move(*this).base::operator=(          obj ))) { return std::move(*this).base::operator=(          obj ); }
+    constexpr optional_v2&& operator=(optional_v2     && obj)          && noexcept(noexcept(std::move(*this).base::operator=(std::move(obj)))) { return std::move(*this).base::operator=(std::move(obj)); }
+    constexpr optional_v2&& operator=(optional_v2 const& obj) volatile && noexcept(noexcept(std::move(*this).base::operator=(          obj ))) { return std::move(*this).base::operator=(          obj ); }
+    constexpr optional_v2&& operator=(optional_v2     && obj) volatile && noexcept(noexcept(std::move(*this).base::operator=(std::move(obj)))) { return std::move(*this).base::operator=(std::move(obj)); }
+
+    void is_tombstoned(bool value)                noexcept {        *flag() = value; }
+    void is_tombstoned(bool value)       volatile noexcept {        *flag() = value; }
+    bool is_tombstoned(          ) const          noexcept { detail::count<Contained>(dm_counter::external_tombstone_checks); return *flag() != 0; }
+    bool is_tombstoned(          ) const volatile noexcept { detail::count<Contained>(dm_counter::external_tombstone_checks); return *flag() != 0; }
 
     using base::base;
 };
 
+//-----------------------------------------------------------------------------
+// enum class optional_v2_layout_kind;
+// template <typename T>
+// struct optional_v2_layout;
+//
+//  Compile time report of how optional_v2<T> stores its tombstone and how many
+//  bytes that costs over T:
+//
+//    static_assert(afh::optional_v2_layout<X>::overhead == 0, "X grew");
+//
+//  kind is one of:
+//
+//   no_tombstone           T is trivially destructible, so nothing is stored.
+//   internal_tombstone     T has Tombstone_functions.
+//   tail_padding_tombstone The flag is in the last byte of T.
+//   external_tombstone     A bool is appended to T.
+enum class optional_v2_layout_kind
+{
+    no_tombstone,
+    internal_tombstone,
+    tail_padding_tombstone,
+    external_tombstone,
+};
+
+template <typename T>
+struct optional_v2_layout
+{
+    static constexpr optional_v2_layout_kind kind
+        = !std::is_void_v<optional_v2_tombstone_functions<T>> ? optional_v2_layout_kind::internal_tombstone
+        : std::is_trivially_destructible_v<T>                 ? optional_v2_layout_kind::no_tombstone
+        : tombstone_in_tail_padding<T>                        ? optional_v2_layout_kind::tail_padding_tombstone
+        :                                                       optional_v2_layout_kind::external_tombstone;
+
+    static constexpr char const* kind_name
+        = kind == optional_v2_layout_kind::no_tombstone           ? "no_tombstone"
+        : kind == optional_v2_layout_kind::internal_tombstone     ? "internal_tombstone"
+        : kind == optional_v2_layout_kind::tail_padding_tombstone ? "tail_padding_tombstone"
+        :                                                           "external_tombstone";
+
+    static constexpr std::size_t size     = sizeof(optional_v2<T>);
+    static constexpr std::size_t overhead = sizeof(optional_v2<T>) - sizeof(T);
+};
+
 template <typename T>
 struct is_optional_v2 : std::false_type {};
 
@@ -776,6 +1203,15 @@ using is_optional_v2_t = is_optional_v2<T>;
 template <typename T>
 constexpr bool is_optional_v2_v = is_optional_v2<T>::value;
 
+namespace detail {
+    // optional_v2<T> holds nothing else that cares where it lives.
+    template <typename T, typename I>
+    struct is_trivially_relocatable_impl<optional_v2<T, I>>
+    {
+        static constexpr bool value = ::afh::is_trivially_relocatable<T>;
+    };
+}
+
 namespace detail {
 
 // Helper class for storage
@@ -826,6 +1262,10 @@ class storage<Contained, std::enable_if_t<std::is_empty_v<Contained>>>
     // Stores nothing.
 };
 
+// Ends the lifetime of a slot whose tombstone has already been read (see
+// destroy_n() in relocate.hpp).  Defined in relocate.hpp.
+struct slot_destructor;
+
 // Helper class for destructor for non-trivial types.
 template <typename Contained, typename = void>
 class destruct_class {
@@ -849,8 +1289,10 @@ class alignas(Contained) optional_v2_impl
     , destruct_class<Contained>
 {
     // So that the destrutor can call optional_v2_impl::destruct_exempted_members()
-    template <typename Contained, typename>
+    template <typename Contained_, typename>
     friend class afh::detail::destruct_class;
+    // So that destroy_n() can call destruct_husk() and destruct_value().
+    friend struct afh::detail::slot_destructor;
 
     static_assert(afh::is_destructive_move_disabled<Contained>, "Cannot wrap Contained in a optional_v2 template as it is marked disabled");
 
@@ -871,8 +1313,14 @@ class alignas(Contained) optional_v2_impl
     constexpr static auto&& value(U&& this_ref) noexcept
     {
         assert(this_ref.is_trivially_destructible_without_internal_tombstone || !this_ref.is_tombstoned());
+        return unchecked_value(std::forward<U>(this_ref));
+    }
+
+    template <typename U>
+    constexpr static auto&& unchecked_value(U&& this_ref) noexcept
+    {
         if constexpr (!std::is_empty_v<Contained>)
-            return this_ref.storage<Contained>::value;
+            return fwd_like<U>(this_ref.storage<Contained>::value);
         else
             return
                 fwd_like<U>(
@@ -884,7 +1332,19 @@ class alignas(Contained) optional_v2_impl
                 );
     }
 
-    static constexpr bool has_external_tombstone = std::is_same<optional_v2, ::afh::optional_v2<Contained, void>>::value;
+protected:
+    // Access the Contained object without checking if it is tombstoned.  An
+    // internal tombstone is read and written through this, as the storage may
+    // not hold a live object at the time.
+    constexpr auto& unchecked_value()                noexcept { return unchecked_value(*this); }
+    constexpr auto& unchecked_value()       volatile noexcept { return unchecked_value(*this); }
+    constexpr auto& unchecked_value() const          noexcept { return unchecked_value(*this); }
+    constexpr auto& unchecked_value() const volatile noexcept { return unchecked_value(*this); }
+
+private:
+    static constexpr bool has_external_tombstone = !has_internal_tombstone;
+    static constexpr bool has_tail_padding_tombstone
+        = has_external_tombstone && !std::is_trivially_destructible_v<Contained> && ::afh::tombstone_in_tail_padding<Contained>;
 
     template <typename T> struct bare_type_impl                        { using type = T; };
     template <typename T> struct bare_type_impl<::afh::optional_v2<T>> { using type = T; };
@@ -894,6 +1354,12 @@ class alignas(Contained) optional_v2_impl
     
     template <typename T> using  fwd_to_bare_type_t = fwd_type_t<T, bare_t<T>>;
 
+    // Tells the Trace_policy and dm_stats<Contained> about event.
+    constexpr void trace(trace_event event) const volatile noexcept
+    {
+        ::afh::detail::trace<Contained>(event, this);
+    }
+
     // Want to ensure that these are not called by accedent.
     optional_v2_impl           (optional_v2_impl const&) = delete;
     optional_v2_impl& operator=(optional_v2_impl const&) = delete;
@@ -908,6 +1374,8 @@ public:
             is_tombstoned(true);
         }
         assert(is_trivially_destructible_without_internal_tombstone || is_tombstoned());
+        trace(trace_event::construct);
+        trace(trace_event::tombstone);
     }
 
     template <typename...Ts>
@@ -917,6 +1385,7 @@ public:
     {
         emplace(std::forward<Ts>(args)...);
         assert(is_trivially_destructible_without_internal_tombstone || !is_tombstoned());
+        trace(trace_event::construct);
     }
 
     // Does emplace construction of Contained, excluding "move/copy
@@ -949,8 +1418,10 @@ public:
         )
     {
         emplace(::afh::emplace<Contained>(std::move(to_be_moved).value()));
-        if constexpr (to_be_moved.has_external_tombstone) {
+        to_be_moved.trace(trace_event::move_out);
+        if constexpr (!is_trivially_destructible_without_internal_tombstone) {
             to_be_moved.is_tombstoned(true);
+            to_be_moved.trace(trace_event::tombstone);
         }
         // Operation was a move on a optional_v2 object.
         assert(is_trivially_destructible_without_internal_tombstone || to_be_moved.is_tombstoned());
@@ -981,18 +1452,20 @@ public:
     // If going to accept derived types, then the size of values must be the same.
     //
     // NOTE: If going to accept derived types, then the size of values must be
-    //       the same.
+    //       the same.  They are rejected with a tail padding tombstone, as a
+    //       derived type can put its members in Contained's tail padding.
     // NOTE: Although not actually using const_tag, specifying it for
     //       completeness.
     template <typename T, typename const_tag, typename...Ts
         , std::enable_if_t<
-            std::is_base_of<Contained, T>::value && sizeof(Contained) == sizeof(T)
+            (std::is_same<Contained, T>::value || std::is_base_of<Contained, T>::value) && sizeof(Contained) == sizeof(T)
         , int> = 0>
     constexpr optional_v2* emplace(emplace_params<T, const_tag, Ts...>&& emplace) noexcept(noexcept(
         emplace.uninitialized_construct(this)
     ))
     {
-        //AFH___OUTPUT_THIS_FUNC;
+        static_assert(std::is_same<Contained, T>::value || !has_tail_padding_tombstone,
+            "A type derived from Contained can use the tail padding that holds the tombstone.");
         emplace.uninitialized_construct(this);
         if constexpr (!is_trivially_destructible_without_internal_tombstone && has_external_tombstone) {
             // = (has_internal_tombstone && has_external_tombstone || !trivially_destructable && has_external_tombstone)
@@ -1001,6 +1474,7 @@ public:
             is_tombstoned(false);
         }
         assert(is_trivially_destructible_without_internal_tombstone || !is_tombstoned());
+        trace(trace_event::emplace);
         return static_cast<optional_v2*>(this);
     }
 
@@ -1011,23 +1485,26 @@ public:
     // allows for safe reuse of an emplace_params.
     //
     // NOTE: If going to accept derived types, then the size of values must be
-    //       the same.
+    //       the same.  They are rejected with a tail padding tombstone, as a
+    //       derived type can put its members in Contained's tail padding.
     // NOTE: Although not actually using const_tag, specifying it for
     //       completeness.
     template <typename T, typename const_tag, typename...Ts
         , std::enable_if_t<
-            std::is_base_of<Contained, T>::value && sizeof(Contained) == sizeof(T)
+            (std::is_same<Contained, T>::value || std::is_base_of<Contained, T>::value) && sizeof(Contained) == sizeof(T)
         , int> = 0>
     constexpr optional_v2* emplace(emplace_params<T, const_tag, Ts...> const& emplace) noexcept(noexcept(
         emplace.uninitialized_construct(this)
     ))
     {
-        AFH___OUTPUT_THIS_FUNC;
+        static_assert(std::is_same<Contained, T>::value || !has_tail_padding_tombstone,
+            "A type derived from Contained can use the tail padding that holds the tombstone.");
         emplace.uninitialized_construct(this);
         if constexpr (!is_trivially_destructible_without_internal_tombstone && has_external_tombstone) {
             is_tombstoned(false);
         }
         assert(is_trivially_destructible_without_internal_tombstone || !is_tombstoned());
+        trace(trace_event::emplace);
         return static_cast<optional_v2*>(this);
     }
 
@@ -1035,14 +1512,31 @@ private:
     constexpr void destruct_exempted_members()
     {
         if (is_tombstoned()) {
-            if constexpr (std::is_empty_v<Contained>)
-                Destruct_exempt_members()(*std::launder(reinterpret_cast<Contained*>(this)));
-            else
-                Destruct_exempt_members()(storage<Contained>::value);
+            destruct_husk();
         }
         else {
-            storage<Contained>::value.~Contained();
+            destruct_value();
+        }
+    }
+
+    // The two halves of destruct_exempted_members(), for when it is already
+    // known whether this is tombstoned.
+    constexpr void destruct_husk()
+    {
+        trace(trace_event::elided_destruction);
+        if constexpr (!has_nothing_to_destruct_after_move) {
+            ::afh::detail::count<Contained>(dm_counter::exempt_destructions);
         }
+        if constexpr (std::is_empty_v<Contained>)
+            Destruct_exempt_members()(*std::launder(reinterpret_cast<Contained*>(this)));
+        else
+            Destruct_exempt_members()(storage<Contained>::value);
+    }
+
+    constexpr void destruct_value()
+    {
+        ::afh::detail::count<Contained>(dm_counter::destructions);
+        storage<Contained>::value.~Contained();
     }
 
 public:
@@ -1051,9 +1545,9 @@ public:
         assert(is_trivially_destructible_without_internal_tombstone || !is_tombstoned());
         if constexpr (!is_trivially_destructible_without_internal_tombstone) {
             destruct_exempted_members();
-            if constexpr (has_external_tombstone) {
-                is_tombstoned(true);
-            }
+            trace(trace_event::reset);
+            is_tombstoned(true);
+            trace(trace_event::tombstone);
         }
         assert(is_trivially_destructible_without_internal_tombstone || is_tombstoned());
     }
@@ -1070,8 +1564,14 @@ public:
     {
         using std::swap;
         if (has_value())
-            if (other.has_value())
+            if (other.has_value()) {
                 swap(value(), other.value());
+                if constexpr (has_tail_padding_tombstone) {
+                    // Swapping may have copied the padding.
+                    is_tombstoned(false);
+                    other.is_tombstoned(false);
+                }
+            }
             else
                 assign(derived(), std::move(other));
         else if (other.has_value())
@@ -1087,8 +1587,14 @@ public:
     {
         using std::swap;
         if (has_value())
-            if (other.has_value())
+            if (other.has_value()) {
                 swap(value(), other.value());
+                if constexpr (has_tail_padding_tombstone) {
+                    // Swapping may have copied the padding.
+                    is_tombstoned(false);
+                    other.is_tombstoned(false);
+                }
+            }
             else
                 assign(derived(), std::move(other));
         else if (other.has_value())
@@ -1097,27 +1603,42 @@ public:
 
     constexpr void has_been_moved() volatile noexcept
     {
-        assert(is_trivially_destructible_without_internal_tombstone || 
-            (   has_external_tombstone && !is_tombstoned()
-            || !has_external_tombstone &&  is_tombstoned()));
-        if constexpr (!is_trivially_destructible_without_internal_tombstone && has_external_tombstone) {
+        // An internal tombstone may already read as tombstoned if the moved
+        // from state is the tombstone.
+        assert(is_trivially_destructible_without_internal_tombstone || has_internal_tombstone || !is_tombstoned());
+        trace(trace_event::move_out);
+        if constexpr (!is_trivially_destructible_without_internal_tombstone) {
             is_tombstoned(true);
+            trace(trace_event::tombstone);
         }
         assert(is_trivially_destructible_without_internal_tombstone || is_tombstoned());
     }
 
     constexpr void has_been_moved()          noexcept
     {
-        assert(is_trivially_destructible_without_internal_tombstone ||
-            (   has_external_tombstone && !is_tombstoned()
-            || !has_external_tombstone &&  is_tombstoned()));
-        if constexpr (!is_trivially_destructible_without_internal_tombstone && has_external_tombstone) {
+        // An internal tombstone may already read as tombstoned if the moved
+        // from state is the tombstone.
+        assert(is_trivially_destructible_without_internal_tombstone || has_internal_tombstone || !is_tombstoned());
+        trace(trace_event::move_out);
+        if constexpr (!is_trivially_destructible_without_internal_tombstone) {
             is_tombstoned(true);
+            trace(trace_event::tombstone);
         }
         assert(is_trivially_destructible_without_internal_tombstone || is_tombstoned());
     }
 
 private:
+    template <typename T, typename U>
+    static constexpr void assign_value(T&& lhs, U&& rhs)
+        noexcept(noexcept(std::forward<T>(lhs).value() = std::forward<U>(rhs).value()))
+    {
+        std::forward<T>(lhs).value() = std::forward<U>(rhs).value();
+        if constexpr (has_tail_padding_tombstone) {
+            // Assignment may have copied the padding.
+            lhs.is_tombstoned(false);
+        }
+    }
+
     using moving_optional_v2 = std::true_type;
     using assigning_copy     = std::false_type;
     // moving optional_v2 rvalue referenced wrapped type.
@@ -1125,6 +1646,7 @@ private:
     static constexpr auto&& assign(T&& lhs, U&& rhs, moving_optional_v2)
         noexcept(
             noexcept(std::forward<T>(lhs).value() = std::forward<U>(rhs).value())
+            && noexcept(lhs.emplace(std::forward<U>(rhs).value()))
         )
     {
         // Only assign something if there is something to assign, or if it's
@@ -1137,10 +1659,35 @@ private:
             // seems to get confused.  However, generally, it's limiting the
             // type as types can be assignable, but not have an operator=(...)
             // function, such as primitive types.
-            std::forward<T>(lhs).value() = std::forward<U>(rhs).value();
+            //
+            // A move assigned from object can still own resources (e.g.
+            // libstdc++'s std::string hands its old buffer back to rhs), so
+            // rhs's husk can only be dropped on the floor if Contained is
+            // trivially destructible.  Otherwise, if moving can't throw, lhs
+            // is reset and move constructed into, or if it can, lhs is
+            // assigned to (keeping whatever guarantee Contained's assignment
+            // gives) and rhs is then destroyed properly.
+            if (lhs.is_trivially_destructible_without_internal_tombstone
+                || (std::is_trivially_destructible_v<Contained> && !lhs.is_tombstoned())) {
+                assign_value(std::forward<T>(lhs), std::forward<U>(rhs));
+            }
+            else if (lhs.is_tombstoned()) {
+                // Nothing to assign to, so construct in place.
+                lhs.emplace(std::forward<U>(rhs).value());
+            }
+            else if (std::is_nothrow_constructible_v<Contained, decltype(std::forward<U>(rhs).value())>) {
+                lhs.reset();
+                lhs.emplace(std::forward<U>(rhs).value());
+            }
+            else {
+                assign_value(std::forward<T>(lhs), std::forward<U>(rhs));
+                rhs.reset();
+            }
             assert(lhs.is_trivially_destructible_without_internal_tombstone || !lhs.is_tombstoned());
-            if constexpr (!rhs.is_trivially_destructible_without_internal_tombstone && rhs.has_external_tombstone) {
+            rhs.trace(trace_event::move_out);
+            if constexpr (!rhs.is_trivially_destructible_without_internal_tombstone) {
                 rhs.is_tombstoned(true);
+                rhs.trace(trace_event::tombstone);
             }
             assert(rhs.is_trivially_destructible_without_internal_tombstone ||  rhs.is_tombstoned());
         }
@@ -1161,6 +1708,10 @@ private:
         if (lhs.is_trivially_destructible_without_internal_tombstone || !lhs.is_tombstoned()) {
             // Assign the underlying lhs value to the rhs value.
             std::forward<T>(lhs).value() = std::forward<U>(rhs);
+            if constexpr (lhs.has_tail_padding_tombstone) {
+                // Assignment may have copied the padding.
+                lhs.is_tombstoned(false);
+            }
         }
         else {
             lhs.emplace(std::forward<U>(rhs));
@@ -1324,4 +1875,8 @@ destruct_class<Contained, X>::~destruct_class()
 
 } // namespace detail
 } // namespace afh
+
+// Always included, so that every translation unit agrees on the layout of an
+// optional_v2 of a standard library type.
+#include "destructively_movable_std.hpp"
 #endif // #ifndef AFH_DESTRUCTIVE_MOVE_HPP__
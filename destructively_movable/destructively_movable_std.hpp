@@ -0,0 +1,220 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DESTRUCTIVELY_MOVABLE_STD_HPP__
+#define AFH_DESTRUCTIVELY_MOVABLE_STD_HPP__
+
+#include "destructively_movable.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+//=============================================================================
+// destructively_movable_traits for standard library types
+//
+//  Internal tombstones for std::basic_string, std::vector, std::unique_ptr and
+//  std::shared_ptr, so that an optional_v2 of one of them is the same size as
+//  the type itself and doesn't need a separate bool.
+//
+//  Each tombstone is a bit pattern that no live object can have (a niche),
+//  written over the object representation of a moved from or uninitialised
+//  object.  A moved from std::unique_ptr is null, but so is a default
+//  constructed one which must still be a value, so null can't be used as the
+//  tombstone.  Instead:
+//
+//    std::unique_ptr<U>      pointer                   == 1
+//    std::shared_ptr<U>      control block pointer     == 1
+//    std::vector<U>          end pointer               == 1
+//    std::basic_string<C>    libstdc++: data pointer   == nullptr
+//                            libc++:    long flag set and data pointer == nullptr
+//
+//  No object is aligned on an odd address, and a string always points at
+//  either its own buffer or an allocation.
+//
+//  These depend on the layout of libstdc++ and libc++ (in its default
+//  little endian string layout).  They are only defined for libstdc++ when
+//  _GLIBCXX_DEBUG isn't, as its debug containers carry extra members, and for
+//  libc++ only when AFH_STD_TOMBSTONES_LIBCXX is defined to 1, as those have
+//  been written from its headers but have not been built or run.  Otherwise,
+//  AFH_HAS_STD_TOMBSTONES is 0 and these types keep the external tombstone.
+//  A type whose size isn't the one its tombstone was written for also keeps
+//  the external tombstone.
+//
+//  NOTE: destructively_movable.hpp includes this header, so that no
+//        translation unit can see optional_v2 without these traits, which
+//        would make them disagree on the layout of the optional_v2.
+#if defined(__GLIBCXX__) && !defined(_GLIBCXX_DEBUG)
+#   define AFH_HAS_STD_TOMBSTONES 1
+#   define AFH___STD_TOMBSTONES_LIBSTDCXX 1
+#elif defined(_LIBCPP_VERSION) && defined(AFH_STD_TOMBSTONES_LIBCXX) && AFH_STD_TOMBSTONES_LIBCXX \
+    && !defined(_LIBCPP_ABI_ALTERNATE_STRING_LAYOUT) \
+    && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#   define AFH_HAS_STD_TOMBSTONES 1
+#   define AFH___STD_TOMBSTONES_LIBCXX 1
+#else
+#   define AFH_HAS_STD_TOMBSTONES 0
+#endif
+
+#if AFH_HAS_STD_TOMBSTONES
+namespace afh {
+
+//-----------------------------------------------------------------------------
+namespace detail {
+    using std_word = std::uintptr_t;
+
+    // Never the address of an object, as nothing is aligned on an odd address.
+    constexpr std_word std_niche_word = 1;
+
+    // Reads the Ith pointer sized word of obj's object representation.
+    template <std::size_t I, typename T>
+    std_word load_std_word(T const volatile& obj) noexcept
+    {
+        static_assert((I + 1) * sizeof(std_word) <= sizeof(T), "Word is outside of the object.");
+        std_word word;
+        std::memcpy(&word, reinterpret_cast<char const*>(const_cast<T const*>(std::addressof(obj))) + I * sizeof(std_word), sizeof(std_word));
+        return word;
+    }
+
+    // Writes the Ith pointer sized word of obj's object representation.
+    template <std::size_t I, typename T>
+    void store_std_word(T volatile& obj, std_word word) noexcept
+    {
+        static_assert((I + 1) * sizeof(std_word) <= sizeof(T), "Word is outside of the object.");
+        std::memcpy(reinterpret_cast<char*>(const_cast<T*>(std::addressof(obj))) + I * sizeof(std_word), &word, sizeof(std_word));
+    }
+
+    // Tombstone_functions where the tombstone is word I being std_niche_word.
+    template <typename T, std::size_t I>
+    struct niche_word_tombstone
+    {
+        bool operator()(T const volatile& obj) const noexcept
+        {
+            return load_std_word<I>(obj) == std_niche_word;
+        }
+
+        void operator()(T volatile& obj, tombstone_tag) const noexcept
+        {
+            store_std_word<I>(obj, std_niche_word);
+        }
+    };
+
+    // Tombstone when T is Words words long, as Tombstone was written for
+    // that layout, or the external one otherwise.
+    template <typename T, std::size_t Words, typename Tombstone>
+    using std_tombstone_if_layout = std::conditional_t<sizeof(T) == Words * sizeof(std_word), Tombstone, void>;
+
+    template <typename T, std::size_t Words>
+    constexpr bool std_relocatable_if_layout = sizeof(T) == Words * sizeof(std_word);
+}
+
+//-----------------------------------------------------------------------------
+// std::unique_ptr<U> is { pointer } when using std::default_delete.
+template <typename U>
+struct destructively_movable_traits<std::unique_ptr<U>>
+{
+    using Tombstone_functions = detail::std_tombstone_if_layout<std::unique_ptr<U>, 1, detail::niche_word_tombstone<std::unique_ptr<U>, 0>>;
+    static constexpr bool is_trivially_relocatable = detail::std_relocatable_if_layout<std::unique_ptr<U>, 1>;
+};
+
+//-----------------------------------------------------------------------------
+// std::shared_ptr<U> is { element pointer, control block pointer }.  The
+// element pointer can be anything (aliasing constructor), but the control
+// block pointer is either null or points at the control block.
+template <typename U>
+struct destructively_movable_traits<std::shared_ptr<U>>
+{
+    using Tombstone_functions = detail::std_tombstone_if_layout<std::shared_ptr<U>, 2, detail::niche_word_tombstone<std::shared_ptr<U>, 1>>;
+    static constexpr bool is_trivially_relocatable = detail::std_relocatable_if_layout<std::shared_ptr<U>, 2>;
+};
+
+//-----------------------------------------------------------------------------
+// std::vector<U> is { begin, end, end of capacity } when using
+// std::allocator.  The end pointer is either null or points into (or one past)
+// the allocation.
+template <typename U>
+struct destructively_movable_traits<std::vector<U>>
+{
+    using Tombstone_functions = detail::std_tombstone_if_layout<std::vector<U>, 3, detail::niche_word_tombstone<std::vector<U>, 1>>;
+    static constexpr bool is_trivially_relocatable = detail::std_relocatable_if_layout<std::vector<U>, 3>;
+};
+
+// std::vector<bool> has a different layout, so it keeps the external
+// tombstone.
+template <>
+struct destructively_movable_traits<std::vector<bool>>
+{
+    using Tombstone_functions = void;
+};
+
+//-----------------------------------------------------------------------------
+#if AFH___STD_TOMBSTONES_LIBSTDCXX
+// libstdc++ std::basic_string<C> is { data pointer, size, buffer/capacity }
+// where the data pointer points at the local buffer or the allocation (or at
+// the shared representation with the old COW ABI).  It is never null.  It
+// isn't trivially relocatable, as a short string points into itself.
+template <typename C>
+struct destructively_movable_traits<std::basic_string<C>>
+{
+    struct Tombstone_functions
+    {
+        bool operator()(std::basic_string<C> const volatile& obj) const noexcept
+        {
+            return detail::load_std_word<0>(obj) == 0;
+        }
+
+        void operator()(std::basic_string<C> volatile& obj, tombstone_tag) const noexcept
+        {
+            detail::store_std_word<0>(obj, 0);
+        }
+    };
+};
+#elif AFH___STD_TOMBSTONES_LIBCXX
+// libc++ std::basic_string<C> is a union of a short representation and a long
+// one of { capacity, size, data pointer }, where the lowest bit of the first
+// word is set when it is long.  A long string is never without an allocation.
+template <typename C>
+struct destructively_movable_traits<std::basic_string<C>>
+{
+    struct tombstone
+    {
+        bool operator()(std::basic_string<C> const volatile& obj) const noexcept
+        {
+            return (detail::load_std_word<0>(obj) & 1) != 0 && detail::load_std_word<2>(obj) == 0;
+        }
+
+        void operator()(std::basic_string<C> volatile& obj, tombstone_tag) const noexcept
+        {
+            detail::store_std_word<0>(obj, 1);
+            detail::store_std_word<2>(obj, 0);
+        }
+    };
+    using Tombstone_functions = detail::std_tombstone_if_layout<std::basic_string<C>, 3, tombstone>;
+    static constexpr bool is_trivially_relocatable = detail::std_relocatable_if_layout<std::basic_string<C>, 3>;
+};
+#endif
+
+//-----------------------------------------------------------------------------
+#if AFH___STD_TOMBSTONES_LIBSTDCXX
+// The layouts that have been tested.
+static_assert(sizeof(optional_v2<std::string        >) == sizeof(std::string        ), "std::string doesn't have an internal tombstone.");
+static_assert(sizeof(optional_v2<std::wstring       >) == sizeof(std::wstring       ), "std::wstring doesn't have an internal tombstone.");
+static_assert(sizeof(optional_v2<std::vector<int>   >) == sizeof(std::vector<int>   ), "std::vector doesn't have an internal tombstone.");
+static_assert(sizeof(optional_v2<std::unique_ptr<int>>) == sizeof(std::unique_ptr<int>), "std::unique_ptr doesn't have an internal tombstone.");
+static_assert(sizeof(optional_v2<std::shared_ptr<int>>) == sizeof(std::shared_ptr<int>), "std::shared_ptr doesn't have an internal tombstone.");
+#endif
+
+} // namespace afh
+#endif // #if AFH_HAS_STD_TOMBSTONES
+#endif // #ifndef AFH_DESTRUCTIVELY_MOVABLE_STD_HPP__
@@ -0,0 +1,591 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DM_ALGORITHM_HPP__
+#define AFH_DM_ALGORITHM_HPP__
+
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+//=============================================================================
+//  Sorting and heap algorithms for ranges of optional_v2<T>, which must all
+//  have values.  Instead of swapping or move assigning through temporaries,
+//  an element is lifted out into raw storage, leaving a hole in the range,
+//  and elements are relocated into the hole one at a time (which moves the
+//  hole) until the lifted element is relocated into the final hole.  So each
+//  step is a single relocation (a memcpy for trivially relocatable types)
+//  and no husk is ever destructed.
+//
+//  comp compares the contained values: comp(T const&, T const&).  If it
+//  throws, the lifted element is put into the hole, so the range is still
+//  full of values, but in an unspecified order.
+//
+//  T must be nothrow relocatable.
+namespace afh {
+
+namespace detail {
+    // An element lifted out of a range of slots, and the hole it leaves.
+    template <typename Slot>
+    class hole
+    {
+    public:
+        explicit hole(Slot* at) noexcept
+            : m_at(at)
+        {
+            relocate_at(at, lifted());
+        }
+
+        hole(hole const&) = delete;
+        hole& operator=(hole const&) = delete;
+
+        // Puts the lifted element into the hole.
+        ~hole()
+        {
+            relocate_at(lifted(), m_at);
+        }
+
+        auto const& value() const noexcept { return lifted()->value(); }
+        Slot*       at()    const noexcept { return m_at; }
+
+        // Relocates *from into the hole, which moves the hole to from.
+        void fill_from(Slot* from) noexcept
+        {
+            relocate_at(from, m_at);
+            m_at = from;
+        }
+
+    private:
+        Slot* lifted() const noexcept
+        {
+            return std::launder(reinterpret_cast<Slot*>(const_cast<unsigned char*>(m_storage)));
+        }
+
+        alignas(Slot) unsigned char m_storage[sizeof(Slot)];
+        Slot*                       m_at;
+    };
+
+    template <typename T, typename I>
+    void relocate_swap(optional_v2<T, I>* a, optional_v2<T, I>* b) noexcept
+    {
+        hole<optional_v2<T, I>> h(a);
+        h.fill_from(b);
+    }
+
+    template <typename T, typename I, typename Compare>
+    void insertion_sort(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare& comp)
+    {
+        if (first == last) {
+            return;
+        }
+        for (auto* i = first + 1; i != last; ++i) {
+            if (comp(i->value(), (i - 1)->value())) {
+                hole<optional_v2<T, I>> h(i);
+                do {
+                    h.fill_from(h.at() - 1);
+                } while (h.at() != first && comp(h.value(), (h.at() - 1)->value()));
+            }
+        }
+    }
+
+    // Sorts *a, *b, *c.
+    template <typename T, typename I, typename Compare>
+    void sort3(optional_v2<T, I>* a, optional_v2<T, I>* b, optional_v2<T, I>* c, Compare& comp)
+    {
+        if (comp(b->value(), a->value())) relocate_swap(a, b);
+        if (comp(c->value(), b->value())) {
+            relocate_swap(b, c);
+            if (comp(b->value(), a->value())) relocate_swap(a, b);
+        }
+    }
+
+    // Partitions [first, last), at least 3 long, around the median of the
+    // first, middle and last elements.  Returns the position of that
+    // element, which is where it belongs in sorted order.  Elements equal to
+    // it may end up on either side, which keeps the parts balanced when
+    // there are many of them.
+    template <typename T, typename I, typename Compare>
+    optional_v2<T, I>* partition_pivot(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare& comp)
+    {
+        auto* lo = first;
+        auto* hi = last - 1;
+        sort3(lo, lo + (hi - lo) / 2, hi, comp);
+        relocate_swap(lo, lo + (hi - lo) / 2);
+        // *lo is the pivot and *hi is not less than it.
+        hole<optional_v2<T, I>> pivot(lo);
+        while (lo < hi) {
+            while (lo < hi && comp(pivot.value(), hi->value())) {
+                --hi;
+            }
+            if (lo < hi) {
+                pivot.fill_from(hi); // hole moves from lo to hi
+                ++lo;
+            }
+            while (lo < hi && comp(lo->value(), pivot.value())) {
+                ++lo;
+            }
+            if (lo < hi) {
+                pivot.fill_from(lo); // hole moves from hi to lo
+                --hi;
+            }
+        }
+        return pivot.at();
+    }
+
+    template <typename T, typename I, typename Compare>
+    void sift_down(optional_v2<T, I>* first, std::ptrdiff_t len, hole<optional_v2<T, I>>& h, Compare& comp)
+    {
+        // Move the hole down to a leaf, always through the larger child,
+        // then back up to where the lifted element belongs.  That takes
+        // fewer comparisons than stopping on the way down.
+        std::ptrdiff_t top   = h.at() - first;
+        std::ptrdiff_t index = top;
+        while (2 * index + 2 < len) {
+            std::ptrdiff_t child = 2 * index + 2;
+            if (comp(first[child].value(), first[child - 1].value())) {
+                --child;
+            }
+            h.fill_from(first + child);
+            index = child;
+        }
+        if (2 * index + 2 == len) {
+            h.fill_from(first + (2 * index + 1));
+            index = 2 * index + 1;
+        }
+        while (index > top) {
+            std::ptrdiff_t parent = (index - 1) / 2;
+            if (!comp(first[parent].value(), h.value())) {
+                break;
+            }
+            h.fill_from(first + parent);
+            index = parent;
+        }
+    }
+
+    template <typename T, typename I, typename Compare>
+    void heap_sort(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare& comp);
+
+    template <typename T, typename I, typename Compare>
+    void intro_sort(optional_v2<T, I>* first, optional_v2<T, I>* last, int depth, Compare& comp)
+    {
+        while (last - first > 16) {
+            if (depth-- == 0) {
+                heap_sort(first, last, comp);
+                return;
+            }
+            auto* pivot = partition_pivot(first, last, comp);
+            // Recurse into the smaller part, so the stack stays O(log n).
+            if (pivot - first < last - pivot) {
+                intro_sort(first, pivot, depth, comp);
+                first = pivot + 1;
+            }
+            else {
+                intro_sort(pivot + 1, last, depth, comp);
+                last = pivot;
+            }
+        }
+        insertion_sort(first, last, comp);
+    }
+
+    inline int sort_depth_limit(std::ptrdiff_t len) noexcept
+    {
+        int depth = 0;
+        for (; len > 1; len >>= 1) {
+            depth += 2;
+        }
+        return depth;
+    }
+
+    // Storage for count slots that is never constructed as a whole.
+    template <typename Slot>
+    struct relocation_buffer
+    {
+        explicit relocation_buffer(std::size_t count)
+            : m_slots(static_cast<Slot*>(::operator new(count * sizeof(Slot), std::align_val_t(alignof(Slot)))))
+        {}
+        relocation_buffer(relocation_buffer const&) = delete;
+        relocation_buffer& operator=(relocation_buffer const&) = delete;
+        ~relocation_buffer()
+        {
+            ::operator delete(m_slots, std::align_val_t(alignof(Slot)));
+        }
+
+        Slot* m_slots;
+    };
+
+    // Merges the sorted ranges [first, middle) and [middle, last), using
+    // buffer, which has room for middle - first slots.
+    template <typename T, typename I, typename Compare>
+    void merge_adjacent(optional_v2<T, I>* first, optional_v2<T, I>* middle, optional_v2<T, I>* last
+        , optional_v2<T, I>* buffer, Compare& comp)
+    {
+        using slot = optional_v2<T, I>;
+        // Relocate the left run out, then merge back into the range.  The
+        // slots in [out, right) are always holes, exactly as many as there
+        // are slots left in [left, left_end).
+        slot* left_end = uninitialized_relocate(first, middle, buffer);
+        slot* left     = buffer;
+        slot* right    = middle;
+        slot* out      = first;
+        struct refill {
+            slot*& left; slot*& left_end; slot*& out;
+            ~refill() { uninitialized_relocate(left, left_end, out); }
+        } guard{ left, left_end, out };
+        while (left != left_end && right != last) {
+            if (comp(right->value(), left->value())) {
+                relocate_at(right++, out++);
+            }
+            else {
+                relocate_at(left++, out++);
+            }
+        }
+    }
+
+    template <typename T, typename I, typename Compare>
+    void merge_sort(optional_v2<T, I>* first, optional_v2<T, I>* last, optional_v2<T, I>* buffer, Compare& comp)
+    {
+        if (last - first <= 16) {
+            insertion_sort(first, last, comp);
+            return;
+        }
+        auto* middle = first + (last - first) / 2;
+        merge_sort(first, middle, buffer, comp);
+        merge_sort(middle, last, buffer, comp);
+        if (comp(middle->value(), (middle - 1)->value())) {
+            merge_adjacent(first, middle, last, buffer, comp);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename Compare = std::less<>>
+// void push_heap(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {});
+//
+//  Adds *(last - 1) to the max heap [first, last - 1).
+template <typename T, typename I, typename Compare = std::less<>>
+void push_heap(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {})
+{
+    static_assert(detail::is_nothrow_relocatable<T, I>, "T must be nothrow relocatable.");
+    std::ptrdiff_t index = last - first - 1;
+    if (index <= 0) {
+        return;
+    }
+    std::ptrdiff_t parent = (index - 1) / 2;
+    if (!comp(first[parent].value(), first[index].value())) {
+        return;
+    }
+    detail::hole<optional_v2<T, I>> h(first + index);
+    do {
+        h.fill_from(first + parent);
+        index  = parent;
+        parent = (index - 1) / 2;
+    } while (index > 0 && comp(first[parent].value(), h.value()));
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename Compare = std::less<>>
+// void pop_heap(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {});
+//
+//  Moves the largest element of the max heap [first, last) to last - 1, and
+//  makes [first, last - 1) a max heap.
+template <typename T, typename I, typename Compare = std::less<>>
+void pop_heap(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {})
+{
+    static_assert(detail::is_nothrow_relocatable<T, I>, "T must be nothrow relocatable.");
+    if (last - first < 2) {
+        return;
+    }
+    // Lift the last element out, put the top in its place, then find where
+    // the lifted element goes starting from the hole at the top.
+    detail::hole<optional_v2<T, I>> h(last - 1);
+    h.fill_from(first);
+    detail::sift_down(first, last - 1 - first, h, comp);
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename Compare = std::less<>>
+// void make_heap(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {});
+//
+//  Makes [first, last) a max heap.
+template <typename T, typename I, typename Compare = std::less<>>
+void make_heap(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {})
+{
+    static_assert(detail::is_nothrow_relocatable<T, I>, "T must be nothrow relocatable.");
+    std::ptrdiff_t len = last - first;
+    for (std::ptrdiff_t parent = len / 2 - 1; parent >= 0; --parent) {
+        detail::hole<optional_v2<T, I>> h(first + parent);
+        detail::sift_down(first, len, h, comp);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename Compare = std::less<>>
+// void sort_heap(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {});
+//
+//  Sorts the max heap [first, last).
+template <typename T, typename I, typename Compare = std::less<>>
+void sort_heap(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {})
+{
+    for (; last - first > 1; --last) {
+        pop_heap(first, last, comp);
+    }
+}
+
+namespace detail {
+    template <typename T, typename I, typename Compare>
+    void heap_sort(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare& comp)
+    {
+        ::afh::make_heap(first, last, std::ref(comp));
+        ::afh::sort_heap(first, last, std::ref(comp));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename Compare = std::less<>>
+// void sort(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {});
+//
+//  Sorts [first, last).  Introsort: quicksort partitioning around a median
+//  of 3 in a hole, heapsort if it recurses too deep and insertion sort for
+//  short ranges.  O(n log n), not stable.
+template <typename T, typename I, typename Compare = std::less<>>
+void sort(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {})
+{
+    static_assert(detail::is_nothrow_relocatable<T, I>, "T must be nothrow relocatable.");
+    detail::intro_sort(first, last, detail::sort_depth_limit(last - first), comp);
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename Compare = std::less<>>
+// void stable_sort(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {});
+//
+//  Sorts [first, last), keeping equal elements in their order.  Merge sort
+//  with a buffer of (last - first) / 2 uninitialised slots.  Throws
+//  std::bad_alloc, before touching the range, if it can't get the buffer.
+template <typename T, typename I, typename Compare = std::less<>>
+void stable_sort(optional_v2<T, I>* first, optional_v2<T, I>* last, Compare comp = {})
+{
+    static_assert(detail::is_nothrow_relocatable<T, I>, "T must be nothrow relocatable.");
+    if (last - first <= 16) {
+        detail::insertion_sort(first, last, comp);
+        return;
+    }
+    detail::relocation_buffer<optional_v2<T, I>> buffer(std::size_t(last - first) / 2);
+    detail::merge_sort(first, last, buffer.m_slots, comp);
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename Compare = std::less<>>
+// void nth_element(optional_v2<T, I>* first, optional_v2<T, I>* nth, optional_v2<T, I>* last, Compare comp = {});
+//
+//  Puts the element that belongs at nth in sorted order there, with no
+//  greater elements before it and no lesser ones after it.  Average O(n).
+template <typename T, typename I, typename Compare = std::less<>>
+void nth_element(optional_v2<T, I>* first, optional_v2<T, I>* nth, optional_v2<T, I>* last, Compare comp = {})
+{
+    static_assert(detail::is_nothrow_relocatable<T, I>, "T must be nothrow relocatable.");
+    if (nth == last) {
+        return;
+    }
+    int depth = detail::sort_depth_limit(last - first);
+    while (last - first > 16) {
+        if (depth-- == 0) {
+            detail::heap_sort(first, last, comp);
+            return;
+        }
+        auto* pivot = detail::partition_pivot(first, last, comp);
+        if (pivot == nth) {
+            return;
+        }
+        if (nth < pivot) {
+            last = pivot;
+        }
+        else {
+            first = pivot + 1;
+        }
+    }
+    detail::insertion_sort(first, last, comp);
+}
+
+//=============================================================================
+//  Removing elements from ranges of optional_v2<T>.  Survivors are relocated
+//  down into the holes left by removed elements, a whole run at a time (so a
+//  memmove for trivially relocatable types), keeping their order.  Only the
+//  removed elements are destructed, or moved out to sink and dropped.  The
+//  slots in [new end, last) are left as tombstoned husks that need no
+//  destructor.  Slots that are already tombstoned are treated as removed.
+//
+//  If pred or sink throws, the holes made so far are filled with tombstoned
+//  husks, so every slot is still valid, but some survivors may not have been
+//  moved down yet.
+namespace detail {
+    // The sink used when removed elements are to be destructed.
+    struct destroy_removed
+    {
+        template <typename T>
+        void operator()(T&&) const noexcept {}
+        static constexpr bool moves_out = false;
+    };
+
+    template <typename Slot, typename Sink>
+    void dispose(Slot* slot, Sink& sink)
+    {
+        if constexpr (Sink::moves_out) {
+            if (slot->has_value()) {
+                // Move out before calling sink, so that the value is destroyed
+                // even if sink doesn't move from it or throws.
+                remove_cvref_t<decltype(slot->value())> value(std::move(*slot).value());
+                slot->has_been_moved();
+                drop_husk(slot);
+                sink(std::move(value));
+            }
+            else {
+                drop_husk(slot);
+            }
+        }
+        else {
+            if (slot->has_value()) {
+                std::destroy_at(slot);
+            }
+            else {
+                drop_husk(slot);
+            }
+        }
+    }
+
+    template <typename Sink>
+    struct moving_sink
+    {
+        Sink& sink;
+        template <typename T>
+        void operator()(T&& value) { sink(std::forward<T>(value)); }
+        static constexpr bool moves_out = true;
+    };
+
+    // keep(slot, kept) says if slot is kept, where kept is the last slot
+    // kept so far (or nullptr).
+    template <typename T, typename I, typename Keep, typename Sink>
+    optional_v2<T, I>* remove_relocate(optional_v2<T, I>* first, optional_v2<T, I>* last, Keep keep, Sink sink)
+    {
+        static_assert(is_nothrow_relocatable<T, I>, "T must be nothrow relocatable.");
+        using slot = optional_v2<T, I>;
+        slot* kept = nullptr;
+        while (first != last && keep(first, kept)) {
+            kept = first++;
+        }
+        // [dest, next) are holes and [next, last) are untouched.
+        slot* dest = first;
+        slot* next = first;
+        struct fill_holes {
+            slot*& dest; slot*& next;
+            ~fill_holes()
+            {
+                for (slot* hole = dest; hole != next; ++hole) {
+                    new (hole) slot(tombstone_tag{});
+                }
+            }
+        } guard{ dest, next };
+        while (next != last) {
+            if (!keep(next, kept)) {
+                dispose(next, sink);
+                ++next;
+                continue;
+            }
+            slot* run_end = next;
+            do {
+                kept = run_end++;
+            } while (run_end != last && keep(run_end, kept));
+            dest = uninitialized_relocate(next, run_end, dest);
+            next = run_end;
+            kept = dest - 1;
+        }
+        return dest;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename Pred>
+// optional_v2<T, I>* remove_if(optional_v2<T, I>* first, optional_v2<T, I>* last, Pred pred);
+//
+// template <typename T, typename I, typename Pred, typename Sink>
+// optional_v2<T, I>* remove_if(optional_v2<T, I>* first, optional_v2<T, I>* last, Pred pred, Sink&& sink);
+//
+//  Removes the elements for which pred(T const&) is true, and returns the new
+//  end.  The second overload calls sink(T&&) with each removed element
+//  instead of destructing it.
+template <typename T, typename I, typename Pred>
+optional_v2<T, I>* remove_if(optional_v2<T, I>* first, optional_v2<T, I>* last, Pred pred)
+{
+    return detail::remove_relocate(first, last, [&pred](optional_v2<T, I>* slot, optional_v2<T, I>*) {
+        return slot->has_value() && !pred(std::as_const(*slot).value());
+    }, detail::destroy_removed());
+}
+
+template <typename T, typename I, typename Pred, typename Sink>
+optional_v2<T, I>* remove_if(optional_v2<T, I>* first, optional_v2<T, I>* last, Pred pred, Sink&& sink)
+{
+    return detail::remove_relocate(first, last, [&pred](optional_v2<T, I>* slot, optional_v2<T, I>*) {
+        return slot->has_value() && !pred(std::as_const(*slot).value());
+    }, detail::moving_sink<std::remove_reference_t<Sink>>{ sink });
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename BinaryPred = std::equal_to<>>
+// optional_v2<T, I>* unique(optional_v2<T, I>* first, optional_v2<T, I>* last, BinaryPred pred = {});
+//
+// template <typename T, typename I, typename BinaryPred, typename Sink>
+// optional_v2<T, I>* unique(optional_v2<T, I>* first, optional_v2<T, I>* last, BinaryPred pred, Sink&& sink);
+//
+//  Removes each element for which pred(kept, element) is true, where kept is
+//  the last element kept before it, and returns the new end.  The second
+//  overload calls sink(T&&) with each removed element instead of destructing
+//  it.
+template <typename T, typename I, typename BinaryPred = std::equal_to<>>
+optional_v2<T, I>* unique(optional_v2<T, I>* first, optional_v2<T, I>* last, BinaryPred pred = {})
+{
+    return detail::remove_relocate(first, last, [&pred](optional_v2<T, I>* slot, optional_v2<T, I>* kept) {
+        return slot->has_value() && !(kept && pred(std::as_const(*kept).value(), std::as_const(*slot).value()));
+    }, detail::destroy_removed());
+}
+
+template <typename T, typename I, typename BinaryPred, typename Sink>
+optional_v2<T, I>* unique(optional_v2<T, I>* first, optional_v2<T, I>* last, BinaryPred pred, Sink&& sink)
+{
+    return detail::remove_relocate(first, last, [&pred](optional_v2<T, I>* slot, optional_v2<T, I>* kept) {
+        return slot->has_value() && !(kept && pred(std::as_const(*kept).value(), std::as_const(*slot).value()));
+    }, detail::moving_sink<std::remove_reference_t<Sink>>{ sink });
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I, typename A, typename Pred>
+// std::size_t erase_if(std::vector<optional_v2<T, I>, A>& v, Pred pred);
+//
+//  Removes the elements for which pred(T const&) is true with remove_if()
+//  and erases the tombstoned tail.  Returns the number of elements erased.
+//  dm_vector.hpp has one for afh::dm_vector<T>.
+template <typename T, typename I, typename A, typename Pred>
+std::size_t erase_if(std::vector<optional_v2<T, I>, A>& v, Pred pred)
+{
+    auto* first   = v.data();
+    auto* new_end = ::afh::remove_if(first, first + v.size(), std::move(pred));
+    std::size_t erased = v.size() - std::size_t(new_end - first);
+    v.erase(v.begin() + (new_end - first), v.end());
+    return erased;
+}
+
+} // namespace afh
+#endif // #ifndef AFH_DM_ALGORITHM_HPP__
@@ -0,0 +1,215 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DM_ARENA_HPP__
+#define AFH_DM_ARENA_HPP__
+
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace afh {
+
+//=============================================================================
+// class dm_arena;
+//
+//  A monotonic arena that hands out optional_v2<T> objects.  Memory is only
+//  given back all at once by reset() (or the destructor).
+//
+//  Objects whose optional_v2<T> isn't trivially destructible are recorded in
+//  a registry of { object, teardown function } pairs.  On reset(), the
+//  registry is walked in reverse order of creation and only the objects that
+//  still have a value get their destructor called.  Objects that have been
+//  moved out of (and been told so with has_been_moved()) are dropped on the
+//  floor, apart from their destructive_move_exempt members.  Trivially
+//  destructible objects aren't recorded at all.  So teardown costs a
+//  tombstone check per recorded object plus a destructor per survivor, and
+//  then one deallocation per block.
+//
+////
+// Members
+////
+//  explicit dm_arena(std::size_t block_size = 4096);
+//
+//   Memory is allocated in blocks that start at block_size bytes and double
+//   up to 1 MiB.  Larger requests get a block of their own.
+//
+//  template <typename T, typename...Ts>
+//  optional_v2<T>* make(Ts&&...args);
+//
+//   Constructs an optional_v2<T> from args in the arena.  args are forwarded
+//   to the optional_v2<T> constructor.
+//
+//  void* allocate(std::size_t size, std::size_t alignment);
+//
+//   Raw memory that is never destructed.
+//
+//  void reset() noexcept;
+//
+//   Destructs the survivors and frees all memory.
+class dm_arena
+{
+public:
+    using size_type = std::size_t;
+
+    explicit dm_arena(size_type block_size = 4096) noexcept
+        : m_next_block_size(std::max(block_size, min_block_size))
+        , m_first_block_size(m_next_block_size)
+    {}
+
+    dm_arena(dm_arena const&) = delete;
+    dm_arena& operator=(dm_arena const&) = delete;
+
+    dm_arena(dm_arena&& other) noexcept
+        : m_registry        (std::move(other.m_registry))
+        , m_block           (std::exchange(other.m_block, nullptr))
+        , m_current         (std::exchange(other.m_current, nullptr))
+        , m_end             (std::exchange(other.m_end, nullptr))
+        , m_bytes           (std::exchange(other.m_bytes, 0))
+        , m_next_block_size (std::exchange(other.m_next_block_size, other.m_first_block_size))
+        , m_first_block_size(other.m_first_block_size)
+    {
+        other.m_registry.clear();
+    }
+
+    dm_arena& operator=(dm_arena&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            m_registry         = std::move(other.m_registry);
+            m_block            = std::exchange(other.m_block, nullptr);
+            m_current          = std::exchange(other.m_current, nullptr);
+            m_end              = std::exchange(other.m_end, nullptr);
+            m_bytes            = std::exchange(other.m_bytes, 0);
+            m_next_block_size  = std::exchange(other.m_next_block_size, other.m_first_block_size);
+            m_first_block_size = other.m_first_block_size;
+            other.m_registry.clear();
+        }
+        return *this;
+    }
+
+    ~dm_arena()
+    {
+        reset();
+    }
+
+    template <typename T, typename...Ts>
+    optional_v2<T>* make(Ts&&...args)
+    {
+        using slot = optional_v2<T>;
+        void* memory = allocate(sizeof(slot), alignof(slot));
+        if constexpr (std::is_trivially_destructible_v<slot>) {
+            return new (memory) slot(std::forward<Ts>(args)...);
+        }
+        else {
+            // Make room first, so that recording it can't fail after it's
+            // constructed.
+            if (m_registry.size() == m_registry.capacity()) {
+                m_registry.reserve(std::max<size_type>(16, m_registry.capacity() * 2));
+            }
+            slot* object = new (memory) slot(std::forward<Ts>(args)...);
+            m_registry.push_back({ object, &teardown<T> });
+            return object;
+        }
+    }
+
+    void* allocate(size_type size, size_type alignment)
+    {
+        assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+        char* p = align_up(m_current, alignment);
+        if (!m_current || p + size > m_end) {
+            add_block(size + alignment);
+            p = align_up(m_current, alignment);
+        }
+        m_current = p + size;
+        return p;
+    }
+
+    void reset() noexcept
+    {
+        for (auto it = m_registry.rbegin(); it != m_registry.rend(); ++it) {
+            it->teardown(it->object);
+        }
+        m_registry.clear();
+        while (m_block) {
+            ::operator delete(std::exchange(m_block, m_block->prev));
+        }
+        m_current         = nullptr;
+        m_end             = nullptr;
+        m_bytes           = 0;
+        m_next_block_size = m_first_block_size;
+    }
+
+    // Number of objects that will be checked on reset().
+    size_type registered()      const noexcept { return m_registry.size(); }
+    // Number of bytes allocated from the system.
+    size_type bytes_allocated() const noexcept { return m_bytes; }
+
+private:
+    static constexpr size_type min_block_size = 256;
+    static constexpr size_type max_block_size = size_type(1) << 20;
+
+    struct block {
+        block* prev;
+    };
+
+    struct registry_entry {
+        void* object;
+        void (*teardown)(void*) noexcept;
+    };
+
+    template <typename T>
+    static void teardown(void* object) noexcept
+    {
+        auto* slot = static_cast<optional_v2<T>*>(object);
+        if (slot->has_value()) {
+            std::destroy_at(slot);
+        }
+        else {
+            detail::drop_husk(slot);
+        }
+    }
+
+    static char* align_up(char* p, size_type alignment) noexcept
+    {
+        return reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(p) + alignment - 1) & ~std::uintptr_t(alignment - 1));
+    }
+
+    void add_block(size_type at_least)
+    {
+        size_type size = std::max(m_next_block_size, at_least + sizeof(block));
+        auto*     b    = static_cast<block*>(::operator new(size));
+        b->prev   = m_block;
+        m_block   = b;
+        m_current = reinterpret_cast<char*>(b + 1);
+        m_end     = reinterpret_cast<char*>(b) + size;
+        m_bytes  += size;
+        m_next_block_size = std::min(m_next_block_size * 2, max_block_size);
+    }
+
+    std::vector<registry_entry> m_registry;
+    block*                      m_block            = nullptr;
+    char*                       m_current          = nullptr;
+    char*                       m_end              = nullptr;
+    size_type                   m_bytes            = 0;
+    size_type                   m_next_block_size;
+    size_type                   m_first_block_size;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_DM_ARENA_HPP__
@@ -0,0 +1,587 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DM_FLAT_MAP_HPP__
+#define AFH_DM_FLAT_MAP_HPP__
+
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <initializer_list>
+
+namespace afh {
+
+//=============================================================================
+// template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+// class dm_flat_map;
+//
+//  An open addressing hash map with linear probing, where each slot is an
+//  optional_v2<std::pair<K, V>>.  Whether a slot is occupied is the slot's
+//  own tombstone (internal or external), so there is no separate control
+//  array.  The exception is a trivially destructible pair without
+//  Tombstone_functions (e.g. std::pair<int, int>), whose optional_v2 can't be
+//  tombstoned, so the map keeps an array of occupied flags for it instead.
+//
+//  Erasing uses backward shift deletion instead of leaving deleted markers:
+//  the entries after the hole that would be closer to their home slot are
+//  relocated back into it.  Relocation moves each entry and drops the husk
+//  left behind without calling its destructor, and the same is done when
+//  rehashing into a bigger table.
+//
+////
+// Template Parameters
+////
+//  K, V (required key and mapped types)
+//
+//  Hash, KeyEqual (optional)
+//
+//   Same as for std::unordered_map.  The hash is mixed before use, so an
+//   identity hash is fine.
+//
+////
+// Differences from std::unordered_map
+////
+//  value_type is std::pair<K, V>, not std::pair<K const, V>, so that entries
+//  can be relocated.  Don't modify the key through an iterator.
+//
+//  Every insert or erase can relocate other entries, which invalidates all
+//  iterators and references.
+//
+//  erase(const_iterator) returns nothing, as backward shift deletion can move
+//  an entry that has already been visited in front of pos.
+//
+////
+// Modifiers
+////
+//  template <typename...Ts>
+//  std::pair<iterator, bool> try_emplace(K const& key, Ts&&...args);
+//  template <typename...Ts>
+//  std::pair<iterator, bool> try_emplace(K     && key, Ts&&...args);
+//
+//   If key isn't in the map, constructs V from args in place.
+//
+//  size_type erase(K const& key);
+//  void      erase(const_iterator pos);
+//
+//   Destructs the entry and closes the hole.
+//
+//  extracted_type extract(K const& key);
+//  value_type     extract(const_iterator pos);
+//
+//   Moves the entry out, drops its husk and closes the hole.  The first
+//   returns an empty extracted_type if key isn't in the map.  That is
+//   optional_v2<value_type>, or std::optional<value_type> if an optional_v2
+//   of it can't be tombstoned.
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class dm_flat_map
+{
+public:
+    using key_type        = K;
+    using mapped_type     = V;
+    using value_type      = std::pair<K, V>;
+    using slot_type       = optional_v2<value_type>;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher          = Hash;
+    using key_equal       = KeyEqual;
+    using reference       = value_type&;
+    using const_reference = value_type const&;
+    using pointer         = value_type*;
+    using const_pointer   = value_type const*;
+
+private:
+    // If false, m_occupied says which slots are occupied.
+    static constexpr bool slot_has_tombstone
+        = !std::is_trivially_destructible_v<value_type> || !std::is_void_v<optional_v2_tombstone_functions<value_type>>;
+
+    template <typename Slot>
+    class iterator_impl
+    {
+        friend class dm_flat_map;
+        Slot*       m_slot     = nullptr;
+        Slot*       m_end      = nullptr;
+        bool const* m_occupied = nullptr;
+
+        iterator_impl(Slot* slot, Slot* end, bool const* occupied) noexcept
+            : m_slot    (slot)
+            , m_end     (end)
+            , m_occupied(occupied)
+        {
+            skip_empty();
+        }
+
+        bool is_empty() const noexcept
+        {
+            if constexpr (slot_has_tombstone) {
+                return m_slot->is_tombstoned();
+            }
+            else {
+                return !*m_occupied;
+            }
+        }
+
+        void next() noexcept
+        {
+            ++m_slot;
+            if constexpr (!slot_has_tombstone) {
+                ++m_occupied;
+            }
+        }
+
+        void skip_empty() noexcept
+        {
+            while (m_slot != m_end && is_empty()) {
+                next();
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = dm_flat_map::value_type;
+        using difference_type   = std::ptrdiff_t;
+        using reference         = decltype(std::declval<Slot&>().value());
+        using pointer           = std::remove_reference_t<reference>*;
+
+        iterator_impl() noexcept = default;
+
+        // iterator converts to const_iterator.
+        template <typename Other, std::enable_if_t<std::is_convertible_v<Other*, Slot*>, int> = 0>
+        iterator_impl(iterator_impl<Other> const& other) noexcept
+            : m_slot    (other.m_slot)
+            , m_end     (other.m_end)
+            , m_occupied(other.m_occupied)
+        {}
+
+        reference operator* () const noexcept { return m_slot->value(); }
+        pointer   operator->() const noexcept { return std::addressof(m_slot->value()); }
+
+        iterator_impl& operator++()    noexcept { next(); skip_empty(); return *this; }
+        iterator_impl  operator++(int) noexcept { iterator_impl result = *this; ++*this; return result; }
+
+        friend bool operator==(iterator_impl const& lhs, iterator_impl const& rhs) noexcept { return lhs.m_slot == rhs.m_slot; }
+        friend bool operator!=(iterator_impl const& lhs, iterator_impl const& rhs) noexcept { return lhs.m_slot != rhs.m_slot; }
+
+        template <typename Other>
+        friend class iterator_impl;
+    };
+
+public:
+    using iterator       = iterator_impl<slot_type>;
+    using const_iterator = iterator_impl<slot_type const>;
+
+    dm_flat_map() noexcept = default;
+
+    explicit dm_flat_map(size_type bucket_count, Hash const& hash = Hash(), KeyEqual const& equal = KeyEqual())
+        : m_hash (hash)
+        , m_equal(equal)
+    {
+        rehash(bucket_count);
+    }
+
+    dm_flat_map(std::initializer_list<value_type> init)
+    {
+        reserve(init.size());
+        for (auto& item : init) {
+            insert(item);
+        }
+    }
+
+    dm_flat_map(dm_flat_map const& other)
+        : m_hash (other.m_hash)
+        , m_equal(other.m_equal)
+    {
+        reserve(other.size());
+        for (auto& item : other) {
+            insert(item);
+        }
+    }
+
+    dm_flat_map(dm_flat_map&& other) noexcept
+        : m_slots   (std::exchange(other.m_slots   , nullptr))
+        , m_occupied(std::move(other.m_occupied))
+        , m_capacity(std::exchange(other.m_capacity, 0))
+        , m_size    (std::exchange(other.m_size    , 0))
+        , m_shift   (other.m_shift)
+        , m_hash    (std::move(other.m_hash))
+        , m_equal   (std::move(other.m_equal))
+    {}
+
+    dm_flat_map& operator=(dm_flat_map const& other)
+    {
+        if (this != &other) {
+            dm_flat_map(other).swap(*this);
+        }
+        return *this;
+    }
+
+    dm_flat_map& operator=(dm_flat_map&& other) noexcept
+    {
+        dm_flat_map(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~dm_flat_map()
+    {
+        destroy_table(m_slots, m_capacity);
+    }
+
+    // Iterators
+    iterator       begin()        noexcept { return make_iterator(0); }
+    const_iterator begin()  const noexcept { return make_iterator(0); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    iterator       end()          noexcept { return make_iterator(m_capacity); }
+    const_iterator end()    const noexcept { return make_iterator(m_capacity); }
+    const_iterator cend()   const noexcept { return end(); }
+
+    // Capacity
+    bool      empty()           const noexcept { return m_size == 0; }
+    size_type size()            const noexcept { return m_size; }
+    size_type bucket_count()    const noexcept { return m_capacity; }
+    float     load_factor()     const noexcept { return m_capacity ? float(m_size) / float(m_capacity) : 0.0f; }
+    float     max_load_factor() const noexcept { return float(max_load_num) / float(max_load_den); }
+
+    // Lookup
+    iterator find(K const& key) noexcept
+    {
+        size_type i = find_index(key);
+        return i == npos ? end() : make_iterator(i);
+    }
+
+    const_iterator find(K const& key) const noexcept
+    {
+        size_type i = find_index(key);
+        return i == npos ? end() : make_iterator(i);
+    }
+
+    bool      contains(K const& key) const noexcept { return find_index(key) != npos; }
+    size_type count   (K const& key) const noexcept { return find_index(key) != npos; }
+
+    V& at(K const& key)
+    {
+        size_type i = find_index(key);
+        if (i == npos) {
+            throw std::out_of_range("dm_flat_map key not found");
+        }
+        return m_slots[i]->second;
+    }
+
+    V const& at(K const& key) const
+    {
+        return const_cast<dm_flat_map&>(*this).at(key);
+    }
+
+    V& operator[](K const& key) { return try_emplace(key).first->second; }
+    V& operator[](K     && key) { return try_emplace(std::move(key)).first->second; }
+
+    // Modifiers
+    template <typename...Ts>
+    std::pair<iterator, bool> try_emplace(K const& key, Ts&&...args)
+    {
+        return emplace_key(key, std::forward<Ts>(args)...);
+    }
+
+    template <typename...Ts>
+    std::pair<iterator, bool> try_emplace(K&& key, Ts&&...args)
+    {
+        return emplace_key(std::move(key), std::forward<Ts>(args)...);
+    }
+
+    std::pair<iterator, bool> insert(value_type const& value) { return emplace_key(value.first, value.second); }
+    std::pair<iterator, bool> insert(value_type     && value) { return emplace_key(std::move(value.first), std::move(value.second)); }
+
+    template <typename...Ts>
+    std::pair<iterator, bool> emplace(Ts&&...args)
+    {
+        return insert(value_type(std::forward<Ts>(args)...));
+    }
+
+    size_type erase(K const& key)
+    {
+        size_type i = find_index(key);
+        if (i == npos) {
+            return 0;
+        }
+        erase_at(i);
+        return 1;
+    }
+
+    void erase(const_iterator pos)
+    {
+        erase_at(pos.m_slot - m_slots);
+    }
+
+    using extracted_type = std::conditional_t<slot_has_tombstone, optional_v2<value_type>, std::optional<value_type>>;
+
+    extracted_type extract(K const& key)
+    {
+        size_type i = find_index(key);
+        if (i == npos) {
+            if constexpr (slot_has_tombstone) {
+                return extracted_type(tombstone_tag{});
+            }
+            else {
+                return extracted_type();
+            }
+        }
+        return extracted_type(extract_at(i));
+    }
+
+    value_type extract(const_iterator pos)
+    {
+        return extract_at(pos.m_slot - m_slots);
+    }
+
+    void clear() noexcept
+    {
+        for (size_type i = 0; i < m_capacity && m_size != 0; ++i) {
+            if (occupied(i)) {
+                m_slots[i].reset();
+                set_occupied(i, false);
+                --m_size;
+            }
+        }
+    }
+
+    // Makes the table at least count slots (rounded up to a power of 2) and
+    // big enough for size() entries, relocating every entry.
+    void rehash(size_type count)
+    {
+        size_type min_count = (m_size * max_load_den + max_load_num - 1) / max_load_num;
+        count = std::max({ count, min_count, min_capacity });
+        unsigned  bits         = 0;
+        while ((size_type(1) << bits) < count) {
+            ++bits;
+        }
+        size_type new_capacity = size_type(1) << bits;
+        if (new_capacity == m_capacity) {
+            return;
+        }
+
+        std::unique_ptr<bool[]> new_occupied;
+        if constexpr (!slot_has_tombstone) {
+            new_occupied.reset(new bool[new_capacity]());
+        }
+        slot_type* new_slots = allocate(new_capacity);
+        for (size_type i = 0; i < new_capacity; ++i) {
+            new (new_slots + i) slot_type(tombstone_tag{});
+        }
+
+        slot_type*              old_slots    = std::exchange(m_slots   , new_slots);
+        std::unique_ptr<bool[]> old_occupied = std::exchange(m_occupied, std::move(new_occupied));
+        size_type               old_capacity = std::exchange(m_capacity, new_capacity);
+        m_shift = 64 - bits;
+        for (size_type i = 0; i < old_capacity; ++i) {
+            slot_type* source = old_slots + i;
+            if (slot_has_tombstone ? source->has_value() : old_occupied[i]) {
+                size_type  j    = find_empty(source->value().first);
+                slot_type* dest = m_slots + j;
+                detail::drop_husk(dest);
+                relocate_at(source, dest);
+                set_occupied(j, true);
+            }
+            else {
+                detail::drop_husk(source);
+            }
+        }
+        deallocate(old_slots);
+    }
+
+    void reserve(size_type count)
+    {
+        size_type needed = (count * max_load_den + max_load_num - 1) / max_load_num;
+        if (needed > m_capacity) {
+            rehash(needed);
+        }
+    }
+
+    void swap(dm_flat_map& other) noexcept
+    {
+        using std::swap;
+        swap(m_slots   , other.m_slots);
+        swap(m_occupied, other.m_occupied);
+        swap(m_capacity, other.m_capacity);
+        swap(m_size    , other.m_size);
+        swap(m_shift   , other.m_shift);
+        swap(m_hash    , other.m_hash);
+        swap(m_equal   , other.m_equal);
+    }
+
+    friend void swap(dm_flat_map& lhs, dm_flat_map& rhs) noexcept
+    {
+        lhs.swap(rhs);
+    }
+
+    hasher    hash_function() const { return m_hash; }
+    key_equal key_eq()        const { return m_equal; }
+
+private:
+    static constexpr size_type npos         = size_type(-1);
+    static constexpr size_type min_capacity = 8;
+    static constexpr size_type max_load_num = 3;
+    static constexpr size_type max_load_den = 4;
+
+    static slot_type* allocate(size_type count)
+    {
+        return static_cast<slot_type*>(
+            ::operator new(count * sizeof(slot_type), std::align_val_t(alignof(slot_type))));
+    }
+
+    static void deallocate(slot_type* p) noexcept
+    {
+        if (p) {
+            ::operator delete(p, std::align_val_t(alignof(slot_type)));
+        }
+    }
+
+    static void destroy_table(slot_type* slots, size_type capacity) noexcept
+    {
+        destroy_n(slots, capacity);
+        deallocate(slots);
+    }
+
+    size_type next(size_type i) const noexcept { return (i + 1) & (m_capacity - 1); }
+
+    bool occupied(size_type i) const noexcept
+    {
+        if constexpr (slot_has_tombstone) {
+            return m_slots[i].has_value();
+        }
+        else {
+            return m_occupied[i];
+        }
+    }
+
+    void set_occupied(size_type i, bool value) noexcept
+    {
+        if constexpr (!slot_has_tombstone) {
+            m_occupied[i] = value;
+        }
+    }
+
+    iterator make_iterator(size_type i) noexcept
+    {
+        return iterator(m_slots + i, m_slots + m_capacity, m_occupied.get() + (m_occupied ? i : 0));
+    }
+
+    const_iterator make_iterator(size_type i) const noexcept
+    {
+        return const_iterator(m_slots + i, m_slots + m_capacity, m_occupied.get() + (m_occupied ? i : 0));
+    }
+
+    // Fibonacci hashing, so that a poor hash (such as the identity hash of
+    // std::hash<int>) still spreads over the table.
+    size_type home(K const& key) const noexcept
+    {
+        return size_type((std::uint64_t(m_hash(key)) * 0x9E3779B97F4A7C15ull) >> m_shift);
+    }
+
+    size_type find_index(K const& key) const noexcept
+    {
+        if (m_size == 0) {
+            return npos;
+        }
+        for (size_type i = home(key); occupied(i); i = next(i)) {
+            if (m_equal(m_slots[i]->first, key)) {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    // key must not be in the table.
+    size_type find_empty(K const& key) const noexcept
+    {
+        size_type i = home(key);
+        while (occupied(i)) {
+            i = next(i);
+        }
+        return i;
+    }
+
+    template <typename Key, typename...Ts>
+    std::pair<iterator, bool> emplace_key(Key&& key, Ts&&...args)
+    {
+        size_type i = find_index(key);
+        if (i != npos) {
+            return { make_iterator(i), false };
+        }
+        if ((m_size + 1) * max_load_den > m_capacity * max_load_num) {
+            rehash(m_capacity * 2);
+        }
+        i = find_empty(key);
+        m_slots[i].emplace(afh::emplace<value_type>(
+            std::piecewise_construct,
+            std::forward_as_tuple(std::forward<Key>(key)),
+            std::forward_as_tuple(std::forward<Ts>(args)...)));
+        set_occupied(i, true);
+        ++m_size;
+        return { make_iterator(i), true };
+    }
+
+    void erase_at(size_type i)
+    {
+        assert(i < m_capacity && occupied(i));
+        std::destroy_at(m_slots + i);
+        --m_size;
+        close_hole(i);
+    }
+
+    value_type extract_at(size_type i) noexcept(std::is_nothrow_move_constructible_v<value_type>)
+    {
+        assert(i < m_capacity && occupied(i));
+        slot_type* husk = m_slots + i;
+        value_type result(std::move(*husk).value());
+        husk->has_been_moved();
+        detail::drop_husk(husk);
+        --m_size;
+        close_hole(i);
+        return result;
+    }
+
+    // Slot hole is uninitialised memory.  Relocates each following entry that
+    // isn't closer to its home slot than the hole is into the hole, which
+    // opens a new hole where it was.  The final hole is made a tombstone.
+    void close_hole(size_type hole)
+    {
+        size_type mask = m_capacity - 1;
+        for (size_type i = next(hole); occupied(i); i = next(i)) {
+            size_type distance_from_home = (i - home(m_slots[i]->first)) & mask;
+            size_type distance_from_hole = (i - hole) & mask;
+            if (distance_from_hole <= distance_from_home) {
+                relocate_at(m_slots + i, m_slots + hole);
+                hole = i;
+            }
+        }
+        new (m_slots + hole) slot_type(tombstone_tag{});
+        set_occupied(hole, false);
+    }
+
+    slot_type*              m_slots    = nullptr;
+    std::unique_ptr<bool[]> m_occupied;
+    size_type               m_capacity = 0;
+    size_type               m_size     = 0;
+    unsigned                m_shift    = 64;
+    Hash                    m_hash;
+    KeyEqual                m_equal;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_DM_FLAT_MAP_HPP__
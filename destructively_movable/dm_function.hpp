@@ -0,0 +1,269 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DM_FUNCTION_HPP__
+#define AFH_DM_FUNCTION_HPP__
+
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace afh {
+
+//=============================================================================
+// template <typename Sig, std::size_t InlineSize = 3 * sizeof(void*)>
+// class dm_function;
+//
+// template <typename R, typename...Args, std::size_t InlineSize>
+// class dm_function<R(Args...), InlineSize>;
+//
+//  A move only, type erased callable like std::function, that keeps the
+//  callable in InlineSize bytes of inline storage when it fits.  Moving a
+//  dm_function relocates the callable and leaves the source empty:
+//
+//   - A callable that is_trivially_relocatable is memcpy'd.
+//   - Otherwise it is held as an optional_v2<F>, so it is moved and its husk
+//     dropped, only destructing its destructive_move_exempt members.
+//
+//  A callable that doesn't fit, is over aligned, whose relocation may throw
+//  or that can't be held in an optional_v2 (see is_destructive_move_disabled)
+//  is put on the heap, and then moving is copying a pointer.
+//
+//  An optional_v2<dm_function> uses the low bit of the vtable pointer as its
+//  tombstone, so it is the same size as the dm_function.
+//
+////
+// Members
+////
+//  dm_function() noexcept;
+//  dm_function(std::nullptr_t) noexcept;
+//
+//   Empty.
+//
+//  template <typename F>
+//  dm_function(F&& f);
+//
+//   Holds a std::decay_t<F> made from f.  Empty if f is a null function or
+//   member pointer.
+//
+//  R operator()(Args...args) const;
+//
+//   Calls the callable.  Throws std::bad_function_call if empty.
+//
+//  template <typename F>
+//  static constexpr bool stored_inline;
+//
+//   If a callable of type F is kept in the inline storage.
+template <typename Sig, std::size_t InlineSize = 3 * sizeof(void*)>
+class dm_function;
+
+template <typename R, typename...Args, std::size_t InlineSize>
+class dm_function<R(Args...), InlineSize>
+{
+    static_assert(InlineSize >= sizeof(void*), "InlineSize must be able to hold a pointer.");
+
+    struct vtable {
+        R    (*invoke  )(void* storage, Args&&...args);
+        void (*relocate)(void* from, void* to) noexcept; // nullptr: memcpy the storage
+        void (*destroy )(void* storage) noexcept;        // nullptr: nothing to do
+    };
+
+    template <typename F>
+    static R call(F& f, Args&&...args)
+    {
+        if constexpr (std::is_void_v<R>) {
+            std::invoke(f, std::forward<Args>(args)...);
+        }
+        else {
+            return std::invoke(f, std::forward<Args>(args)...);
+        }
+    }
+
+    // Inline callables are held as an optional_v2<F>.
+    template <typename F>
+    static optional_v2<F>* slot(void* storage) noexcept
+    {
+        return std::launder(reinterpret_cast<optional_v2<F>*>(storage));
+    }
+
+    template <typename F>
+    static F*& pointer(void* storage) noexcept
+    {
+        return *std::launder(reinterpret_cast<F**>(storage));
+    }
+
+    template <typename F>
+    static constexpr bool fits_inline() noexcept
+    {
+        // optional_v2<F> can't even be named for some F.
+        if constexpr (!is_destructive_move_disabled<F>) {
+            return false;
+        }
+        else {
+            return sizeof(optional_v2<F>) <= InlineSize
+                && alignof(optional_v2<F>) <= alignof(void*)
+                && detail::is_nothrow_relocatable<F, void>;
+        }
+    }
+
+    template <typename F>
+    static constexpr vtable inline_vtable = {
+        [](void* storage, Args&&...args) -> R { return call(slot<F>(storage)->value(), std::forward<Args>(args)...); },
+        is_trivially_relocatable<F>
+            ? nullptr
+            : +[](void* from, void* to) noexcept { relocate_at(slot<F>(from), slot<F>(to)); },
+        std::is_trivially_destructible_v<optional_v2<F>>
+            ? nullptr
+            : +[](void* storage) noexcept { std::destroy_at(slot<F>(storage)); }
+    };
+
+    template <typename F>
+    static constexpr vtable heap_vtable = {
+        [](void* storage, Args&&...args) -> R { return call(*pointer<F>(storage), std::forward<Args>(args)...); },
+        nullptr,
+        [](void* storage) noexcept { delete pointer<F>(storage); }
+    };
+
+public:
+    using result_type = R;
+
+    template <typename F>
+    static constexpr bool stored_inline = fits_inline<F>();
+
+    dm_function() noexcept = default;
+    dm_function(std::nullptr_t) noexcept {}
+
+    template <typename F, typename = std::enable_if_t<
+        !std::is_same_v<std::decay_t<F>, dm_function>
+        && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>
+    >>
+    dm_function(F&& f)
+    {
+        using functor = std::decay_t<F>;
+        // A function (or array) reference decays to a pointer that can't be
+        // null, so only a pointer that was passed as one is checked.
+        using passed  = std::remove_cv_t<std::remove_reference_t<F>>;
+        if constexpr (std::is_pointer_v<passed> || std::is_member_pointer_v<passed>) {
+            if (!f) {
+                return;
+            }
+        }
+        if constexpr (stored_inline<functor>) {
+            new (m_storage) optional_v2<functor>(emplace<functor>(std::forward<F>(f)));
+            m_vtable = &inline_vtable<functor>;
+        }
+        else {
+            new (m_storage) functor*(new functor(std::forward<F>(f)));
+            m_vtable = &heap_vtable<functor>;
+        }
+    }
+
+    dm_function(dm_function&& other) noexcept
+    {
+        take(other);
+    }
+
+    dm_function& operator=(dm_function&& other) noexcept
+    {
+        if (this != &other) {
+            destroy();
+            take(other);
+        }
+        return *this;
+    }
+
+    dm_function& operator=(std::nullptr_t) noexcept
+    {
+        destroy();
+        return *this;
+    }
+
+    template <typename F, typename = std::enable_if_t<
+        !std::is_same_v<std::decay_t<F>, dm_function>
+        && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>
+    >>
+    dm_function& operator=(F&& f)
+    {
+        return *this = dm_function(std::forward<F>(f));
+    }
+
+    ~dm_function()
+    {
+        destroy();
+    }
+
+    void swap(dm_function& other) noexcept
+    {
+        dm_function temp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+
+    friend void swap(dm_function& a, dm_function& b) noexcept { a.swap(b); }
+
+    explicit operator bool() const noexcept { return m_vtable != nullptr; }
+
+    friend bool operator==(dm_function const& f, std::nullptr_t) noexcept { return !f; }
+    friend bool operator!=(dm_function const& f, std::nullptr_t) noexcept { return bool(f); }
+
+    R operator()(Args...args) const
+    {
+        if (!m_vtable) {
+            throw std::bad_function_call();
+        }
+        return m_vtable->invoke(const_cast<unsigned char*>(m_storage), std::forward<Args>(args)...);
+    }
+
+private:
+    // Relocates other's callable here.  *this must be empty.
+    void take(dm_function& other) noexcept
+    {
+        m_vtable = other.m_vtable;
+        if (m_vtable) {
+            if (m_vtable->relocate) {
+                m_vtable->relocate(other.m_storage, m_storage);
+            }
+            else {
+                std::memcpy(m_storage, other.m_storage, InlineSize);
+            }
+            other.m_vtable = nullptr;
+        }
+    }
+
+    void destroy() noexcept
+    {
+        if (m_vtable) {
+            if (m_vtable->destroy) {
+                m_vtable->destroy(m_storage);
+            }
+            m_vtable = nullptr;
+        }
+    }
+
+    alignas(void*) unsigned char m_storage[InlineSize];
+    vtable const*                m_vtable = nullptr;
+
+public:
+    // An empty dm_function has a null vtable pointer, so the tombstone is its
+    // low bit instead.
+    using Tombstone_functions = tombstone_via_low_bit<&dm_function::m_vtable>;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_DM_FUNCTION_HPP__
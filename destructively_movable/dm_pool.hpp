@@ -0,0 +1,293 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DM_POOL_HPP__
+#define AFH_DM_POOL_HPP__
+
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+namespace afh {
+
+//=============================================================================
+// template <typename T>
+// class dm_pool;
+//
+//  A slab allocator of optional_v2<T> slots.  A released slot is dropped on
+//  the floor (its destructor is only called if it still has a value) and the
+//  link to the next free slot is written straight into the husk, so the free
+//  list needs no memory of its own and acquiring and releasing are O(1).
+//
+//  Slots never move, so pointers to them stay valid until they are released.
+//
+////
+// Template Parameters
+////
+//  T (required contained type)
+//
+//   This is the type to be contained.  Each slot is an optional_v2<T>.
+//
+////
+// Members
+////
+//  explicit dm_pool(size_type slab_size = 64);
+//
+//   Memory is allocated slab_size slots at a time.
+//
+//  template <typename...Ts>
+//  value_type* emplace(Ts&&...args);
+//
+//   Takes a slot off the free list (or a new one from the current slab) and
+//   constructs it with args, which are forwarded to the optional_v2<T>
+//   constructor (so an afh::emplace<T>(...) object works too).
+//
+//  void release(value_type* slot) noexcept;
+//
+//   Returns the slot to the pool.  If it is tombstoned (the value was moved
+//   out and has_been_moved() was called), then no destructor is called other
+//   than for destructive_move_exempt members.
+//
+//  T take(value_type* slot);
+//
+//   Moves the value out, drops the husk and returns the slot to the pool.
+//
+//  ~dm_pool();
+//
+//   Destructs any slots that haven't been released.  Finding them sorts the
+//   free list in place (O(n log n), without allocating), so release
+//   everything first if teardown time matters.
+template <typename T>
+class dm_pool
+{
+public:
+    using value_type = optional_v2<T>;
+    using contained  = T;
+    using size_type  = std::size_t;
+
+    explicit dm_pool(size_type slab_size = 64) noexcept
+        : m_slab_size(slab_size ? slab_size : 1)
+    {}
+
+    dm_pool(dm_pool const&) = delete;
+    dm_pool& operator=(dm_pool const&) = delete;
+
+    dm_pool(dm_pool&& other) noexcept
+        : m_slabs     (std::move(other.m_slabs))
+        , m_free      (std::exchange(other.m_free     , nullptr))
+        , m_fresh     (std::exchange(other.m_fresh    , nullptr))
+        , m_fresh_end (std::exchange(other.m_fresh_end, nullptr))
+        , m_size      (std::exchange(other.m_size     , 0))
+        , m_slab_size (other.m_slab_size)
+    {
+        other.m_slabs.clear();
+    }
+
+    dm_pool& operator=(dm_pool&& other) noexcept
+    {
+        dm_pool(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~dm_pool()
+    {
+        destroy_unreleased();
+        for (cell* slab : m_slabs) {
+            deallocate(slab);
+        }
+    }
+
+    // Number of slots that have been acquired and not released.
+    size_type size()     const noexcept { return m_size; }
+    // Number of slots allocated.
+    size_type capacity() const noexcept { return m_slabs.size() * m_slab_size; }
+
+    template <typename...Ts>
+    value_type* emplace(Ts&&...args)
+    {
+        cell* c = acquire();
+        try {
+            value_type* slot = new (c) value_type(std::forward<Ts>(args)...);
+            ++m_size;
+            return slot;
+        }
+        catch (...) {
+            push_free(c);
+            throw;
+        }
+    }
+
+    void release(value_type* slot) noexcept
+    {
+        assert(slot && m_size != 0);
+        if (slot->has_value()) {
+            std::destroy_at(slot);
+        }
+        else {
+            detail::drop_husk(slot);
+        }
+        --m_size;
+        push_free(reinterpret_cast<cell*>(slot));
+    }
+
+    T take(value_type* slot) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        assert(slot && slot->has_value() && m_size != 0);
+        T result(std::move(*slot).value());
+        slot->has_been_moved();
+        detail::drop_husk(slot);
+        --m_size;
+        push_free(reinterpret_cast<cell*>(slot));
+        return result;
+    }
+
+    void swap(dm_pool& other) noexcept
+    {
+        using std::swap;
+        swap(m_slabs    , other.m_slabs);
+        swap(m_free     , other.m_free);
+        swap(m_fresh    , other.m_fresh);
+        swap(m_fresh_end, other.m_fresh_end);
+        swap(m_size     , other.m_size);
+        swap(m_slab_size, other.m_slab_size);
+    }
+
+    friend void swap(dm_pool& lhs, dm_pool& rhs) noexcept
+    {
+        lhs.swap(rhs);
+    }
+
+private:
+    // The layout of a husk while it is on the free list.
+    struct free_cell {
+        void* m_next;
+    };
+
+    struct alignas(std::max(alignof(value_type), alignof(free_cell))) cell {
+        unsigned char bytes[std::max(sizeof(value_type), sizeof(free_cell))];
+    };
+
+    static cell* allocate(size_type count)
+    {
+        return static_cast<cell*>(::operator new(count * sizeof(cell), std::align_val_t(alignof(cell))));
+    }
+
+    static void deallocate(cell* p) noexcept
+    {
+        ::operator delete(p, std::align_val_t(alignof(cell)));
+    }
+
+    static cell* next_free(cell* c) noexcept
+    {
+        return static_cast<cell*>(AFH___GET(c, free_cell, m_next));
+    }
+
+    static void set_next_free(cell* c, cell* next) noexcept
+    {
+        (void)AFH___SET(c, free_cell, m_next, next);
+    }
+
+    void push_free(cell* c) noexcept
+    {
+        set_next_free(c, m_free);
+        m_free = c;
+    }
+
+    // Merge sorts a free list into address order by relinking the cells, so
+    // nothing is allocated.
+    static cell* sort_free_list(cell* head) noexcept
+    {
+        if (!head || !next_free(head)) {
+            return head;
+        }
+        // Split after the middle cell.
+        cell* middle = head;
+        for (cell* fast = next_free(head); fast && next_free(fast); fast = next_free(next_free(fast))) {
+            middle = next_free(middle);
+        }
+        cell* second = next_free(middle);
+        set_next_free(middle, nullptr);
+
+        cell* a = sort_free_list(head);
+        cell* b = sort_free_list(second);
+        cell  dummy;
+        cell* tail = &dummy;
+        while (a && b) {
+            cell*& lower = std::less<cell*>()(a, b) ? a : b;
+            set_next_free(tail, lower);
+            tail  = lower;
+            lower = next_free(lower);
+        }
+        set_next_free(tail, a ? a : b);
+        return next_free(&dummy);
+    }
+
+    cell* acquire()
+    {
+        if (m_free) {
+            cell* c = m_free;
+            m_free = next_free(c);
+            return c;
+        }
+        if (m_fresh == m_fresh_end) {
+            m_slabs.reserve(m_slabs.size() + 1);
+            m_fresh     = allocate(m_slab_size);
+            m_fresh_end = m_fresh + m_slab_size;
+            m_slabs.push_back(m_fresh);
+        }
+        return m_fresh++;
+    }
+
+    void destroy_unreleased() noexcept
+    {
+        if constexpr (!std::is_trivially_destructible_v<value_type>) {
+            if (m_size == 0) {
+                return;
+            }
+            // With both the slabs and the free list in address order, the
+            // next free cell is always the next one to skip.
+            std::sort(m_slabs.begin(), m_slabs.end(), std::less<cell*>());
+            m_free = sort_free_list(m_free);
+            cell* next = m_free;
+            for (cell* slab : m_slabs) {
+                cell* end = slab + m_slab_size;
+                if (m_fresh_end == end) {
+                    end = m_fresh; // the rest of the current slab was never used
+                }
+                for (cell* c = slab; c != end; ++c) {
+                    if (c == next) {
+                        next = next_free(c);
+                    }
+                    else {
+                        std::destroy_at(std::launder(reinterpret_cast<value_type*>(c)));
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<cell*> m_slabs;
+    cell*              m_free      = nullptr;
+    cell*              m_fresh     = nullptr;
+    cell*              m_fresh_end = nullptr;
+    size_type          m_size      = 0;
+    size_type          m_slab_size;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_DM_POOL_HPP__
@@ -0,0 +1,192 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DM_STATS_HPP__
+#define AFH_DM_STATS_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// AFH_DM_STATS
+//
+//  The default for the collect_stats trait.  Define it to 1 before including
+//  destructively_movable.hpp to count every optional_v2.
+#ifndef AFH_DM_STATS
+# define AFH_DM_STATS 0
+#endif
+
+namespace afh {
+
+//=============================================================================
+// enum class dm_counter;
+//
+//  What dm_stats<T> counts for the optional_v2<T> objects of a type.
+//
+//   constructions              A Contained object was constructed.
+//   destructive_moves          A value was moved out and the husk tombstoned.
+//   destructions               A Contained destructor was called.
+//   elided_destructions        An optional_v2 was destructed or dropped while
+//                              tombstoned, so the Contained destructor wasn't
+//                              called.
+//   exempt_destructions        Of the elided destructions, those that still
+//                              destructed destructive_move_exempt members.
+//   internal_tombstone_checks  is_tombstoned() read an internal tombstone.
+//   external_tombstone_checks  is_tombstoned() read an external flag.
+enum class dm_counter : unsigned char
+{
+    constructions,
+    destructive_moves,
+    destructions,
+    elided_destructions,
+    exempt_destructions,
+    internal_tombstone_checks,
+    external_tombstone_checks,
+    count_ // number of counters
+};
+
+//=============================================================================
+// struct dm_counters;
+//
+//  A set of counts, indexed by dm_counter.
+struct dm_counters
+{
+    std::uint64_t counts[std::size_t(dm_counter::count_)] = {};
+
+    constexpr std::uint64_t  operator[](dm_counter counter) const noexcept { return counts[std::size_t(counter)]; }
+    constexpr std::uint64_t& operator[](dm_counter counter)       noexcept { return counts[std::size_t(counter)]; }
+
+    // Fraction of destructions that were elided.
+    double elision_ratio() const noexcept
+    {
+        std::uint64_t total = (*this)[dm_counter::destructions] + (*this)[dm_counter::elided_destructions];
+        return total ? double((*this)[dm_counter::elided_destructions]) / double(total) : 0.0;
+    }
+};
+
+constexpr char const* dm_counter_name(dm_counter counter) noexcept
+{
+    switch (counter) {
+    case dm_counter::constructions:             return "constructions";
+    case dm_counter::destructive_moves:         return "destructive_moves";
+    case dm_counter::destructions:              return "destructions";
+    case dm_counter::elided_destructions:       return "elided_destructions";
+    case dm_counter::exempt_destructions:       return "exempt_destructions";
+    case dm_counter::internal_tombstone_checks: return "internal_tombstone_checks";
+    case dm_counter::external_tombstone_checks: return "external_tombstone_checks";
+    case dm_counter::count_:                    break;
+    }
+    return "unknown";
+}
+
+//=============================================================================
+// template <typename T>
+// class dm_stats;
+//
+//  Counters for the optional_v2<T> objects of types that have the
+//  collect_stats trait set.  Each thread counts into its own block, with no
+//  locking and no shared cache lines.  Only a thread's first count takes a
+//  lock, to register its block.  Blocks outlive their threads.
+//
+////
+// Members
+////
+//  static void count(dm_counter counter) noexcept;
+//
+//   Adds one to counter for this thread.  Called by optional_v2.
+//
+//  static dm_counters totals();
+//
+//   The sum over all threads.  Counts that are being made at the same time
+//   may or may not be included.
+//
+//  static void clear() noexcept;
+//
+//   Zeroes the counters.  Must not run while other threads are counting.
+template <typename T>
+class dm_stats
+{
+    struct alignas(64) block {
+        std::atomic<std::uint64_t> counts[std::size_t(dm_counter::count_)] = {};
+    };
+
+    struct registry {
+        std::mutex                          m_mutex;
+        std::vector<std::unique_ptr<block>> m_blocks;
+    };
+
+    static registry& blocks() noexcept
+    {
+        static registry instance;
+        return instance;
+    }
+
+    static block* local() noexcept
+    {
+        thread_local block* mine = nullptr;
+        if (!mine) {
+            registry& r = blocks();
+            std::lock_guard<std::mutex> lock(r.m_mutex);
+            try {
+                r.m_blocks.reserve(r.m_blocks.size() + 1);
+                r.m_blocks.push_back(std::make_unique<block>());
+            }
+            catch (...) {
+                return nullptr; // counts are lost rather than thrown
+            }
+            mine = r.m_blocks.back().get();
+        }
+        return mine;
+    }
+
+public:
+    static void count(dm_counter counter) noexcept
+    {
+        if (block* b = local()) {
+            // Only this thread writes to it, so no read-modify-write is needed.
+            auto& c = b->counts[std::size_t(counter)];
+            c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    static dm_counters totals()
+    {
+        registry& r = blocks();
+        std::lock_guard<std::mutex> lock(r.m_mutex);
+        dm_counters result;
+        for (auto const& b : r.m_blocks) {
+            for (std::size_t i = 0; i < std::size_t(dm_counter::count_); ++i) {
+                result.counts[i] += b->counts[i].load(std::memory_order_relaxed);
+            }
+        }
+        return result;
+    }
+
+    static void clear() noexcept
+    {
+        registry& r = blocks();
+        std::lock_guard<std::mutex> lock(r.m_mutex);
+        for (auto const& b : r.m_blocks) {
+            for (auto& c : b->counts) {
+                c.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+} // namespace afh
+#endif // #ifndef AFH_DM_STATS_HPP__
@@ -0,0 +1,385 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DM_VARIANT_HPP__
+#define AFH_DM_VARIANT_HPP__
+
+#include "destructively_movable.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace afh {
+
+//-----------------------------------------------------------------------------
+namespace detail {
+    template <typename T, typename...Ts>
+    constexpr std::size_t count_of = (std::size_t(std::is_same_v<T, Ts>) + ... + 0);
+
+    template <typename T, typename...Ts>
+    constexpr std::size_t index_of()
+    {
+        std::size_t index = 0;
+        bool        found = false;
+        ((found || (std::is_same_v<T, Ts> ? (found = true) : (++index, false))), ...);
+        return index;
+    }
+}
+
+//=============================================================================
+// template <typename...Ts>
+// class dm_variant;
+//
+//  A variant whose moves are destructive.  Moving the active alternative out
+//  (with the move constructor, move assignment, get_and_drop() or
+//  visit_and_drop()) drops its husk, only destructing its
+//  destructive_move_exempt members, and leaves the dm_variant valueless.  A
+//  valueless dm_variant has nothing to destruct.
+//
+//  The index is stored as the active alternative + 1, so that 0 is the
+//  valueless state.  That doubles as the tombstone of an
+//  optional_v2<dm_variant>, which is then the same size as the dm_variant.
+//
+//  Each alternative must be allowed in an optional_v2.
+//
+////
+// Members
+////
+//  dm_variant();
+//
+//   Holds a value initialised first alternative.
+//
+//  template <typename T>
+//  dm_variant(T&& value);
+//
+//   Holds a std::decay_t<T> made from value.  Only if that is exactly one of
+//   the alternatives.
+//
+//  template <std::size_t I, typename...Args>
+//  explicit dm_variant(std::in_place_index_t<I>, Args&&...args);
+//  template <typename T, typename...Args>
+//  explicit dm_variant(std::in_place_type_t<T>, Args&&...args);
+//
+//   Holds the alternative made from args.
+//
+//  explicit dm_variant(tombstone_tag) noexcept;
+//
+//   Valueless.
+//
+//  std::size_t index() const noexcept;
+//
+//   The active alternative, or std::variant_npos if valueless.
+//
+//  template <std::size_t I> auto&& get() (&, const&, &&);
+//  template <typename T>    auto&& get() (&, const&, &&);
+//
+//   The active alternative, which must be I (or T).
+//
+//  template <std::size_t I> auto* get_if() (non const and const);
+//  template <typename T>    auto* get_if() (non const and const);
+//
+//   A pointer to the active alternative, or nullptr if that isn't I (or T).
+//
+//  template <std::size_t I> alternative<I> get_and_drop();
+//  template <typename T>    T              get_and_drop();
+//
+//   Moves the active alternative, which must be I (or T), out and leaves the
+//   dm_variant valueless.
+//
+//  template <typename Visitor>
+//  decltype(auto) visit(Visitor&& vis) (&, const&);
+//
+//   Calls vis with the active alternative, which must exist.
+//
+//  template <typename Visitor>
+//  decltype(auto) visit_and_drop(Visitor&& vis);
+//
+//   Moves the active alternative, which must exist, out and leaves the
+//   dm_variant valueless, then calls vis with it as an rvalue.
+//
+//  template <std::size_t I, typename...Args> alternative<I>& emplace(Args&&...args);
+//  template <typename T,    typename...Args> T&              emplace(Args&&...args);
+//
+//   Destructs the active alternative and makes alternative I (or T) from
+//   args.  If that throws, the dm_variant is left valueless.
+//
+//  void reset() noexcept;
+//
+//   Destructs the active alternative, if any, and leaves it valueless.
+template <typename...Ts>
+class dm_variant
+{
+    static_assert(sizeof...(Ts) != 0, "A dm_variant needs at least one alternative.");
+    static_assert((std::is_object_v<Ts> && ...) && (!std::is_array_v<Ts> && ...) && (!std::is_const_v<Ts> && ...)
+        , "Alternatives must be non const, non array object types.");
+    static_assert((afh::is_destructive_move_disabled<Ts> && ...)
+        , "Cannot hold an alternative that is marked disabled in a dm_variant");
+
+    using index_type = std::conditional_t<(sizeof...(Ts) < 255), unsigned char, unsigned short>;
+
+    template <typename T>
+    static constexpr bool is_unique_alternative = detail::count_of<T, Ts...> == 1;
+
+public:
+    template <std::size_t I>
+    using alternative = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    template <typename T>
+    static constexpr std::size_t index_of = detail::index_of<T, Ts...>();
+
+    static constexpr bool is_trivially_relocatable = (::afh::is_trivially_relocatable<Ts> && ...);
+
+    dm_variant() noexcept(std::is_nothrow_default_constructible_v<alternative<0>>)
+    {
+        construct<0>();
+    }
+
+    template <typename T, typename = std::enable_if_t<
+        is_unique_alternative<std::decay_t<T>>
+    >>
+    dm_variant(T&& value) noexcept(std::is_nothrow_constructible_v<std::decay_t<T>, T&&>)
+    {
+        construct<index_of<std::decay_t<T>>>(std::forward<T>(value));
+    }
+
+    template <std::size_t I, typename...Args>
+    explicit dm_variant(std::in_place_index_t<I>, Args&&...args)
+    {
+        construct<I>(std::forward<Args>(args)...);
+    }
+
+    template <typename T, typename...Args, typename = std::enable_if_t<is_unique_alternative<T>>>
+    explicit dm_variant(std::in_place_type_t<T>, Args&&...args)
+    {
+        construct<index_of<T>>(std::forward<Args>(args)...);
+    }
+
+    explicit dm_variant(tombstone_tag) noexcept {}
+
+    dm_variant(dm_variant const& other)
+    {
+        copy_from(other);
+    }
+
+    dm_variant(dm_variant&& other) noexcept((std::is_nothrow_move_constructible_v<Ts> && ...))
+    {
+        take(other);
+    }
+
+    dm_variant& operator=(dm_variant const& other)
+    {
+        if (this != &other) {
+            reset();
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    dm_variant& operator=(dm_variant&& other) noexcept((std::is_nothrow_move_constructible_v<Ts> && ...))
+    {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    template <typename T, typename = std::enable_if_t<
+        is_unique_alternative<std::decay_t<T>>
+    >>
+    dm_variant& operator=(T&& value)
+    {
+        emplace<index_of<std::decay_t<T>>>(std::forward<T>(value));
+        return *this;
+    }
+
+    ~dm_variant()
+    {
+        reset();
+    }
+
+    std::size_t index() const noexcept { return m_index ? std::size_t(m_index - 1) : std::variant_npos; }
+    bool valueless() const noexcept { return m_index == 0; }
+
+    template <typename T>
+    bool holds_alternative() const noexcept { return m_index == index_of<T> + 1; }
+
+    template <std::size_t I> auto&  get()      &  noexcept { assert(m_index == I + 1); return *value<I>(); }
+    template <std::size_t I> auto&  get() const&  noexcept { assert(m_index == I + 1); return *value<I>(); }
+    template <std::size_t I> auto&& get()      && noexcept { assert(m_index == I + 1); return std::move(*value<I>()); }
+
+    template <typename T> T&        get()      &  noexcept { return get<index_of<T>>(); }
+    template <typename T> T const&  get() const&  noexcept { return get<index_of<T>>(); }
+    template <typename T> T&&       get()      && noexcept { return std::move(*this).template get<index_of<T>>(); }
+
+    template <std::size_t I> auto* get_if()       noexcept { return m_index == I + 1 ? value<I>() : nullptr; }
+    template <std::size_t I> auto* get_if() const noexcept { return m_index == I + 1 ? value<I>() : nullptr; }
+
+    template <typename T> T*       get_if()       noexcept { return get_if<index_of<T>>(); }
+    template <typename T> T const* get_if() const noexcept { return get_if<index_of<T>>(); }
+
+    template <std::size_t I>
+    alternative<I> get_and_drop() noexcept(std::is_nothrow_move_constructible_v<alternative<I>>)
+    {
+        assert(m_index == I + 1);
+        alternative<I> result(std::move(*value<I>()));
+        drop_husk<I>();
+        return result;
+    }
+
+    template <typename T>
+    T get_and_drop() noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        return get_and_drop<index_of<T>>();
+    }
+
+    template <typename Visitor>
+    decltype(auto) visit(Visitor&& vis) &
+    {
+        assert(m_index != 0);
+        return dispatch(m_index - 1, [&](auto i) -> decltype(auto) {
+            return std::invoke(std::forward<Visitor>(vis), *value<i>());
+        });
+    }
+
+    template <typename Visitor>
+    decltype(auto) visit(Visitor&& vis) const&
+    {
+        assert(m_index != 0);
+        return dispatch(m_index - 1, [&](auto i) -> decltype(auto) {
+            return std::invoke(std::forward<Visitor>(vis), *value<i>());
+        });
+    }
+
+    template <typename Visitor>
+    decltype(auto) visit_and_drop(Visitor&& vis)
+    {
+        assert(m_index != 0);
+        return dispatch(m_index - 1, [&](auto i) -> decltype(auto) {
+            return std::invoke(std::forward<Visitor>(vis), get_and_drop<i>());
+        });
+    }
+
+    template <std::size_t I, typename...Args>
+    alternative<I>& emplace(Args&&...args)
+    {
+        reset();
+        construct<I>(std::forward<Args>(args)...);
+        return *value<I>();
+    }
+
+    template <typename T, typename...Args, typename = std::enable_if_t<is_unique_alternative<T>>>
+    T& emplace(Args&&...args)
+    {
+        return emplace<index_of<T>>(std::forward<Args>(args)...);
+    }
+
+    void reset() noexcept
+    {
+        if (m_index) {
+            dispatch(m_index - 1, [this](auto i) { std::destroy_at(value<i>()); });
+            m_index = 0;
+        }
+    }
+
+    void swap(dm_variant& other) noexcept((std::is_nothrow_move_constructible_v<Ts> && ...))
+    {
+        dm_variant temp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+
+    friend void swap(dm_variant& a, dm_variant& b) noexcept(noexcept(a.swap(b))) { a.swap(b); }
+
+private:
+    template <std::size_t I>
+    alternative<I>* value() noexcept
+    {
+        return std::launder(reinterpret_cast<alternative<I>*>(m_storage));
+    }
+
+    template <std::size_t I>
+    alternative<I> const* value() const noexcept
+    {
+        return std::launder(reinterpret_cast<alternative<I> const*>(m_storage));
+    }
+
+    // Calls fn(std::integral_constant<std::size_t, i>()) through a table.
+    template <typename Fn>
+    static decltype(auto) dispatch(std::size_t i, Fn&& fn)
+    {
+        return dispatch(i, fn, std::index_sequence_for<Ts...>());
+    }
+
+    template <typename Fn, std::size_t...Is>
+    static decltype(auto) dispatch(std::size_t i, Fn& fn, std::index_sequence<Is...>)
+    {
+        using result = decltype(fn(std::integral_constant<std::size_t, 0>()));
+        using entry  = result (*)(Fn&);
+        static constexpr entry table[] = {
+            [](Fn& f) -> result { return f(std::integral_constant<std::size_t, Is>()); }...
+        };
+        return table[i](fn);
+    }
+
+    template <std::size_t I, typename...Args>
+    void construct(Args&&...args)
+    {
+        new (m_storage) alternative<I>(std::forward<Args>(args)...);
+        m_index = index_type(I + 1);
+    }
+
+    // Drops the husk of alternative I, only destructing its
+    // destructive_move_exempt members, and leaves *this valueless.
+    template <std::size_t I>
+    void drop_husk() noexcept
+    {
+        optional_v2_destruct<alternative<I>>()(*value<I>());
+        m_index = 0;
+    }
+
+    // Moves other's alternative here and drops its husk.  *this must be
+    // valueless.
+    void take(dm_variant& other)
+    {
+        if (other.m_index) {
+            dispatch(other.m_index - 1, [this, &other](auto i) {
+                construct<i>(std::move(*other.value<i>()));
+                other.template drop_husk<i>();
+            });
+        }
+    }
+
+    // *this must be valueless.
+    void copy_from(dm_variant const& other)
+    {
+        if (other.m_index) {
+            dispatch(other.m_index - 1, [this, &other](auto i) { construct<i>(*other.value<i>()); });
+        }
+    }
+
+    alignas(Ts...) unsigned char m_storage[std::max({ sizeof(Ts)... })];
+    index_type                   m_index = 0; // active alternative + 1, 0 when valueless
+
+public:
+    using Tombstone_functions = tombstone_via_member<&dm_variant::m_index>;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_DM_VARIANT_HPP__
@@ -0,0 +1,380 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_DM_VECTOR_HPP__
+#define AFH_DM_VECTOR_HPP__
+
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include "dm_algorithm.hpp"
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <initializer_list>
+
+namespace afh {
+
+//=============================================================================
+// template <typename T>
+// class dm_vector;
+//
+//  A growable array of optional_v2<T> slots.  It has the same interface as
+//  std::vector<optional_v2<T>>, but whenever an element has to change
+//  location (growth, insert, erase and pop_back) the element is moved into
+//  its new slot and the husk left behind is dropped on the floor.  This means
+//  that when reallocating, the old buffer is freed without calling any
+//  destructors, unless there are destructive_move_exempt members that must
+//  be cleaned up.
+//
+////
+// Template Parameters
+////
+//  T (required contained type)
+//
+//   This is the type to be contained.  Each element is stored as a
+//   optional_v2<T>.
+//
+////
+// Invariants
+////
+//  Slots [data(), data() + size()) are constructed optional_v2<T> objects
+//  (which may be tombstoned if the user moved out of them).  Slots
+//  [data() + size(), data() + capacity()) are uninitialised memory.
+//
+////
+// Modifiers
+////
+//  template <typename...Ts>
+//  reference emplace_back(Ts&&...args);
+//
+//   Constructs a new element at the end.  args are forwarded to the
+//   optional_v2<T> constructor, so passing an afh::emplace<T>(...) object is
+//   the same as passing its parameters directly.
+//
+//  T pop_back();
+//
+//   Moves the last element out, drops its husk and returns the value.  Unlike
+//   std::vector::pop_back(), which returns void, the value has to be moved
+//   out to drop the husk anyway, so it is handed back rather than destroyed.
+//   The element must not be tombstoned.
+//
+//  template <typename...Ts>
+//  iterator emplace(const_iterator pos, Ts&&...args);
+//
+//   Constructs a new element before pos, relocating [pos, end()) up by one.
+//
+//  iterator erase(const_iterator pos);
+//  iterator erase(const_iterator first, const_iterator last);
+//
+//   Destructs the elements in the range and relocates the elements after it
+//   down into the hole.
+//
+//  size_type compact();
+//
+//   Removes the slots that the user has moved out of (tombstoned), relocating
+//   the rest down into the holes.
+//
+////
+// Exception safety
+////
+//  Relocation assumes that moving T doesn't throw.  If T is
+//  is_trivially_relocatable, relocation is a memcpy/memmove and can't throw.
+//  Otherwise if moving T can throw, then an exception during relocation will
+//  leave the container in a valid but unspecified state.
+template <typename T>
+class dm_vector
+{
+public:
+    using value_type             = optional_v2<T>;
+    using contained              = T;
+    using size_type              = std::size_t;
+    using difference_type        = std::ptrdiff_t;
+    using reference              = value_type&;
+    using const_reference        = value_type const&;
+    using pointer                = value_type*;
+    using const_pointer          = value_type const*;
+    using iterator               = value_type*;
+    using const_iterator         = value_type const*;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    constexpr dm_vector() noexcept = default;
+
+    dm_vector(std::initializer_list<T> init)
+    {
+        reserve(init.size());
+        for (auto& item : init) {
+            emplace_back(item);
+        }
+    }
+
+    dm_vector(dm_vector const& other)
+    {
+        reserve(other.size());
+        for (auto& item : other) {
+            emplace_back(item);
+        }
+    }
+
+    dm_vector(dm_vector&& other) noexcept
+        : m_data    (std::exchange(other.m_data    , nullptr))
+        , m_size    (std::exchange(other.m_size    , 0))
+        , m_capacity(std::exchange(other.m_capacity, 0))
+    {}
+
+    dm_vector& operator=(dm_vector const& other)
+    {
+        if (this != &other) {
+            dm_vector(other).swap(*this);
+        }
+        return *this;
+    }
+
+    dm_vector& operator=(dm_vector&& other) noexcept
+    {
+        dm_vector(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~dm_vector()
+    {
+        clear();
+        deallocate(m_data);
+    }
+
+    // Iterators
+    iterator               begin()         noexcept { return m_data; }
+    const_iterator         begin()   const noexcept { return m_data; }
+    const_iterator         cbegin()  const noexcept { return m_data; }
+    iterator               end()           noexcept { return m_data + m_size; }
+    const_iterator         end()     const noexcept { return m_data + m_size; }
+    const_iterator         cend()    const noexcept { return m_data + m_size; }
+    reverse_iterator       rbegin()        noexcept { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin()  const noexcept { return const_reverse_iterator(end()); }
+    const_reverse_iterator crbegin() const noexcept { return const_reverse_iterator(end()); }
+    reverse_iterator       rend()          noexcept { return reverse_iterator(begin()); }
+    const_reverse_iterator rend()    const noexcept { return const_reverse_iterator(begin()); }
+    const_reverse_iterator crend()   const noexcept { return const_reverse_iterator(begin()); }
+
+    // Capacity
+    bool      empty()    const noexcept { return m_size == 0; }
+    size_type size()     const noexcept { return m_size; }
+    size_type capacity() const noexcept { return m_capacity; }
+
+    void reserve(size_type new_capacity)
+    {
+        if (new_capacity > m_capacity) {
+            reallocate(new_capacity);
+        }
+    }
+
+    void shrink_to_fit()
+    {
+        if (m_size < m_capacity) {
+            reallocate(m_size);
+        }
+    }
+
+    // Element access
+    reference       operator[](size_type i)       noexcept { assert(i < m_size); return m_data[i]; }
+    const_reference operator[](size_type i) const noexcept { assert(i < m_size); return m_data[i]; }
+
+    reference       at(size_type i)       { check_index(i); return m_data[i]; }
+    const_reference at(size_type i) const { check_index(i); return m_data[i]; }
+
+    reference       front()       noexcept { assert(!empty()); return m_data[0]; }
+    const_reference front() const noexcept { assert(!empty()); return m_data[0]; }
+    reference       back()        noexcept { assert(!empty()); return m_data[m_size - 1]; }
+    const_reference back()  const noexcept { assert(!empty()); return m_data[m_size - 1]; }
+
+    pointer         data()        noexcept { return m_data; }
+    const_pointer   data()  const noexcept { return m_data; }
+
+    // Modifiers
+    void clear() noexcept
+    {
+        destroy_range(begin(), end());
+        m_size = 0;
+    }
+
+    template <typename...Ts>
+    reference emplace_back(Ts&&...args)
+    {
+        if (m_size == m_capacity) {
+            return *emplace_reallocate(m_size, std::forward<Ts>(args)...);
+        }
+        new (m_data + m_size) value_type(std::forward<Ts>(args)...);
+        return m_data[m_size++];
+    }
+
+    void push_back(T const& value) { emplace_back(value); }
+    void push_back(T     && value) { emplace_back(std::move(value)); }
+
+    T pop_back() noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        assert(!empty() && back().has_value());
+        value_type* husk = m_data + --m_size;
+        T result(std::move(*husk).value());
+        husk->has_been_moved();
+        detail::drop_husk(husk);
+        return result;
+    }
+
+    template <typename...Ts>
+    iterator emplace(const_iterator pos, Ts&&...args)
+    {
+        size_type index = pos - m_data;
+        assert(index <= m_size);
+        if (m_size == m_capacity) {
+            return emplace_reallocate(index, std::forward<Ts>(args)...);
+        }
+        if (index == m_size) {
+            new (m_data + m_size) value_type(std::forward<Ts>(args)...);
+        }
+        else {
+            // args may refer to an element that is about to be relocated, so
+            // construct it before opening up the hole.
+            value_type new_item(std::forward<Ts>(args)...);
+            uninitialized_relocate_backward(m_data + index, m_data + m_size, m_data + m_size + 1);
+            new (m_data + index) value_type(std::move(new_item));
+            // new_item is now a husk that its destructor will drop.
+        }
+        ++m_size;
+        return m_data + index;
+    }
+
+    iterator insert(const_iterator pos, T const& value) { return emplace(pos, value); }
+    iterator insert(const_iterator pos, T     && value) { return emplace(pos, std::move(value)); }
+
+    iterator erase(const_iterator pos)
+    {
+        return erase(pos, pos + 1);
+    }
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        size_type index = first - m_data;
+        size_type count = last - first;
+        assert(index + count <= m_size);
+        if (count != 0) {
+            destroy_n(m_data + index, count);
+            uninitialized_relocate(m_data + index + count, m_data + m_size, m_data + index);
+            m_size -= count;
+        }
+        return m_data + index;
+    }
+
+    // Removes the tombstoned slots, relocating the rest down into the holes.
+    // Returns the new size.
+    size_type compact()
+    {
+        erase(afh::compact(begin(), end()), end());
+        return m_size;
+    }
+
+    void swap(dm_vector& other) noexcept
+    {
+        using std::swap;
+        swap(m_data    , other.m_data);
+        swap(m_size    , other.m_size);
+        swap(m_capacity, other.m_capacity);
+    }
+
+    friend void swap(dm_vector& lhs, dm_vector& rhs) noexcept
+    {
+        lhs.swap(rhs);
+    }
+
+private:
+    static value_type* allocate(size_type count)
+    {
+        return static_cast<value_type*>(
+            ::operator new(count * sizeof(value_type), std::align_val_t(alignof(value_type))));
+    }
+
+    static void deallocate(value_type* p) noexcept
+    {
+        if (p) {
+            ::operator delete(p, std::align_val_t(alignof(value_type)));
+        }
+    }
+
+    size_type grow_to() const noexcept
+    {
+        return m_capacity ? m_capacity * 2 : 1;
+    }
+
+    void check_index(size_type i) const
+    {
+        if (i >= m_size) {
+            throw std::out_of_range("dm_vector index out of range");
+        }
+    }
+
+    // Moves all elements into a new buffer, leaving the old buffer full of
+    // husks which are dropped before the buffer is freed.
+    void reallocate(size_type new_capacity)
+    {
+        value_type* new_data = allocate(new_capacity);
+        uninitialized_relocate(m_data, m_data + m_size, new_data);
+        deallocate(std::exchange(m_data, new_data));
+        m_capacity = new_capacity;
+    }
+
+    // Same as reallocate(), but constructs a new element at index first, so
+    // that args can safely refer to an element in the old buffer.
+    template <typename...Ts>
+    value_type* emplace_reallocate(size_type index, Ts&&...args)
+    {
+        size_type   new_capacity = grow_to();
+        value_type* new_data     = allocate(new_capacity);
+        try {
+            new (new_data + index) value_type(std::forward<Ts>(args)...);
+        }
+        catch (...) {
+            deallocate(new_data);
+            throw;
+        }
+        uninitialized_relocate(m_data        , m_data + index , new_data);
+        uninitialized_relocate(m_data + index, m_data + m_size, new_data + index + 1);
+        deallocate(std::exchange(m_data, new_data));
+        m_capacity = new_capacity;
+        ++m_size;
+        return new_data + index;
+    }
+
+    value_type* m_data     = nullptr;
+    size_type   m_size     = 0;
+    size_type   m_capacity = 0;
+};
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename Pred>
+// std::size_t erase_if(dm_vector<T>& v, Pred pred);
+//
+//  Removes the elements for which pred(T const&) is true with
+//  afh::remove_if(), relocating the survivors down, and erases the tombstoned
+//  tail.  Returns the number of elements erased.
+template <typename T, typename Pred>
+std::size_t erase_if(dm_vector<T>& v, Pred pred)
+{
+    auto* new_end = ::afh::remove_if(v.begin(), v.end(), std::move(pred));
+    std::size_t erased = std::size_t(v.end() - new_end);
+    v.erase(new_end, v.end());
+    return erased;
+}
+
+} // namespace afh
+#endif // #ifndef AFH_DM_VECTOR_HPP__
@@ -0,0 +1,444 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_LIVENESS_HPP__
+#define AFH_LIVENESS_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+
+// The vectorised kernels are only built for x86-64 with GCC or clang, as they
+// rely on the target attribute and __builtin_cpu_supports() to be selected
+// at runtime.  Define AFH_LIVENESS_NO_SIMD to always use the scalar kernels.
+#if !defined(AFH_LIVENESS_NO_SIMD) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+# define AFH___LIVENESS_X86 1
+# include <immintrin.h>
+#else
+# define AFH___LIVENESS_X86 0
+#endif
+
+namespace afh {
+
+//=============================================================================
+// Tombstone bitmaps
+//
+//  A tombstone bitmap is an array of tombstone_word, where bit i % 64 of word
+//  i / 64 is set if element i is tombstoned.  Bits past the last element are
+//  clear.
+//
+// Byte flags
+//
+//  An array of bool, one per element, which is true if the element is
+//  tombstoned.
+using tombstone_word = std::uint64_t;
+
+namespace detail {
+    constexpr std::size_t tombstone_word_bits = 64;
+
+    constexpr std::size_t tombstone_words(std::size_t count) noexcept
+    {
+        return (count + tombstone_word_bits - 1) / tombstone_word_bits;
+    }
+
+    inline unsigned popcount(tombstone_word word) noexcept
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return unsigned(__builtin_popcountll(word));
+#else
+        unsigned count = 0;
+        for (; word; word &= word - 1) {
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    inline unsigned countr_zero(tombstone_word word) noexcept
+    {
+        assert(word != 0);
+#if defined(__GNUC__) || defined(__clang__)
+        return unsigned(__builtin_ctzll(word));
+#else
+        unsigned count = 0;
+        for (; !(word & 1); word >>= 1) {
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    // Sets the bits for [0, count) and clears the bits past it.
+    inline void tombstone_all(tombstone_word* words, std::size_t count) noexcept
+    {
+        std::size_t word_count = tombstone_words(count);
+        for (std::size_t i = 0; i != word_count; ++i) {
+            words[i] = ~tombstone_word(0);
+        }
+        if (std::size_t tail = count % tombstone_word_bits) {
+            words[word_count - 1] = (tombstone_word(1) << tail) - 1;
+        }
+    }
+
+    // Clears the bits for [0, live) and sets the bits for [live, count).
+    inline void tombstone_from(tombstone_word* words, std::size_t live, std::size_t count) noexcept
+    {
+        tombstone_all(words, count);
+        std::size_t full = live / tombstone_word_bits;
+        for (std::size_t i = 0; i != full; ++i) {
+            words[i] = 0;
+        }
+        if (std::size_t tail = live % tombstone_word_bits) {
+            words[full] &= ~((tombstone_word(1) << tail) - 1);
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // The kernels that are selected at runtime.  Each set works on whole
+    // words or bytes and leaves the handling of the range ends to the
+    // callers.
+    struct liveness_kernels {
+        char const* name;
+        // Number of set bits in words [0, word_count).
+        std::size_t (*count_tombstoned_words)(tombstone_word const* words, std::size_t word_count);
+        // Index of the first word in [from, word_count) that isn't all set,
+        // or word_count.
+        std::size_t (*find_live_word)(tombstone_word const* words, std::size_t from, std::size_t word_count);
+        // Number of true flags in [0, count).
+        std::size_t (*count_tombstoned_bytes)(bool const* flags, std::size_t count);
+        // Index of the first false flag in [from, count), or count.
+        std::size_t (*find_live_byte)(bool const* flags, std::size_t from, std::size_t count);
+        // Bit i is set if flags[i] is false, for i in [0, 64).
+        tombstone_word (*live_byte_mask)(bool const* flags);
+    };
+
+    inline std::size_t count_tombstoned_words_scalar(tombstone_word const* words, std::size_t word_count)
+    {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i != word_count; ++i) {
+            total += popcount(words[i]);
+        }
+        return total;
+    }
+
+    inline std::size_t find_live_word_scalar(tombstone_word const* words, std::size_t from, std::size_t word_count)
+    {
+        for (; from != word_count && words[from] == ~tombstone_word(0); ++from) {
+        }
+        return from;
+    }
+
+    inline std::size_t count_tombstoned_bytes_scalar(bool const* flags, std::size_t count)
+    {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i != count; ++i) {
+            total += flags[i];
+        }
+        return total;
+    }
+
+    inline std::size_t find_live_byte_scalar(bool const* flags, std::size_t from, std::size_t count)
+    {
+        for (; from != count && flags[from]; ++from) {
+        }
+        return from;
+    }
+
+    inline tombstone_word live_byte_mask_scalar(bool const* flags)
+    {
+        tombstone_word live = 0;
+        for (std::size_t i = 0; i != tombstone_word_bits; ++i) {
+            live |= tombstone_word(!flags[i]) << i;
+        }
+        return live;
+    }
+
+#if AFH___LIVENESS_X86
+    //-------------------------------------------------------------------------
+    // SSE4.2 (with popcnt)
+    __attribute__((target("sse4.2,popcnt")))
+    inline std::size_t count_tombstoned_words_sse42(tombstone_word const* words, std::size_t word_count)
+    {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i != word_count; ++i) {
+            total += std::size_t(_mm_popcnt_u64(words[i]));
+        }
+        return total;
+    }
+
+    __attribute__((target("sse4.2,popcnt")))
+    inline std::size_t find_live_word_sse42(tombstone_word const* words, std::size_t from, std::size_t word_count)
+    {
+        __m128i const all_set = _mm_set1_epi64x(-1);
+        for (; from + 2 <= word_count; from += 2) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(words + from));
+            int set = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(v, all_set)));
+            if (set != 0x3) {
+                return from + countr_zero(tombstone_word(~set & 0x3));
+            }
+        }
+        return find_live_word_scalar(words, from, word_count);
+    }
+
+    __attribute__((target("sse4.2,popcnt")))
+    inline std::size_t count_tombstoned_bytes_sse42(bool const* flags, std::size_t count)
+    {
+        __m128i const zero = _mm_setzero_si128();
+        std::size_t live = 0;
+        std::size_t i    = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(flags + i));
+            live += std::size_t(_mm_popcnt_u32(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)))));
+        }
+        return (i - live) + count_tombstoned_bytes_scalar(flags + i, count - i);
+    }
+
+    __attribute__((target("sse4.2,popcnt")))
+    inline std::size_t find_live_byte_sse42(bool const* flags, std::size_t from, std::size_t count)
+    {
+        __m128i const zero = _mm_setzero_si128();
+        for (; from + 16 <= count; from += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(flags + from));
+            unsigned live = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)));
+            if (live) {
+                return from + countr_zero(live);
+            }
+        }
+        return find_live_byte_scalar(flags, from, count);
+    }
+
+    __attribute__((target("sse4.2,popcnt")))
+    inline tombstone_word live_byte_mask_sse42(bool const* flags)
+    {
+        __m128i const zero = _mm_setzero_si128();
+        tombstone_word live = 0;
+        for (std::size_t i = 0; i != tombstone_word_bits; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(flags + i));
+            live |= tombstone_word(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)))) << i;
+        }
+        return live;
+    }
+
+    //-------------------------------------------------------------------------
+    // AVX2
+    __attribute__((target("avx2,popcnt")))
+    inline std::size_t count_tombstoned_words_avx2(tombstone_word const* words, std::size_t word_count)
+    {
+        // Nibble lookup popcount, accumulated with vpsadbw.
+        __m256i const lut = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        __m256i const low_nibble = _mm256_set1_epi8(0x0f);
+        __m256i const zero       = _mm256_setzero_si256();
+        __m256i       acc        = zero;
+        std::size_t   i          = 0;
+        for (; i + 4 <= word_count; i += 4) {
+            __m256i v   = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(words + i));
+            __m256i lo  = _mm256_and_si256(v, low_nibble);
+            __m256i hi  = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibble);
+            __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, zero));
+        }
+        std::size_t total = std::size_t(_mm256_extract_epi64(acc, 0)) + std::size_t(_mm256_extract_epi64(acc, 1))
+                          + std::size_t(_mm256_extract_epi64(acc, 2)) + std::size_t(_mm256_extract_epi64(acc, 3));
+        for (; i != word_count; ++i) {
+            total += std::size_t(_mm_popcnt_u64(words[i]));
+        }
+        return total;
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    inline std::size_t find_live_word_avx2(tombstone_word const* words, std::size_t from, std::size_t word_count)
+    {
+        __m256i const all_set = _mm256_set1_epi64x(-1);
+        for (; from + 4 <= word_count; from += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(words + from));
+            int set = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, all_set)));
+            if (set != 0xf) {
+                return from + countr_zero(tombstone_word(~set & 0xf));
+            }
+        }
+        return find_live_word_scalar(words, from, word_count);
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    inline std::size_t count_tombstoned_bytes_avx2(bool const* flags, std::size_t count)
+    {
+        __m256i const zero = _mm256_setzero_si256();
+        std::size_t live = 0;
+        std::size_t i    = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(flags + i));
+            live += std::size_t(_mm_popcnt_u32(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)))));
+        }
+        return (i - live) + count_tombstoned_bytes_scalar(flags + i, count - i);
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    inline std::size_t find_live_byte_avx2(bool const* flags, std::size_t from, std::size_t count)
+    {
+        __m256i const zero = _mm256_setzero_si256();
+        for (; from + 32 <= count; from += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(flags + from));
+            unsigned live = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)));
+            if (live) {
+                return from + countr_zero(live);
+            }
+        }
+        return find_live_byte_scalar(flags, from, count);
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    inline tombstone_word live_byte_mask_avx2(bool const* flags)
+    {
+        __m256i const zero = _mm256_setzero_si256();
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(flags));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(flags + 32));
+        return  tombstone_word(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, zero))))
+             | (tombstone_word(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, zero)))) << 32);
+    }
+#endif
+
+    inline liveness_kernels select_liveness_kernels() noexcept
+    {
+#if AFH___LIVENESS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            return { "avx2", count_tombstoned_words_avx2, find_live_word_avx2
+                   , count_tombstoned_bytes_avx2, find_live_byte_avx2, live_byte_mask_avx2 };
+        }
+        if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+            return { "sse4.2", count_tombstoned_words_sse42, find_live_word_sse42
+                   , count_tombstoned_bytes_sse42, find_live_byte_sse42, live_byte_mask_sse42 };
+        }
+#endif
+        return { "scalar", count_tombstoned_words_scalar, find_live_word_scalar
+               , count_tombstoned_bytes_scalar, find_live_byte_scalar, live_byte_mask_scalar };
+    }
+
+    inline liveness_kernels const& kernels() noexcept
+    {
+        static liveness_kernels const selected = select_liveness_kernels();
+        return selected;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// char const* liveness_kernels_name() noexcept;
+//
+//  Name of the kernel set selected for this CPU ("avx2", "sse4.2" or
+//  "scalar").
+inline char const* liveness_kernels_name() noexcept
+{
+    return detail::kernels().name;
+}
+
+//-----------------------------------------------------------------------------
+// std::size_t count_live(tombstone_word const* bitmap, std::size_t count) noexcept;
+// std::size_t count_live(bool           const* flags , std::size_t count) noexcept;
+//
+//  Returns the number of elements in [0, count) that are not tombstoned.
+inline std::size_t count_live(tombstone_word const* bitmap, std::size_t count) noexcept
+{
+    return count - detail::kernels().count_tombstoned_words(bitmap, detail::tombstone_words(count));
+}
+
+inline std::size_t count_live(bool const* flags, std::size_t count) noexcept
+{
+    return count - detail::kernels().count_tombstoned_bytes(flags, count);
+}
+
+//-----------------------------------------------------------------------------
+// std::size_t find_next_live(tombstone_word const* bitmap, std::size_t from, std::size_t count) noexcept;
+// std::size_t find_next_live(bool           const* flags , std::size_t from, std::size_t count) noexcept;
+//
+//  Returns the index of the first element in [from, count) that is not
+//  tombstoned, or count if there isn't one.
+inline std::size_t find_next_live(tombstone_word const* bitmap, std::size_t from, std::size_t count) noexcept
+{
+    using detail::tombstone_word_bits;
+    if (from >= count) {
+        return count;
+    }
+    std::size_t    word_count = detail::tombstone_words(count);
+    std::size_t    w          = from / tombstone_word_bits;
+    // Treat the bits before from as tombstoned.
+    tombstone_word live       = ~bitmap[w] & (~tombstone_word(0) << (from % tombstone_word_bits));
+    while (!live) {
+        w = detail::kernels().find_live_word(bitmap, w + 1, word_count);
+        if (w == word_count) {
+            return count;
+        }
+        live = ~bitmap[w];
+    }
+    std::size_t index = w * tombstone_word_bits + detail::countr_zero(live);
+    // The clear padding bits read as live.
+    return index < count ? index : count;
+}
+
+inline std::size_t find_next_live(bool const* flags, std::size_t from, std::size_t count) noexcept
+{
+    return from >= count ? count : detail::kernels().find_live_byte(flags, from, count);
+}
+
+//-----------------------------------------------------------------------------
+// template <typename Index>
+// std::size_t live_indices(tombstone_word const* bitmap, std::size_t count, Index* out) noexcept;
+// template <typename Index>
+// std::size_t live_indices(bool           const* flags , std::size_t count, Index* out) noexcept;
+//
+//  Writes the indices of the elements in [0, count) that are not tombstoned,
+//  in ascending order, to out, which must have room for count_live(...)
+//  indices.  Returns the number of indices written.
+template <typename Index>
+std::size_t live_indices(tombstone_word const* bitmap, std::size_t count, Index* out) noexcept
+{
+    using detail::tombstone_word_bits;
+    std::size_t word_count = detail::tombstone_words(count);
+    std::size_t written    = 0;
+    for (std::size_t w = detail::kernels().find_live_word(bitmap, 0, word_count)
+        ; w != word_count
+        ; w = detail::kernels().find_live_word(bitmap, w + 1, word_count))
+    {
+        tombstone_word live = ~bitmap[w];
+        if (w == word_count - 1 && count % tombstone_word_bits) {
+            live &= (tombstone_word(1) << (count % tombstone_word_bits)) - 1;
+        }
+        for (; live; live &= live - 1) {
+            out[written++] = Index(w * tombstone_word_bits + detail::countr_zero(live));
+        }
+    }
+    return written;
+}
+
+template <typename Index>
+std::size_t live_indices(bool const* flags, std::size_t count, Index* out) noexcept
+{
+    using detail::tombstone_word_bits;
+    std::size_t written = 0;
+    std::size_t i       = 0;
+    for (; i + tombstone_word_bits <= count; i += tombstone_word_bits) {
+        for (tombstone_word live = detail::kernels().live_byte_mask(flags + i); live; live &= live - 1) {
+            out[written++] = Index(i + detail::countr_zero(live));
+        }
+    }
+    for (; i != count; ++i) {
+        if (!flags[i]) {
+            out[written++] = Index(i);
+        }
+    }
+    return written;
+}
+
+} // namespace afh
+#endif // #ifndef AFH_LIVENESS_HPP__
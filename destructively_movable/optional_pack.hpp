@@ -0,0 +1,376 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_OPTIONAL_PACK_HPP__
+#define AFH_OPTIONAL_PACK_HPP__
+
+#include "destructively_movable.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace afh {
+
+//-----------------------------------------------------------------------------
+namespace detail {
+    template <typename T>
+    constexpr bool has_internal_tombstone = !std::is_void_v<optional_v2_tombstone_functions<T>>;
+
+    // Which bit of the packed flags the Ith slot uses, if it doesn't have an
+    // internal tombstone.
+    template <std::size_t I, typename...Ts>
+    constexpr std::size_t pack_flag_bit()
+    {
+        constexpr bool external[] = { !has_internal_tombstone<Ts>... };
+        std::size_t bit = 0;
+        for (std::size_t i = 0; i < I; ++i) {
+            bit += external[i];
+        }
+        return bit;
+    }
+
+    // The Ith slot of an optional_pack.
+    template <std::size_t I, typename T>
+    class pack_slot : storage<T>
+    {
+    public:
+        T& slot_value() noexcept
+        {
+            if constexpr (std::is_empty_v<T>)
+                return *std::launder(reinterpret_cast<T*>(this));
+            else
+                return storage<T>::value;
+        }
+
+        T const& slot_value() const noexcept
+        {
+            return const_cast<pack_slot*>(this)->slot_value();
+        }
+    };
+
+    // One bit per slot without an internal tombstone, set while it has a
+    // value.
+    template <std::size_t Bits>
+    class pack_flags
+    {
+    public:
+        using flags_type = std::conditional_t<(Bits <=  8), std::uint8_t,
+                           std::conditional_t<(Bits <= 16), std::uint16_t,
+                           std::conditional_t<(Bits <= 32), std::uint32_t, std::uint64_t>>>;
+        static_assert(Bits <= 64, "Too many slots without an internal tombstone.");
+
+        bool flag(std::size_t bit) const noexcept { return (m_flags >> bit) & 1; }
+        void flag(std::size_t bit, bool set) noexcept
+        {
+            if (set)
+                m_flags = flags_type(m_flags |  (flags_type(1) << bit));
+            else
+                m_flags = flags_type(m_flags & ~(flags_type(1) << bit));
+        }
+
+    private:
+        flags_type m_flags = 0;
+    };
+
+    template <>
+    class pack_flags<0>
+    {
+    public:
+        bool flag(std::size_t) const noexcept { return false; }
+        void flag(std::size_t, bool) noexcept {}
+    };
+
+    // Deletes the copy operations of an optional_pack with a member that
+    // can't be copied.
+    template <bool Copyable>
+    class pack_copy {};
+
+    template <>
+    class pack_copy<false>
+    {
+    public:
+        pack_copy() = default;
+        pack_copy           (pack_copy const&) = delete;
+        pack_copy           (pack_copy     &&) = default;
+        pack_copy& operator=(pack_copy const&) = delete;
+        pack_copy& operator=(pack_copy     &&) = default;
+    };
+
+    template <typename Indices, typename...Ts>
+    class optional_pack_impl;
+
+    template <std::size_t...Is, typename...Ts>
+    class optional_pack_impl<std::index_sequence<Is...>, Ts...>
+        : pack_slot<Is, Ts>...
+        , pack_flags<(std::size_t(!has_internal_tombstone<Ts>) + ... + 0)>
+    {
+        using flags = pack_flags<(std::size_t(!has_internal_tombstone<Ts>) + ... + 0)>;
+
+        static constexpr bool nothrow_copy = (std::is_nothrow_copy_constructible_v<Ts> && ...);
+        static constexpr bool nothrow_move = (std::is_nothrow_move_constructible_v<Ts> && ...);
+
+    public:
+        template <std::size_t I>
+        using element = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+        static constexpr std::size_t size = sizeof...(Ts);
+
+        optional_pack_impl() noexcept
+        {
+            (mark<Is>(false), ...);
+        }
+
+        optional_pack_impl(optional_pack_impl const& other)
+            : optional_pack_impl()
+        {
+            copy_all(other);
+        }
+
+        optional_pack_impl(optional_pack_impl&& other) noexcept(nothrow_move)
+            : optional_pack_impl()
+        {
+            take_all(other);
+        }
+
+        optional_pack_impl& operator=(optional_pack_impl const& other)
+        {
+            if (this != &other) {
+                reset();
+                copy_all(other);
+            }
+            return *this;
+        }
+
+        optional_pack_impl& operator=(optional_pack_impl&& other) noexcept(nothrow_move)
+        {
+            if (this != &other) {
+                reset();
+                take_all(other);
+            }
+            return *this;
+        }
+
+        ~optional_pack_impl()
+        {
+            reset();
+        }
+
+        template <std::size_t I>
+        bool has_value() const noexcept
+        {
+            using T = element<I>;
+            if constexpr (has_internal_tombstone<T>)
+                return !optional_v2_tombstone_functions<T>()(slot<I>());
+            else
+                return flags::flag(pack_flag_bit<I, Ts...>());
+        }
+
+        template <std::size_t I> element<I>&       get()       noexcept { assert(has_value<I>()); return slot<I>(); }
+        template <std::size_t I> element<I> const& get() const noexcept { assert(has_value<I>()); return slot<I>(); }
+
+        template <std::size_t I, typename...Args>
+        element<I>& emplace(Args&&...args)
+        {
+            reset<I>();
+            new (std::addressof(slot<I>())) element<I>(std::forward<Args>(args)...);
+            mark<I>(true);
+            return slot<I>();
+        }
+
+        template <std::size_t I, typename const_tag, typename...Args>
+        element<I>& emplace(emplace_params<element<I>, const_tag, Args...>&& params)
+        {
+            reset<I>();
+            params.uninitialized_construct(std::addressof(slot<I>()));
+            mark<I>(true);
+            return slot<I>();
+        }
+
+        template <std::size_t I>
+        void reset() noexcept
+        {
+            if (has_value<I>()) {
+                std::destroy_at(std::addressof(slot<I>()));
+                mark<I>(false);
+            }
+        }
+
+        void reset() noexcept
+        {
+            (reset<Is>(), ...);
+        }
+
+        // The value has been moved out of get<I>().  Drops the husk, only
+        // destructing its destructive_move_exempt members.
+        template <std::size_t I>
+        void has_been_moved() noexcept
+        {
+            assert(has_value<I>());
+            optional_v2_destruct<element<I>>()(slot<I>());
+            mark<I>(false);
+        }
+
+        template <std::size_t I>
+        element<I> get_and_drop() noexcept(std::is_nothrow_move_constructible_v<element<I>>)
+        {
+            assert(has_value<I>());
+            element<I> result(std::move(slot<I>()));
+            has_been_moved<I>();
+            return result;
+        }
+
+    private:
+        template <std::size_t I>
+        element<I>& slot() noexcept { return static_cast<pack_slot<I, element<I>>&>(*this).slot_value(); }
+
+        template <std::size_t I>
+        element<I> const& slot() const noexcept { return static_cast<pack_slot<I, element<I>> const&>(*this).slot_value(); }
+
+        template <std::size_t I>
+        void mark(bool live) noexcept
+        {
+            using T = element<I>;
+            if constexpr (has_internal_tombstone<T>) {
+                if (!live) {
+                    optional_v2_tombstone_functions<T>()(slot<I>(), tombstone_tag());
+                }
+            }
+            else {
+                flags::flag(pack_flag_bit<I, Ts...>(), live);
+            }
+        }
+
+        // *this must not have any values.  If a copy throws, those already
+        // made are destructed.
+        void copy_all(optional_pack_impl const& other) noexcept(nothrow_copy)
+        {
+            if constexpr (nothrow_copy) {
+                (copy_slot<Is>(other), ...);
+            }
+            else {
+                try {
+                    (copy_slot<Is>(other), ...);
+                }
+                catch (...) {
+                    reset();
+                    throw;
+                }
+            }
+        }
+
+        // *this must not have any values.  If a move throws, those already
+        // moved here are destructed.
+        void take_all(optional_pack_impl& other) noexcept(nothrow_move)
+        {
+            if constexpr (nothrow_move) {
+                (take_slot<Is>(other), ...);
+            }
+            else {
+                try {
+                    (take_slot<Is>(other), ...);
+                }
+                catch (...) {
+                    reset();
+                    throw;
+                }
+            }
+        }
+
+        // *this must not have a value in slot I.
+        template <std::size_t I>
+        void copy_slot(optional_pack_impl const& other)
+        {
+            if (other.template has_value<I>()) {
+                new (std::addressof(slot<I>())) element<I>(other.template slot<I>());
+                mark<I>(true);
+            }
+        }
+
+        // *this must not have a value in slot I.
+        template <std::size_t I>
+        void take_slot(optional_pack_impl& other)
+        {
+            if (other.template has_value<I>()) {
+                new (std::addressof(slot<I>())) element<I>(std::move(other.template slot<I>()));
+                mark<I>(true);
+                other.template has_been_moved<I>();
+            }
+        }
+    };
+}
+
+//=============================================================================
+// template <typename...Ts>
+// class optional_pack;
+//
+//  A tuple of independently optional members.  Each member is kept in a
+//  storage union, and the tombstones of those without an internal one
+//  (Tombstone_functions) are packed into one set of bits, instead of each
+//  having its own bool and padding as an optional_v2 member would.  The
+//  destructor only destructs the members that have a value.
+//
+//  Moving an optional_pack moves each member that has a value and drops the
+//  husks left behind, which only destructs their destructive_move_exempt
+//  members, so the source is left with no values.
+//
+////
+// Members
+////
+//  template <std::size_t I> using element;
+//  static constexpr std::size_t size;
+//
+//  template <std::size_t I> bool has_value() const noexcept;
+//
+//  template <std::size_t I> element<I>& get() (and const) noexcept;
+//
+//   The Ith member, which must have a value.
+//
+//  template <std::size_t I, typename...Args>
+//  element<I>& emplace(Args&&...args);
+//  template <std::size_t I, typename const_tag, typename...Args>
+//  element<I>& emplace(emplace_params<element<I>, const_tag, Args...>&& params);
+//
+//   Destructs the Ith member, if it has a value, and makes a new one.
+//
+//  template <std::size_t I> void reset() noexcept;
+//  void reset() noexcept;
+//
+//   Destructs the Ith member (or all members) that have a value.
+//
+//  template <std::size_t I> void has_been_moved() noexcept;
+//
+//   Tells the pack that the Ith member was moved out of through get(), so
+//   its husk is dropped.
+//
+//  template <std::size_t I> element<I> get_and_drop();
+//
+//   Moves the Ith member, which must have a value, out and drops its husk.
+template <typename...Ts>
+class optional_pack
+    : public detail::optional_pack_impl<std::index_sequence_for<Ts...>, Ts...>
+    , detail::pack_copy<(std::is_copy_constructible_v<Ts> && ...)>
+{
+    static_assert((afh::is_destructive_move_disabled<Ts> && ...)
+        , "Cannot hold a member that is marked disabled in an optional_pack");
+
+public:
+    optional_pack() = default;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_OPTIONAL_PACK_HPP__
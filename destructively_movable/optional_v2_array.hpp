@@ -0,0 +1,476 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_OPTIONAL_V2_ARRAY_HPP__
+#define AFH_OPTIONAL_V2_ARRAY_HPP__
+
+#include "destructively_movable.hpp"
+#include "liveness.hpp"
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <cstring>
+#include <utility>
+
+namespace afh {
+
+//-----------------------------------------------------------------------------
+namespace detail {
+    //-------------------------------------------------------------------------
+    // template <typename T, typename Derived>
+    // class optional_v2_array_base;
+    //
+    //  Common per-index interface for optional_v2_array and
+    //  optional_v2_dynarray.  Derived must provide:
+    //
+    //    T*              values()       noexcept;
+    //    tombstone_word* words()        noexcept;
+    //    std::size_t     size()   const noexcept;
+    //
+    //  and their const counterparts.
+    template <typename T, typename Derived>
+    class optional_v2_array_base
+    {
+        static_assert(afh::is_destructive_move_disabled<T>, "Cannot wrap T in a optional_v2 array as it is marked disabled");
+
+        using Destruct_exempt_members = optional_v2_destruct<T>;
+
+        constexpr Derived      & derived()       noexcept { return static_cast<Derived      &>(*this); }
+        constexpr Derived const& derived() const noexcept { return static_cast<Derived const&>(*this); }
+
+        constexpr tombstone_word mask(std::size_t i) const noexcept { return tombstone_word(1) << (i % tombstone_word_bits); }
+
+        constexpr void is_tombstoned(std::size_t i, bool value) noexcept
+        {
+            auto& word = derived().words()[i / tombstone_word_bits];
+            if (value)
+                word |=  mask(i);
+            else
+                word &= ~mask(i);
+        }
+
+    public:
+        using contained = T;
+        using size_type = std::size_t;
+
+        constexpr bool is_tombstoned(size_type i) const noexcept
+        {
+            assert(i < derived().size());
+            return (derived().words()[i / tombstone_word_bits] & mask(i)) != 0;
+        }
+
+        // Mimic std::optional::has_value()
+        constexpr bool has_value(size_type i) const noexcept { return !is_tombstoned(i); }
+
+        // Number of elements that are not tombstoned.
+        size_type count() const noexcept
+        {
+            return count_live(derived().words(), derived().size());
+        }
+
+        // Index of the first element in [from, size()) that is not
+        // tombstoned, or size() if there isn't one.
+        size_type find_next_live(size_type from) const noexcept
+        {
+            return ::afh::find_next_live(derived().words(), from, derived().size());
+        }
+
+        // Writes the indices of the elements that are not tombstoned to out,
+        // which must have room for count() indices.  Returns the number
+        // written.
+        template <typename Index>
+        size_type live_indices(Index* out) const noexcept
+        {
+            return ::afh::live_indices(derived().words(), derived().size(), out);
+        }
+
+        // Relocates the elements that are not tombstoned to the front,
+        // keeping their order, and returns how many there are.  Afterwards,
+        // [0, count()) are live and the rest are tombstoned.
+        size_type compact() noexcept(::afh::is_trivially_relocatable<T> || std::is_nothrow_move_constructible_v<T>)
+        {
+            T*              values     = derived().values();
+            tombstone_word* words      = derived().words();
+            size_type       size       = derived().size();
+            size_type       word_count = tombstone_words(size);
+            size_type       live_count = 0;
+            for (size_type w = kernels().find_live_word(words, 0, word_count)
+                ; w != word_count
+                ; w = kernels().find_live_word(words, w + 1, word_count))
+            {
+                tombstone_word live = ~words[w];
+                if (w == word_count - 1 && size % tombstone_word_bits) {
+                    live &= (tombstone_word(1) << (size % tombstone_word_bits)) - 1;
+                }
+                for (; live; live &= live - 1, ++live_count) {
+                    size_type i = w * tombstone_word_bits + countr_zero(live);
+                    if (i != live_count) {
+                        relocate(values + i, values + live_count);
+                    }
+                }
+            }
+            tombstone_from(words, live_count, size);
+            return live_count;
+        }
+
+        // The packed tombstone bitmap.  Bit i % 64 of word i / 64 is set if
+        // element i is tombstoned.  Padding bits in the last word are clear.
+        constexpr tombstone_word const* tombstone_bitmap() const noexcept { return derived().words(); }
+
+        // Does emplace construction of T at index i, which must be
+        // tombstoned.
+        template <typename U, typename const_tag, typename...Ts
+            , std::enable_if_t<std::is_same<T, U>::value, int> = 0>
+        T& emplace(size_type i, emplace_params<U, const_tag, Ts...>&& params)
+            noexcept(noexcept(params.uninitialized_construct(nullptr)))
+        {
+            assert(is_tombstoned(i));
+            params.uninitialized_construct(derived().values() + i);
+            is_tombstoned(i, false);
+            return derived().values()[i];
+        }
+
+        // A const emplace_params passes all params as const lvalues, allowing
+        // for safe reuse.
+        template <typename U, typename const_tag, typename...Ts
+            , std::enable_if_t<std::is_same<T, U>::value, int> = 0>
+        T& emplace(size_type i, emplace_params<U, const_tag, Ts...> const& params)
+            noexcept(noexcept(params.uninitialized_construct(nullptr)))
+        {
+            assert(is_tombstoned(i));
+            params.uninitialized_construct(derived().values() + i);
+            is_tombstoned(i, false);
+            return derived().values()[i];
+        }
+
+        // A non-const lvalue emplace_params is passed on as const, rather
+        // than being wrapped in another emplace_params by the overload below.
+        template <typename U, typename const_tag, typename...Ts
+            , std::enable_if_t<std::is_same<T, U>::value, int> = 0>
+        T& emplace(size_type i, emplace_params<U, const_tag, Ts...>& params)
+            noexcept(noexcept(std::as_const(params).uninitialized_construct(nullptr)))
+        {
+            return emplace(i, std::as_const(params));
+        }
+
+        template <typename...Ts>
+        T& emplace(size_type i, Ts&&...args)
+            noexcept(noexcept(std::declval<optional_v2_array_base&>().emplace(i, ::afh::emplace<T>(std::forward<Ts>(args)...))))
+        {
+            return emplace(i, ::afh::emplace<T>(std::forward<Ts>(args)...));
+        }
+
+        // Calls the destructor on element i, which must not be tombstoned.
+        void reset(size_type i) noexcept
+        {
+            assert(!is_tombstoned(i));
+            derived().values()[i].~T();
+            is_tombstoned(i, true);
+        }
+
+        // Marks element i, whose contents has been moved out, as tombstoned
+        // without calling its destructor.  Only destructive_move_exempt
+        // members are destructed, which is done now rather than when the
+        // array is destroyed.
+        void has_been_moved(size_type i) noexcept
+        {
+            assert(!is_tombstoned(i));
+            Destruct_exempt_members()(derived().values()[i]);
+            is_tombstoned(i, true);
+        }
+
+        // Element access.  Element i must not be tombstoned.
+        T      & operator[](size_type i)       noexcept { assert(!is_tombstoned(i)); return derived().values()[i]; }
+        T const& operator[](size_type i) const noexcept { assert(!is_tombstoned(i)); return derived().values()[i]; }
+
+        T      & at(size_type i)       { check_index(i); return derived().values()[i]; }
+        T const& at(size_type i) const { check_index(i); return derived().values()[i]; }
+
+    protected:
+        // Relocates the live object at source to the uninitialised dest.
+        // Bits are left for the caller to update.
+        static void relocate(T* source, T* dest) noexcept(::afh::is_trivially_relocatable<T> || std::is_nothrow_move_constructible_v<T>)
+        {
+            if constexpr (::afh::is_trivially_relocatable<T>) {
+                std::memcpy(static_cast<void*>(dest), static_cast<void const*>(source), sizeof(T));
+            }
+            else {
+                new (dest) T(std::move(*source));
+                Destruct_exempt_members()(*source);
+            }
+        }
+
+        void check_index(size_type i) const
+        {
+            if (i >= derived().size()) {
+                throw std::out_of_range("optional_v2 array index out of range");
+            }
+            if (is_tombstoned(i)) {
+                throw std::logic_error("optional_v2 array element is tombstoned");
+            }
+        }
+
+        void reset_all() noexcept
+        {
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                for (size_type i = 0, n = derived().size(); i != n; ++i) {
+                    if (!is_tombstoned(i)) {
+                        reset(i);
+                    }
+                }
+            }
+            else {
+                tombstone_all(derived().words(), derived().size());
+            }
+        }
+
+        // Copies the live elements of other into this, which must be all
+        // tombstoned.
+        void copy_from(Derived const& other)
+        {
+            for (size_type i = 0, n = derived().size(); i != n; ++i) {
+                if (!other.is_tombstoned(i)) {
+                    emplace(i, other.values()[i]);
+                }
+            }
+        }
+
+        // Moves the live elements of other into this, which must be all
+        // tombstoned, and tombstones them in other.
+        void move_from(Derived& other)
+        {
+            for (size_type i = 0, n = derived().size(); i != n; ++i) {
+                if (!other.is_tombstoned(i)) {
+                    emplace(i, std::move(other.values()[i]));
+                    other.has_been_moved(i);
+                }
+            }
+        }
+    };
+}
+
+//=============================================================================
+// template <typename T, std::size_t N>
+// class optional_v2_array;
+//
+//  A fixed size array of N optional T elements.  This has the same purpose as
+//  an array of optional_v2<T>, but the tombstones are kept in a packed bitset
+//  beside the elements rather than in each element.  So each element keeps
+//  the stride of sizeof(T) even if T has no internal tombstone, and the
+//  liveness of the whole array can be checked by reading 1 bit per element.
+//
+//  All elements start out tombstoned.
+//
+////
+// Per-index operations
+////
+//  bool is_tombstoned(size_type i) const noexcept;
+//  bool has_value    (size_type i) const noexcept;
+//
+//   Returns if element i is (not) constructed.
+//
+//  template <typename...Ts>
+//  T& emplace(size_type i, Ts&&...args);
+//
+//   Constructs element i, which must be tombstoned.  args can be an
+//   afh::emplace<T>(...) object or the parameters to pass to T's constructor.
+//   An emplace<T>(...) object that is an lvalue is used as if it were const,
+//   so its parameters are passed as const lvalues and it can be reused.
+//
+//  void reset(size_type i);
+//
+//   Calls the destructor on element i and tombstones it.
+//
+//  void has_been_moved(size_type i);
+//
+//   Tombstones element i after its contents has been moved out, without
+//   calling its destructor (other than for destructive_move_exempt
+//   members).
+//
+////
+// Whole array operations
+////
+//  size_type count() const noexcept;
+//
+//   Returns the number of elements that are not tombstoned.
+//
+//  tombstone_word const* tombstone_bitmap() const noexcept;
+//
+//   Returns the packed bitmap, 64 elements per word.  A set bit means the
+//   element is tombstoned.
+template <typename T, std::size_t N>
+class optional_v2_array
+    : public detail::optional_v2_array_base<T, optional_v2_array<T, N>>
+{
+    using base = detail::optional_v2_array_base<T, optional_v2_array<T, N>>;
+    friend base;
+
+public:
+    using tombstone_word = afh::tombstone_word;
+    using size_type      = std::size_t;
+
+    optional_v2_array() noexcept
+    {
+        detail::tombstone_all(m_words, N);
+    }
+
+    optional_v2_array(optional_v2_array const& other)
+        : optional_v2_array()
+    {
+        base::copy_from(other);
+    }
+
+    optional_v2_array(optional_v2_array&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+        : optional_v2_array()
+    {
+        base::move_from(other);
+    }
+
+    optional_v2_array& operator=(optional_v2_array const& other)
+    {
+        if (this != &other) {
+            base::reset_all();
+            base::copy_from(other);
+        }
+        return *this;
+    }
+
+    optional_v2_array& operator=(optional_v2_array&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        if (this != &other) {
+            base::reset_all();
+            base::move_from(other);
+        }
+        return *this;
+    }
+
+    ~optional_v2_array()
+    {
+        base::reset_all();
+    }
+
+    static constexpr size_type size() noexcept { return N; }
+
+    // Raw element storage.  Only elements that are not tombstoned are
+    // constructed.
+    T      * data()       noexcept { return m_values; }
+    T const* data() const noexcept { return m_values; }
+
+private:
+    T                   * values()       noexcept { return m_values; }
+    T const             * values() const noexcept { return m_values; }
+    tombstone_word      * words ()       noexcept { return m_words; }
+    tombstone_word const* words () const noexcept { return m_words; }
+
+    union {
+        T m_values[N];
+    };
+    tombstone_word m_words[detail::tombstone_words(N)];
+};
+
+//=============================================================================
+// template <typename T>
+// class optional_v2_dynarray;
+//
+//  Same as optional_v2_array, but the number of elements is given at
+//  construction and the elements and tombstone bitmap are heap allocated.
+template <typename T>
+class optional_v2_dynarray
+    : public detail::optional_v2_array_base<T, optional_v2_dynarray<T>>
+{
+    using base = detail::optional_v2_array_base<T, optional_v2_dynarray<T>>;
+    friend base;
+
+public:
+    using tombstone_word = afh::tombstone_word;
+    using size_type      = std::size_t;
+
+    optional_v2_dynarray() noexcept = default;
+
+    explicit optional_v2_dynarray(size_type size)
+        : m_words(new tombstone_word[detail::tombstone_words(size)])
+        , m_size(size)
+    {
+        m_values = static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t(alignof(T))));
+        detail::tombstone_all(m_words.get(), size);
+    }
+
+    optional_v2_dynarray(optional_v2_dynarray const& other)
+        : optional_v2_dynarray(other.size())
+    {
+        base::copy_from(other);
+    }
+
+    optional_v2_dynarray(optional_v2_dynarray&& other) noexcept
+        : m_values(std::exchange(other.m_values, nullptr))
+        , m_words (std::move(other.m_words))
+        , m_size  (std::exchange(other.m_size, 0))
+    {}
+
+    optional_v2_dynarray& operator=(optional_v2_dynarray const& other)
+    {
+        if (this != &other) {
+            optional_v2_dynarray(other).swap(*this);
+        }
+        return *this;
+    }
+
+    optional_v2_dynarray& operator=(optional_v2_dynarray&& other) noexcept
+    {
+        optional_v2_dynarray(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~optional_v2_dynarray()
+    {
+        if (m_values) {
+            base::reset_all();
+            ::operator delete(m_values, std::align_val_t(alignof(T)));
+        }
+    }
+
+    size_type size() const noexcept { return m_size; }
+
+    // Raw element storage.  Only elements that are not tombstoned are
+    // constructed.
+    T      * data()       noexcept { return m_values; }
+    T const* data() const noexcept { return m_values; }
+
+    void swap(optional_v2_dynarray& other) noexcept
+    {
+        using std::swap;
+        swap(m_values, other.m_values);
+        swap(m_words , other.m_words);
+        swap(m_size  , other.m_size);
+    }
+
+    friend void swap(optional_v2_dynarray& lhs, optional_v2_dynarray& rhs) noexcept
+    {
+        lhs.swap(rhs);
+    }
+
+private:
+    T                   * values()       noexcept { return m_values; }
+    T const             * values() const noexcept { return m_values; }
+    tombstone_word      * words ()       noexcept { return m_words.get(); }
+    tombstone_word const* words () const noexcept { return m_words.get(); }
+
+    T*                                m_values = nullptr;
+    std::unique_ptr<tombstone_word[]> m_words;
+    size_type                         m_size   = 0;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_OPTIONAL_V2_ARRAY_HPP__
@@ -0,0 +1,319 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_OPTIONAL_V2_EPOCH_ARRAY_HPP__
+#define AFH_OPTIONAL_V2_EPOCH_ARRAY_HPP__
+
+#include "destructively_movable.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace afh {
+
+//=============================================================================
+// template <typename T, typename Epoch = std::uint32_t>
+// class optional_v2_epoch_array;
+//
+//  Same as optional_v2_dynarray, but instead of a tombstone bit, each element
+//  has the epoch it was constructed in, and it is only live if that is the
+//  array's current epoch.  So tombstoning every element at once, after they
+//  have all been moved out of, is just incrementing the epoch.
+//
+//  An element tombstoned on its own has epoch 0, which is never current.
+//  When the epoch would wrap, every element's epoch is set back to 0 first,
+//  so a smaller Epoch saves memory but does that linear pass every
+//  numeric_limits<Epoch>::max() drop_all()s.
+//
+//  All elements start out tombstoned.
+//
+////
+// Per-index operations
+////
+//  bool is_tombstoned(size_type i) const noexcept;
+//  bool has_value    (size_type i) const noexcept;
+//
+//   Returns if element i is (not) constructed.
+//
+//  template <typename...Ts>
+//  T& emplace(size_type i, Ts&&...args);
+//
+//   Constructs element i, which must be tombstoned.  args can be an
+//   afh::emplace<T>(...) object or the parameters to pass to T's constructor.
+//   An emplace<T>(...) object that is an lvalue is used as if it were const,
+//   so its parameters are passed as const lvalues and it can be reused.
+//
+//  void reset(size_type i);
+//
+//   Calls the destructor on element i and tombstones it.
+//
+//  void has_been_moved(size_type i);
+//
+//   Tombstones element i after its contents has been moved out, without
+//   calling its destructor (other than for destructive_move_exempt
+//   members).
+//
+////
+// Whole array operations
+////
+//  void drop_all() noexcept;
+//
+//   Tombstones every element in O(1) without calling any destructors.  Each
+//   element must either be tombstoned, have had its contents moved out or
+//   be trivially destructible.  T must not have destructive_move_exempt
+//   members, as those would have to be destructed one by one.
+//
+//  void reset_all() noexcept;
+//
+//   Calls the destructor on each element that isn't tombstoned and then
+//   tombstones every element.
+//
+//  size_type count() const noexcept;
+//
+//   Returns the number of elements that are not tombstoned.
+//
+//  Epoch epoch() const noexcept;
+//
+//   The current epoch.
+template <typename T, typename Epoch = std::uint32_t>
+class optional_v2_epoch_array
+{
+    static_assert(afh::is_destructive_move_disabled<T>, "Cannot wrap T in a optional_v2 array as it is marked disabled");
+    static_assert(std::is_unsigned_v<Epoch>, "Epoch must be an unsigned integer.");
+
+    using Destruct_exempt_members = optional_v2_destruct<T>;
+
+    static constexpr Epoch tombstoned_epoch = 0;
+
+public:
+    using contained = T;
+    using size_type = std::size_t;
+    using epoch_type = Epoch;
+
+    optional_v2_epoch_array() noexcept = default;
+
+    explicit optional_v2_epoch_array(size_type size)
+        : m_epochs(new Epoch[size]())
+        , m_size(size)
+    {
+        m_values = static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t(alignof(T))));
+    }
+
+    optional_v2_epoch_array(optional_v2_epoch_array const& other)
+        : optional_v2_epoch_array(other.size())
+    {
+        for (size_type i = 0; i != m_size; ++i) {
+            if (other.has_value(i)) {
+                emplace(i, other.m_values[i]);
+            }
+        }
+    }
+
+    optional_v2_epoch_array(optional_v2_epoch_array&& other) noexcept
+        : m_values(std::exchange(other.m_values, nullptr))
+        , m_epochs(std::move(other.m_epochs))
+        , m_size  (std::exchange(other.m_size, 0))
+        , m_epoch (std::exchange(other.m_epoch, Epoch(1)))
+    {}
+
+    optional_v2_epoch_array& operator=(optional_v2_epoch_array const& other)
+    {
+        if (this != &other) {
+            optional_v2_epoch_array(other).swap(*this);
+        }
+        return *this;
+    }
+
+    optional_v2_epoch_array& operator=(optional_v2_epoch_array&& other) noexcept
+    {
+        optional_v2_epoch_array(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~optional_v2_epoch_array()
+    {
+        if (m_values) {
+            destruct_live();
+            ::operator delete(m_values, std::align_val_t(alignof(T)));
+        }
+    }
+
+    size_type size () const noexcept { return m_size; }
+    Epoch     epoch() const noexcept { return m_epoch; }
+
+    bool is_tombstoned(size_type i) const noexcept
+    {
+        assert(i < m_size);
+        return m_epochs[i] != m_epoch;
+    }
+
+    // Mimic std::optional::has_value()
+    bool has_value(size_type i) const noexcept { return !is_tombstoned(i); }
+
+    // Number of elements that are not tombstoned.
+    size_type count() const noexcept
+    {
+        return size_type(std::count(m_epochs.get(), m_epochs.get() + m_size, m_epoch));
+    }
+
+    // Does emplace construction of T at index i, which must be tombstoned.
+    template <typename U, typename const_tag, typename...Ts
+        , std::enable_if_t<std::is_same<T, U>::value, int> = 0>
+    T& emplace(size_type i, emplace_params<U, const_tag, Ts...>&& params)
+        noexcept(noexcept(params.uninitialized_construct(nullptr)))
+    {
+        assert(is_tombstoned(i));
+        params.uninitialized_construct(m_values + i);
+        m_epochs[i] = m_epoch;
+        return m_values[i];
+    }
+
+    // A const emplace_params passes all params as const lvalues, allowing
+    // for safe reuse.
+    template <typename U, typename const_tag, typename...Ts
+        , std::enable_if_t<std::is_same<T, U>::value, int> = 0>
+    T& emplace(size_type i, emplace_params<U, const_tag, Ts...> const& params)
+        noexcept(noexcept(params.uninitialized_construct(nullptr)))
+    {
+        assert(is_tombstoned(i));
+        params.uninitialized_construct(m_values + i);
+        m_epochs[i] = m_epoch;
+        return m_values[i];
+    }
+
+    // A non-const lvalue emplace_params is passed on as const, rather than
+    // being wrapped in another emplace_params by the overload below.
+    template <typename U, typename const_tag, typename...Ts
+        , std::enable_if_t<std::is_same<T, U>::value, int> = 0>
+    T& emplace(size_type i, emplace_params<U, const_tag, Ts...>& params)
+        noexcept(noexcept(std::as_const(params).uninitialized_construct(nullptr)))
+    {
+        return emplace(i, std::as_const(params));
+    }
+
+    template <typename...Ts>
+    T& emplace(size_type i, Ts&&...args)
+        noexcept(noexcept(std::declval<optional_v2_epoch_array&>().emplace(i, ::afh::emplace<T>(std::forward<Ts>(args)...))))
+    {
+        return emplace(i, ::afh::emplace<T>(std::forward<Ts>(args)...));
+    }
+
+    // Calls the destructor on element i, which must not be tombstoned.
+    void reset(size_type i) noexcept
+    {
+        assert(!is_tombstoned(i));
+        m_values[i].~T();
+        m_epochs[i] = tombstoned_epoch;
+    }
+
+    // Marks element i, whose contents has been moved out, as tombstoned
+    // without calling its destructor.  Only destructive_move_exempt members
+    // are destructed, which is done now rather than when the array is
+    // destroyed.
+    void has_been_moved(size_type i) noexcept
+    {
+        assert(!is_tombstoned(i));
+        Destruct_exempt_members()(m_values[i]);
+        m_epochs[i] = tombstoned_epoch;
+    }
+
+    // Tombstones every element by moving to the next epoch.
+    void drop_all() noexcept
+    {
+        static_assert(Destruct_exempt_members::is_empty
+            , "drop_all() can't destruct the destructive_move_exempt members of each husk.");
+        next_epoch();
+    }
+
+    void reset_all() noexcept
+    {
+        destruct_live();
+        next_epoch();
+    }
+
+    // Element access.  Element i must not be tombstoned.
+    T      & operator[](size_type i)       noexcept { assert(!is_tombstoned(i)); return m_values[i]; }
+    T const& operator[](size_type i) const noexcept { assert(!is_tombstoned(i)); return m_values[i]; }
+
+    T      & at(size_type i)       { check_index(i); return m_values[i]; }
+    T const& at(size_type i) const { check_index(i); return m_values[i]; }
+
+    // Raw element storage.  Only elements that are not tombstoned are
+    // constructed.
+    T      * data()       noexcept { return m_values; }
+    T const* data() const noexcept { return m_values; }
+
+    void swap(optional_v2_epoch_array& other) noexcept
+    {
+        using std::swap;
+        swap(m_values, other.m_values);
+        swap(m_epochs, other.m_epochs);
+        swap(m_size  , other.m_size);
+        swap(m_epoch , other.m_epoch);
+    }
+
+    friend void swap(optional_v2_epoch_array& lhs, optional_v2_epoch_array& rhs) noexcept
+    {
+        lhs.swap(rhs);
+    }
+
+private:
+    void check_index(size_type i) const
+    {
+        if (i >= m_size) {
+            throw std::out_of_range("optional_v2 array index out of range");
+        }
+        if (is_tombstoned(i)) {
+            throw std::logic_error("optional_v2 array element is tombstoned");
+        }
+    }
+
+    void destruct_live() noexcept
+    {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (size_type i = 0; i != m_size; ++i) {
+                if (m_epochs[i] == m_epoch) {
+                    m_values[i].~T();
+                }
+            }
+        }
+    }
+
+    // Tombstones every element.  When the epoch would wrap, the elements'
+    // epochs are cleared so none of them can come back to life.
+    void next_epoch() noexcept
+    {
+        if (m_epoch == std::numeric_limits<Epoch>::max()) {
+            std::fill_n(m_epochs.get(), m_size, tombstoned_epoch);
+            m_epoch = 1;
+        }
+        else {
+            ++m_epoch;
+        }
+    }
+
+    T*                       m_values = nullptr;
+    std::unique_ptr<Epoch[]> m_epochs;
+    size_type                m_size   = 0;
+    Epoch                    m_epoch  = 1;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_OPTIONAL_V2_EPOCH_ARRAY_HPP__
@@ -0,0 +1,291 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_POLY_V2_HPP__
+#define AFH_POLY_V2_HPP__
+
+#include "destructively_movable.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace afh {
+
+//=============================================================================
+// template <typename Base
+//     , std::size_t MaxSize  = 64 - sizeof(void*)
+//     , std::size_t MaxAlign = alignof(std::max_align_t)>
+// class poly_v2;
+//
+//  Holds an object of any type D derived from (or the same as) Base, that is
+//  no bigger than MaxSize and no more aligned than MaxAlign, in inline
+//  storage instead of on the heap.  With the defaults, a poly_v2 is 64 bytes.
+//
+//  Each D has a descriptor, holding how to relocate and destruct it and where
+//  its Base is, so Base doesn't need a virtual destructor.  Moving a poly_v2
+//  relocates the object and leaves the source empty:
+//
+//   - A D that is_trivially_relocatable is memcpy'd.
+//   - Otherwise it is moved and its husk dropped, only destructing its
+//     destructive_move_exempt members.
+//
+//  Each D must be allowed in an optional_v2, and must be nothrow move
+//  constructible or trivially relocatable.
+//
+//  An empty poly_v2 has a null descriptor pointer, so the low bit of that is
+//  the tombstone of an optional_v2<poly_v2>, which is then the same size as
+//  the poly_v2.
+//
+////
+// Members
+////
+//  poly_v2() noexcept;
+//  poly_v2(std::nullptr_t) noexcept;
+//
+//   Empty.
+//
+//  template <typename D>
+//  poly_v2(D&& value);
+//  template <typename D, typename...Args>
+//  explicit poly_v2(std::in_place_type_t<D>, Args&&...args);
+//  template <typename D, typename const_tag, typename...Ts>
+//  poly_v2(emplace_params<D, const_tag, Ts...>&& params);
+//
+//   Holds a D (std::decay_t<D> for the first) made from value, args or
+//   params.
+//
+//  template <typename D, typename...Args>
+//  D& emplace(Args&&...args);
+//  template <typename D, typename const_tag, typename...Ts>
+//  D& emplace(emplace_params<D, const_tag, Ts...>&& params);
+//
+//   Destructs the held object, if any, and makes a D.  If that throws, the
+//   poly_v2 is left empty.
+//
+//  Base* get() const noexcept;
+//
+//   The Base of the held object, or nullptr if empty.
+//
+//  void reset() noexcept;
+//
+//   Destructs the held object, if any.
+//
+//  template <typename D>
+//  static constexpr bool fits;
+//
+//   If a D can be held.
+template <typename Base
+    , std::size_t MaxSize  = 64 - sizeof(void*)
+    , std::size_t MaxAlign = alignof(std::max_align_t)>
+class poly_v2
+{
+    struct descriptor {
+        void      (*relocate)(void* from, void* to) noexcept; // nullptr: memcpy the storage
+        void      (*destroy )(void* storage) noexcept;        // nullptr: nothing to do
+        std::size_t base_offset;
+    };
+
+    template <typename D>
+    static D* object(void* storage) noexcept
+    {
+        return std::launder(reinterpret_cast<D*>(storage));
+    }
+
+    template <typename D>
+    static void relocate(void* from, void* to) noexcept
+    {
+        D* source = object<D>(from);
+        new (to) D(std::move(*source));
+        optional_v2_destruct<D>()(*source);
+    }
+
+    template <typename D>
+    static void destroy(void* storage) noexcept
+    {
+        std::destroy_at(object<D>(storage));
+    }
+
+    // The Base offset is taken from the first object made, as with virtual
+    // inheritance it can't be found without one.
+    template <typename D>
+    static descriptor const* describe(D* made) noexcept
+    {
+        static descriptor const instance = {
+            is_trivially_relocatable<D>         ? nullptr : &relocate<D>,
+            std::is_trivially_destructible_v<D> ? nullptr : &destroy<D>,
+            std::size_t(reinterpret_cast<unsigned char*>(static_cast<Base*>(made)) - reinterpret_cast<unsigned char*>(made))
+        };
+        return &instance;
+    }
+
+public:
+    template <typename D>
+    static constexpr bool fits =
+        std::is_base_of_v<Base, D>
+        && sizeof(D) <= MaxSize
+        && alignof(D) <= MaxAlign
+        && (is_trivially_relocatable<D> || std::is_nothrow_move_constructible_v<D>);
+
+    poly_v2() noexcept = default;
+    poly_v2(std::nullptr_t) noexcept {}
+
+    template <typename D, typename = std::enable_if_t<
+        !std::is_same_v<std::decay_t<D>, poly_v2>
+        && std::is_base_of_v<Base, std::decay_t<D>>
+    >>
+    poly_v2(D&& value)
+    {
+        construct<std::decay_t<D>>(std::forward<D>(value));
+    }
+
+    template <typename D, typename...Args>
+    explicit poly_v2(std::in_place_type_t<D>, Args&&...args)
+    {
+        construct<D>(std::forward<Args>(args)...);
+    }
+
+    template <typename D, typename const_tag, typename...Ts>
+    poly_v2(emplace_params<D, const_tag, Ts...>&& params)
+    {
+        construct(std::move(params));
+    }
+
+    poly_v2(poly_v2&& other) noexcept
+    {
+        take(other);
+    }
+
+    poly_v2& operator=(poly_v2&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    poly_v2& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    ~poly_v2()
+    {
+        reset();
+    }
+
+    template <typename D, typename...Args>
+    D& emplace(Args&&...args)
+    {
+        reset();
+        return construct<D>(std::forward<Args>(args)...);
+    }
+
+    template <typename D, typename const_tag, typename...Ts>
+    D& emplace(emplace_params<D, const_tag, Ts...>&& params)
+    {
+        reset();
+        return construct(std::move(params));
+    }
+
+    void reset() noexcept
+    {
+        if (m_descriptor) {
+            if (m_descriptor->destroy) {
+                m_descriptor->destroy(m_storage);
+            }
+            m_descriptor = nullptr;
+        }
+    }
+
+    void swap(poly_v2& other) noexcept
+    {
+        poly_v2 temp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+
+    friend void swap(poly_v2& a, poly_v2& b) noexcept { a.swap(b); }
+
+    bool has_value() const noexcept { return m_descriptor != nullptr; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    Base* get() const noexcept
+    {
+        return m_descriptor
+            ? std::launder(reinterpret_cast<Base*>(const_cast<unsigned char*>(m_storage) + m_descriptor->base_offset))
+            : nullptr;
+    }
+
+    Base& operator* () const noexcept { assert(m_descriptor); return *get(); }
+    Base* operator->() const noexcept { assert(m_descriptor); return  get(); }
+
+private:
+    template <typename D>
+    static constexpr void check() noexcept
+    {
+        static_assert(std::is_base_of_v<Base, D>, "D must be derived from Base.");
+        static_assert(sizeof(D) <= MaxSize && alignof(D) <= MaxAlign, "D doesn't fit in MaxSize and MaxAlign.");
+        static_assert(is_trivially_relocatable<D> || std::is_nothrow_move_constructible_v<D>, "Relocating D must not throw.");
+        static_assert(afh::is_destructive_move_disabled<D>, "Cannot hold D in a poly_v2 as it is marked disabled");
+    }
+
+    template <typename D, typename...Args>
+    D& construct(Args&&...args)
+    {
+        check<D>();
+        D* made = new (m_storage) D(std::forward<Args>(args)...);
+        m_descriptor = describe(made);
+        return *made;
+    }
+
+    template <typename D, typename const_tag, typename...Ts>
+    D& construct(emplace_params<D, const_tag, Ts...>&& params)
+    {
+        check<D>();
+        D* made = params.uninitialized_construct(m_storage);
+        m_descriptor = describe(made);
+        return *made;
+    }
+
+    // Relocates other's object here.  *this must be empty.
+    void take(poly_v2& other) noexcept
+    {
+        m_descriptor = other.m_descriptor;
+        if (m_descriptor) {
+            if (m_descriptor->relocate) {
+                m_descriptor->relocate(other.m_storage, m_storage);
+            }
+            else {
+                std::memcpy(m_storage, other.m_storage, MaxSize);
+            }
+            other.m_descriptor = nullptr;
+        }
+    }
+
+    alignas(MaxAlign) unsigned char m_storage[MaxSize];
+    descriptor const*               m_descriptor = nullptr;
+
+public:
+    // An empty poly_v2 has a null descriptor pointer, so the tombstone is its
+    // low bit instead.
+    using Tombstone_functions = tombstone_via_low_bit<&poly_v2::m_descriptor>;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_POLY_V2_HPP__
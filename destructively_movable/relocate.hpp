@@ -0,0 +1,280 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_RELOCATE_HPP__
+#define AFH_RELOCATE_HPP__
+
+#include "destructively_movable.hpp"
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace afh {
+
+//-----------------------------------------------------------------------------
+namespace detail {
+    // Drops a husk that has had its contents moved out.  Nothing is done if
+    // there is nothing to destruct after a move, otherwise the destructor is
+    // called which will only destruct the destructive_move_exempt members.
+    template <typename Slot>
+    constexpr void drop_husk(Slot* husk) noexcept
+    {
+        assert(husk->is_tombstoned() || std::is_trivially_destructible_v<Slot>);
+        if constexpr (!Slot::has_nothing_to_destruct_after_move) {
+            std::destroy_at(husk);
+        }
+        else if constexpr (!std::is_trivially_destructible_v<Slot>) {
+            trace<typename Slot::contained>(trace_event::elided_destruction, husk);
+        }
+    }
+
+    template <typename T, typename I>
+    constexpr bool is_nothrow_relocatable =
+        ::afh::is_trivially_relocatable<T> || std::is_nothrow_constructible_v<optional_v2<T, I>, optional_v2<T, I>&&>;
+
+    // Calls the part of a slot's destructor that applies, without reading
+    // its tombstone again.  The slot's lifetime ends without anything else
+    // being done to it, as optional_v2's destructor does nothing else.
+    struct slot_destructor
+    {
+        template <typename Slot>
+        static void value(Slot& slot) noexcept { slot.destruct_value(); }
+
+        template <typename Slot>
+        static void husk (Slot& slot) noexcept { slot.destruct_husk(); }
+    };
+
+    inline void prefetch(void const* p) noexcept
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(p);
+#else
+        (void)p;
+#endif
+    }
+
+    // destroy_n() classifies this many slots at a time.
+    constexpr std::size_t destroy_block = 256;
+
+    // Destroys base[index[i]] for each i in [0, count), each of which is live
+    // if Live is true, or a husk otherwise.
+    template <bool Live, typename Slot>
+    void destroy_indexed(Slot* base, std::uint16_t const* index, std::size_t count) noexcept
+    {
+        for (std::size_t i = 0; i != count; ++i) {
+            if constexpr (Live) {
+                slot_destructor::value(base[index[i]]);
+            }
+            else {
+                slot_destructor::husk(base[index[i]]);
+            }
+        }
+    }
+
+    template <typename T, typename I>
+    void memmove_slots(optional_v2<T, I>* dest, optional_v2<T, I> const* source, std::size_t count) noexcept
+    {
+        if (count != 0) {
+            std::memmove(static_cast<void*>(dest), static_cast<void const*>(source), count * sizeof(optional_v2<T, I>));
+        }
+    }
+}
+
+//=============================================================================
+// template <typename T, typename I>
+// void relocate_at(optional_v2<T, I>* source, optional_v2<T, I>* dest);
+//
+//  Relocates the object in the slot at source to the uninitialised slot at
+//  dest.  Afterwards, source is uninitialised memory.
+//
+//  If T is_trivially_relocatable, this is a memcpy of the slot.  Otherwise
+//  the object is moved into dest and the husk left behind is dropped.  A
+//  slot that is already tombstoned is recreated as a tombstone.
+template <typename T, typename I>
+void relocate_at(optional_v2<T, I>* source, optional_v2<T, I>* dest)
+    noexcept(detail::is_nothrow_relocatable<T, I>)
+{
+    using slot = optional_v2<T, I>;
+    if constexpr (is_trivially_relocatable<T>) {
+        std::memcpy(static_cast<void*>(dest), static_cast<void const*>(source), sizeof(slot));
+    }
+    else {
+        if (source->has_value()) {
+            new (dest) slot(std::move(*source));
+        }
+        else {
+            new (dest) slot(tombstone_tag{});
+        }
+        detail::drop_husk(source);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I>
+// optional_v2<T, I>* uninitialized_relocate(
+//     optional_v2<T, I>* first, optional_v2<T, I>* last, optional_v2<T, I>* d_first);
+//
+//  Relocates [first, last) to the uninitialised range starting at d_first,
+//  starting from the front.  The ranges may only overlap if d_first < first.
+//  Returns the end of the destination range.
+template <typename T, typename I>
+optional_v2<T, I>* uninitialized_relocate(
+    optional_v2<T, I>* first, optional_v2<T, I>* last, optional_v2<T, I>* d_first)
+    noexcept(detail::is_nothrow_relocatable<T, I>)
+{
+    if constexpr (is_trivially_relocatable<T>) {
+        std::size_t count = last - first;
+        detail::memmove_slots(d_first, first, count);
+        return d_first + count;
+    }
+    else {
+        for (; first != last; ++first, ++d_first) {
+            relocate_at(first, d_first);
+        }
+        return d_first;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I>
+// std::pair<optional_v2<T, I>*, optional_v2<T, I>*> uninitialized_relocate_n(
+//     optional_v2<T, I>* first, std::size_t count, optional_v2<T, I>* d_first);
+//
+//  Same as uninitialized_relocate(first, first + count, d_first), but returns
+//  the end of both the source and destination ranges.
+template <typename T, typename I>
+std::pair<optional_v2<T, I>*, optional_v2<T, I>*> uninitialized_relocate_n(
+    optional_v2<T, I>* first, std::size_t count, optional_v2<T, I>* d_first)
+    noexcept(detail::is_nothrow_relocatable<T, I>)
+{
+    return { first + count, uninitialized_relocate(first, first + count, d_first) };
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I>
+// optional_v2<T, I>* uninitialized_relocate_backward(
+//     optional_v2<T, I>* first, optional_v2<T, I>* last, optional_v2<T, I>* d_last);
+//
+//  Relocates [first, last) to the uninitialised range ending at d_last,
+//  starting from the back.  The ranges may only overlap if d_last > last.
+//  Returns the start of the destination range.
+template <typename T, typename I>
+optional_v2<T, I>* uninitialized_relocate_backward(
+    optional_v2<T, I>* first, optional_v2<T, I>* last, optional_v2<T, I>* d_last)
+    noexcept(detail::is_nothrow_relocatable<T, I>)
+{
+    if constexpr (is_trivially_relocatable<T>) {
+        std::size_t count = last - first;
+        detail::memmove_slots(d_last - count, first, count);
+        return d_last - count;
+    }
+    else {
+        while (first != last) {
+            relocate_at(--last, --d_last);
+        }
+        return d_last;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I>
+// optional_v2<T, I>* compact(optional_v2<T, I>* first, optional_v2<T, I>* last);
+//
+//  Relocates the slots in [first, last) that are not tombstoned to the front
+//  of the range, keeping their order.  Returns the new end.  Every slot in
+//  [new end, last) is left as a tombstoned husk.
+template <typename T, typename I>
+optional_v2<T, I>* compact(optional_v2<T, I>* first, optional_v2<T, I>* last)
+    noexcept(detail::is_nothrow_relocatable<T, I>)
+{
+    using slot = optional_v2<T, I>;
+    slot* dest = first;
+    for (; first != last; ++first) {
+        if (first->has_value()) {
+            if (dest != first) {
+                detail::drop_husk(dest);
+                relocate_at(first, dest);
+                new (first) slot(tombstone_tag{});
+            }
+            ++dest;
+        }
+    }
+    return dest;
+}
+
+//-----------------------------------------------------------------------------
+// template <typename T, typename I>
+// optional_v2<T, I>* destroy_n(optional_v2<T, I>* first, std::size_t count);
+//
+// template <typename T, typename I>
+// void destroy_range(optional_v2<T, I>* first, optional_v2<T, I>* last);
+//
+//  Same as std::destroy_n() and std::destroy(), but each block of slots is
+//  first classified as live, a husk with destructive_move_exempt members to
+//  destruct, or dead (a husk with nothing to destruct).  The live slots and
+//  then the husks are destructed in separate passes that call T's destructor
+//  or the destructive_move_exempt members' destructors directly, without
+//  reading the tombstone again, and dead slots aren't touched again.  While
+//  a block is classified, the next one is prefetched.  Nothing
+//  is done at all if neither T nor its husk has anything to destruct.
+//  destroy_n() returns first + count.
+template <typename T, typename I>
+optional_v2<T, I>* destroy_n(optional_v2<T, I>* first, std::size_t count) noexcept
+{
+    using slot = optional_v2<T, I>;
+    if constexpr (!std::is_trivially_destructible_v<slot>
+        && !(std::is_trivially_destructible_v<T> && slot::has_nothing_to_destruct_after_move))
+    {
+        std::uint16_t live [detail::destroy_block];
+        std::uint16_t husks[detail::destroy_block];
+        for (std::size_t done = 0; done < count; done += detail::destroy_block) {
+            slot*       base       = first + done;
+            std::size_t size       = std::min(detail::destroy_block, count - done);
+            std::size_t next_size  = std::min(detail::destroy_block, count - done - size);
+            std::size_t live_count = 0;
+            std::size_t husk_count = 0;
+            for (std::size_t i = 0; i != size; ++i) {
+                // The next block is fetched while this one is classified and
+                // destructed, so its tombstones are in cache when it is
+                // classified.
+                if (i < next_size) {
+                    detail::prefetch(base + detail::destroy_block + i);
+                }
+                if (base[i].has_value()) {
+                    live[live_count++] = std::uint16_t(i);
+                }
+                else if constexpr (!slot::has_nothing_to_destruct_after_move) {
+                    husks[husk_count++] = std::uint16_t(i);
+                }
+                else {
+                    detail::trace<T>(trace_event::elided_destruction, base + i);
+                }
+            }
+            detail::destroy_indexed<true >(base, live , live_count);
+            detail::destroy_indexed<false>(base, husks, husk_count);
+        }
+    }
+    return first + count;
+}
+
+template <typename T, typename I>
+void destroy_range(optional_v2<T, I>* first, optional_v2<T, I>* last) noexcept
+{
+    destroy_n(first, std::size_t(last - first));
+}
+
+} // namespace afh
+#endif // #ifndef AFH_RELOCATE_HPP__
@@ -0,0 +1,302 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_SPSC_RING_HPP__
+#define AFH_SPSC_RING_HPP__
+
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace afh {
+
+//=============================================================================
+// template <typename T>
+// class spsc_ring;
+//
+//  A lock-free bounded queue for one producer thread and one consumer thread,
+//  whose slots are optional_v2<T>.  Pushing constructs the value straight
+//  into a slot.  Popping moves the value out and drops the husk left in the
+//  slot on the floor (no destructor call other than for
+//  destructive_move_exempt members).
+//
+//  The producer and consumer indices are on separate cache lines, and each
+//  side keeps a cached copy of the other's index, so it only reads the shared
+//  one when the cached one says the ring is full (or empty).  The batch
+//  functions re-read it when the cached one has less room (or fewer items)
+//  than asked for, and publish their index, once per batch.
+//
+////
+// Members
+////
+//  explicit spsc_ring(size_type capacity);
+//
+//   capacity is rounded up to a power of 2 (at least 2).
+//
+//  template <typename...Ts>
+//  bool try_emplace(Ts&&...args);
+//
+//   Producer.  Constructs an optional_v2<T> from args (so an
+//   afh::emplace<T>(...) object works too) in the next slot.  Returns false,
+//   without constructing anything, if the ring is full.
+//
+//  bool try_relocate(optional_v2<T>* source);
+//
+//   Producer.  Relocates the slot at source into the next slot with
+//   relocate_at(), so source is left as uninitialised memory.  Returns false,
+//   leaving source alone, if the ring is full.
+//
+//  template <typename It>
+//  It try_push_n(It first, It last);
+//
+//   Producer.  Constructs an element from each *it in turn for as many as fit
+//   and returns the first one not pushed.
+//
+//  optional_v2<T> try_pop();
+//
+//   Consumer.  Moves the oldest value out.  Returns a tombstoned optional_v2
+//   if the ring is empty.
+//
+//  template <typename Fn>
+//  size_type consume_n(Fn&& fn, size_type max);
+//
+//   Consumer.  Calls fn(T&&) for up to max of the oldest values, each moved
+//   out of its slot first, and returns how many were consumed.  Tombstones
+//   that were pushed are consumed without calling fn.
+//
+//  size_type discard_n(size_type max) noexcept;
+//
+//   Consumer.  Destroys up to max of the oldest values in place with
+//   destroy_n(), without moving them out, and returns how many were
+//   discarded.
+//
+//  size_type size() const noexcept;
+//
+//   Approximate unless called by the producer or consumer with the other
+//   side idle.
+template <typename T>
+class spsc_ring
+{
+public:
+    using value_type = optional_v2<T>;
+    using contained  = T;
+    using size_type  = std::size_t;
+
+    explicit spsc_ring(size_type capacity)
+        : m_mask(round_up(capacity) - 1)
+        , m_slots(static_cast<value_type*>(::operator new((m_mask + 1) * sizeof(value_type), std::align_val_t(alignof(value_type)))))
+    {}
+
+    spsc_ring(spsc_ring const&) = delete;
+    spsc_ring& operator=(spsc_ring const&) = delete;
+
+    ~spsc_ring()
+    {
+        size_type head = m_consumer.m_head.load(std::memory_order_relaxed);
+        size_type tail = m_producer.m_tail.load(std::memory_order_relaxed);
+        for (; head != tail; ++head) {
+            std::destroy_at(slot(head));
+        }
+        ::operator delete(m_slots, std::align_val_t(alignof(value_type)));
+    }
+
+    size_type capacity() const noexcept { return m_mask + 1; }
+
+    size_type size() const noexcept
+    {
+        return m_producer.m_tail.load(std::memory_order_acquire) - m_consumer.m_head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const noexcept { return size() == 0; }
+
+    template <typename...Ts>
+    bool try_emplace(Ts&&...args)
+    {
+        size_type tail = m_producer.m_tail.load(std::memory_order_relaxed);
+        if (free_slots(tail) == 0) {
+            return false;
+        }
+        new (slot(tail)) value_type(std::forward<Ts>(args)...);
+        m_producer.m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_relocate(value_type* source) noexcept(noexcept(relocate_at(source, source)))
+    {
+        size_type tail = m_producer.m_tail.load(std::memory_order_relaxed);
+        if (free_slots(tail) == 0) {
+            return false;
+        }
+        relocate_at(source, slot(tail));
+        m_producer.m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename It>
+    It try_push_n(It first, It last)
+    {
+        size_type tail  = m_producer.m_tail.load(std::memory_order_relaxed);
+        size_type start = tail;
+        size_type room  = free_slots(tail, wanted(first, last));
+        // Publish what was pushed, even if a constructor throws.
+        struct publish {
+            std::atomic<size_type>& index; size_type& tail; size_type start;
+            ~publish() { if (tail != start) index.store(tail, std::memory_order_release); }
+        } guard{ m_producer.m_tail, tail, start };
+        for (; first != last && room != 0; ++first, --room) {
+            new (slot(tail)) value_type(*first);
+            ++tail;
+        }
+        return first;
+    }
+
+    value_type try_pop() noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        size_type head = m_consumer.m_head.load(std::memory_order_relaxed);
+        if (used_slots(head) == 0) {
+            return value_type(tombstone_tag{});
+        }
+        return take(head);
+    }
+
+    template <typename Fn>
+    size_type consume_n(Fn&& fn, size_type max)
+    {
+        size_type head  = m_consumer.m_head.load(std::memory_order_relaxed);
+        size_type start = head;
+        size_type count = std::min(max, used_slots(head, max));
+        // Publish what was consumed, even if fn throws.
+        struct publish {
+            std::atomic<size_type>& index; size_type& head; size_type start;
+            ~publish() { if (head != start) index.store(head, std::memory_order_release); }
+        } guard{ m_consumer.m_head, head, start };
+        for (size_type end = head + count; head != end; ) {
+            value_type* from = slot(head);
+            ++head;
+            if (!from->has_value()) {
+                detail::drop_husk(from);
+                continue;
+            }
+            T value(std::move(*from).value());
+            from->has_been_moved();
+            detail::drop_husk(from);
+            fn(std::move(value));
+        }
+        return count;
+    }
+
+    size_type discard_n(size_type max) noexcept
+    {
+        size_type head  = m_consumer.m_head.load(std::memory_order_relaxed);
+        size_type count = std::min(max, used_slots(head, max));
+        if (count != 0) {
+            // The slots may wrap around the end of the buffer.
+            size_type first = head & m_mask;
+            size_type run   = std::min(count, capacity() - first);
+            ::afh::destroy_n(m_slots + first, run);
+            ::afh::destroy_n(m_slots, count - run);
+            m_consumer.m_head.store(head + count, std::memory_order_release);
+        }
+        return count;
+    }
+
+private:
+    static constexpr size_type cache_line = 64;
+
+    static size_type round_up(size_type capacity) noexcept
+    {
+        size_type result = 2;
+        while (result < capacity) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    value_type* slot(size_type index) const noexcept
+    {
+        return m_slots + (index & m_mask);
+    }
+
+    // How many slots try_push_n() would like.  An input range can only be
+    // walked once, so it could want all of them.
+    template <typename It>
+    size_type wanted(It first, It last) const
+    {
+        using category = typename std::iterator_traits<It>::iterator_category;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+            return size_type(std::distance(first, last));
+        }
+        else {
+            return capacity();
+        }
+    }
+
+    // Producer side.  The consumer's index is only re-read when the cached
+    // one doesn't leave room for wanted slots, so a batch costs at most one
+    // acquire.
+    size_type free_slots(size_type tail, size_type wanted = 1) noexcept
+    {
+        size_type room = capacity() - (tail - m_producer.m_cached_head);
+        if (room < wanted) {
+            m_producer.m_cached_head = m_consumer.m_head.load(std::memory_order_acquire);
+            room = capacity() - (tail - m_producer.m_cached_head);
+        }
+        return room;
+    }
+
+    // Consumer side.  The only return is of result, so it is constructed in
+    // place.
+    value_type take(size_type head) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        value_type* from   = slot(head);
+        value_type  result = from->has_value() ? value_type(std::move(*from)) : value_type(tombstone_tag{});
+        detail::drop_husk(from);
+        m_consumer.m_head.store(head + 1, std::memory_order_release);
+        return result;
+    }
+
+    // Consumer side.  Same as free_slots(), but for the producer's index.
+    size_type used_slots(size_type head, size_type wanted = 1) noexcept
+    {
+        size_type used = m_consumer.m_cached_tail - head;
+        if (used < wanted) {
+            m_consumer.m_cached_tail = m_producer.m_tail.load(std::memory_order_acquire);
+            used = m_consumer.m_cached_tail - head;
+        }
+        return used;
+    }
+
+    struct alignas(cache_line) producer_state {
+        std::atomic<size_type> m_tail{ 0 };
+        size_type              m_cached_head = 0;
+    };
+
+    struct alignas(cache_line) consumer_state {
+        std::atomic<size_type> m_head{ 0 };
+        size_type              m_cached_tail = 0;
+    };
+
+    size_type const   m_mask;
+    value_type* const m_slots;
+    producer_state    m_producer;
+    consumer_state    m_consumer;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_SPSC_RING_HPP__
@@ -0,0 +1,100 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_TRACE_HPP__
+#define AFH_TRACE_HPP__
+
+#include "utility.hpp"
+
+namespace afh {
+
+//=============================================================================
+// enum class trace_event;
+//
+//  The lifecycle events that an optional_v2<T> reports to its Trace_policy.
+//
+//   construct           The optional_v2 was constructed, either with a value
+//                       (after the emplace event) or tombstoned.
+//   emplace             A Contained object was constructed in it.
+//   move_out            Its value was moved out by the library, or
+//                       has_been_moved() was called.
+//   tombstone           The tombstone was set (after construct with a
+//                       tombstone_tag, reset or move_out).
+//   reset               reset() destructed its value.
+//   elided_destruction  It was destructed or dropped while tombstoned, so the
+//                       Contained destructor wasn't called.
+enum class trace_event : unsigned char
+{
+    construct,
+    emplace,
+    move_out,
+    tombstone,
+    reset,
+    elided_destruction,
+};
+
+constexpr char const* trace_event_name(trace_event event) noexcept
+{
+    switch (event) {
+    case trace_event::construct:          return "construct";
+    case trace_event::emplace:            return "emplace";
+    case trace_event::move_out:           return "move_out";
+    case trace_event::tombstone:          return "tombstone";
+    case trace_event::reset:              return "reset";
+    case trace_event::elided_destruction: return "elided_destruction";
+    }
+    return "unknown";
+}
+
+//=============================================================================
+// struct no_trace;
+//
+//  The default Trace_policy.  optional_v2 doesn't even call it, so tracing
+//  costs nothing unless a policy is chosen.
+//
+//  A Trace_policy is a type with this static member function:
+//
+//    static void trace(trace_event event, void const volatile* object, char const* type) noexcept;
+//
+//  object is the address of the optional_v2 and type is a string naming
+//  Contained, which stays valid for the life of the programme.  It is called
+//  on the thread doing the operation.
+struct no_trace
+{
+    static constexpr void trace(trace_event, void const volatile*, char const*) noexcept {}
+};
+
+//-----------------------------------------------------------------------------
+// AFH_OPTIONAL_V2_TRACE_POLICY
+//
+//  The Trace_policy used by types that don't specify one.  Define it before
+//  including destructively_movable.hpp to trace every optional_v2, e.g.:
+//
+//    #include "trace_ring.hpp"
+//    #define AFH_OPTIONAL_V2_TRACE_POLICY ::afh::trace_ring<>
+//    #include "destructively_movable.hpp"
+#ifndef AFH_OPTIONAL_V2_TRACE_POLICY
+# define AFH_OPTIONAL_V2_TRACE_POLICY ::afh::no_trace
+#endif
+
+namespace detail {
+    // A name for T that lives as long as the programme.
+    template <typename T>
+    char const* trace_type_name() noexcept
+    {
+        return AFH___FUNCSIG;
+    }
+}
+
+} // namespace afh
+#endif // #ifndef AFH_TRACE_HPP__
@@ -0,0 +1,167 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_TRACE_RING_HPP__
+#define AFH_TRACE_RING_HPP__
+
+#include "trace.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace afh {
+
+//=============================================================================
+// struct trace_record;
+//
+//  One traced event.  ticks is std::chrono::steady_clock's count, so records
+//  from different threads can be merged.
+struct trace_record
+{
+    std::uint64_t         ticks;
+    void const volatile*  object;
+    char const*           type;
+    trace_event           event;
+};
+
+//=============================================================================
+// template <std::size_t Capacity = 4096>
+// class trace_ring;
+//
+//  A Trace_policy that records events into a ring buffer of Capacity
+//  trace_records per thread, keeping the latest ones.  Recording doesn't lock
+//  or touch memory shared with other threads.  Only a thread's first event
+//  takes a lock, to register its buffer.  Buffers outlive their threads, so
+//  they can be read after a run.
+//
+////
+// Members
+////
+//  static void trace(trace_event event, void const volatile* object, char const* type) noexcept;
+//
+//   Records an event.  Called by optional_v2.
+//
+//  static std::vector<std::vector<trace_record>> snapshot();
+//
+//   Copies the records of each thread that has traced, oldest first.
+//
+//  static void dump(std::ostream& out);
+//
+//   Writes the records as text, one per line.
+//
+//  static void clear() noexcept;
+//
+//   Forgets all records.
+//
+//  NOTE: snapshot(), dump() and clear() must not run while other threads
+//        are tracing.
+template <std::size_t Capacity = 4096>
+class trace_ring
+{
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2.");
+
+    struct buffer {
+        std::atomic<std::uint64_t> m_count{ 0 };
+        trace_record               m_records[Capacity];
+    };
+
+    struct registry {
+        std::mutex                           m_mutex;
+        std::vector<std::unique_ptr<buffer>> m_buffers;
+    };
+
+    static registry& buffers() noexcept
+    {
+        static registry instance;
+        return instance;
+    }
+
+    static buffer* local() noexcept
+    {
+        thread_local buffer* mine = nullptr;
+        if (!mine) {
+            registry& r = buffers();
+            std::lock_guard<std::mutex> lock(r.m_mutex);
+            try {
+                r.m_buffers.reserve(r.m_buffers.size() + 1);
+                r.m_buffers.push_back(std::make_unique<buffer>());
+            }
+            catch (...) {
+                return nullptr; // events are lost rather than thrown
+            }
+            mine = r.m_buffers.back().get();
+        }
+        return mine;
+    }
+
+public:
+    static constexpr std::size_t capacity = Capacity;
+
+    static void trace(trace_event event, void const volatile* object, char const* type) noexcept
+    {
+        buffer* b = local();
+        if (!b) {
+            return;
+        }
+        std::uint64_t count = b->m_count.load(std::memory_order_relaxed);
+        b->m_records[count & (Capacity - 1)] = trace_record{
+            std::uint64_t(std::chrono::steady_clock::now().time_since_epoch().count()), object, type, event
+        };
+        b->m_count.store(count + 1, std::memory_order_release);
+    }
+
+    static std::vector<std::vector<trace_record>> snapshot()
+    {
+        registry& r = buffers();
+        std::lock_guard<std::mutex> lock(r.m_mutex);
+        std::vector<std::vector<trace_record>> result;
+        for (auto const& b : r.m_buffers) {
+            std::uint64_t count = b->m_count.load(std::memory_order_acquire);
+            std::uint64_t first = count > Capacity ? count - Capacity : 0;
+            auto& records = result.emplace_back();
+            records.reserve(std::size_t(count - first));
+            for (std::uint64_t i = first; i != count; ++i) {
+                records.push_back(b->m_records[i & (Capacity - 1)]);
+            }
+        }
+        return result;
+    }
+
+    static void dump(std::ostream& out)
+    {
+        auto threads = snapshot();
+        for (std::size_t thread = 0; thread < threads.size(); ++thread) {
+            for (trace_record const& record : threads[thread]) {
+                out << thread << ' ' << record.ticks << ' ' << trace_event_name(record.event)
+                    << ' ' << const_cast<void const*>(record.object) << ' ' << record.type << '\n';
+            }
+        }
+    }
+
+    static void clear() noexcept
+    {
+        registry& r = buffers();
+        std::lock_guard<std::mutex> lock(r.m_mutex);
+        for (auto const& b : r.m_buffers) {
+            b->m_count.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+} // namespace afh
+#endif // #ifndef AFH_TRACE_RING_HPP__
@@ -16,9 +16,10 @@
 
 #include <utility>
 #include <type_traits>
+#include <cstddef>
+#include <new>
 #include <tuple>
 #include <cwchar>
-#include <iostream>
 
 #ifdef _MSC_VER
 # define AFH___FUNCSIG __FUNCSIG__
@@ -43,10 +44,6 @@
 // Generate an error to see what the type is.
 #define AFH___INTEROGATE_TYPE_T(...) AFH___INTEROGATE_TYPE_(AFH___MAKE_UNIQUE(interrogated_type_),          __VA_ARGS__ )
 
-// Debugging output macros
-#define AFH___OUTPUT_FUNC      (std::cout << __FILE__ << "(" << __LINE__ << "): "                << " " << AFH___FUNCSIG << "\n")
-#define AFH___OUTPUT_THIS_FUNC (std::cout << __FILE__ << "(" << __LINE__ << "): " << (void*)this << " " << AFH___FUNCSIG << "\n")
-
 namespace afh {
 //=============================================================================
 // template <typename...>
@@ -283,7 +280,7 @@ using member_type_t = typename member_type<T>::type;
 
 // Helper macro
 #define AFH___GET_P(p, c, m) \
-    (reinterpret_cast<char*>(p) + offset(c, m))
+    (reinterpret_cast<char*>(p) + offsetof(c, m))
 
 // Sets value from within an uninitialised memory area [p, p+1), as if c were
 // to have been constructed at p, with the member c::m set to the value v.
@@ -295,7 +292,7 @@ using member_type_t = typename member_type<T>::type;
 //       initialised, as it will get overwritten when an actual object of type
 //       c is instantiated.
 #define AFH___SET(p, c, m, v) \
-    (*new (AFH___GET_P(p, c, m)) member_type<decltype(&c::m)>(v))
+    (*new (AFH___GET_P(p, c, m)) ::afh::member_type_t<decltype(&c::m)>(v))
 
 // Gets value from within partially initialised memory area [p, p+1), as if c
 // were to have been constructed at p, returns the value of member c::m.  C++
@@ -304,7 +301,7 @@ using member_type_t = typename member_type<T>::type;
 //
 // NOTE: See restrictions in AFH___SET() macro.
 #define AFH___GET(p, c, m) \
-    (*std::launder(reinterpret_cast<member_type<decltype(&c::m)>*>(AFH___GET_P(p, c, m))))
+    (*std::launder(reinterpret_cast<::afh::member_type_t<decltype(&c::m)>*>(AFH___GET_P(p, c, m))))
 
 } // namespace afh
 #endif // #ifndef AFH___UTILITY_HPP
\ No newline at end of file
@@ -0,0 +1,458 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_WORK_STEALING_POOL_HPP__
+#define AFH_WORK_STEALING_POOL_HPP__
+
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace afh {
+
+//=============================================================================
+// template <typename T>
+// class ws_deque;
+//
+//  A bounded Chase-Lev work stealing deque whose slots are optional_v2<T>.
+//  The owner thread pushes and pops at the bottom, and any thread can steal
+//  from the top.
+//
+//  A thief claims the top index before it touches the slot, and only then
+//  moves the value out and drops the husk.  Each slot has a sequence number
+//  that says which index may be pushed into it next, so the owner doesn't
+//  reuse a slot that a thief is still moving out of.
+//
+////
+// Members
+////
+//  explicit ws_deque(size_type capacity);
+//
+//   capacity is rounded up to a power of 2 (at least 2).
+//
+//  template <typename...Ts>
+//  bool try_push(Ts&&...args);
+//
+//   Owner.  Constructs an optional_v2<T> from args at the bottom.  Returns
+//   false, without constructing anything, if the deque is full.
+//
+//  optional_v2<T> try_pop();
+//
+//   Owner.  Moves the newest value out.  Returns a tombstoned optional_v2 if
+//   the deque is empty or a thief took the last value.
+//
+//  optional_v2<T> try_steal();
+//
+//   Any thread.  Moves the oldest value out.  Returns a tombstoned
+//   optional_v2 if the deque is empty or another thread got there first.
+//
+//  size_type size() const noexcept;
+//
+//   Approximate.
+template <typename T>
+class ws_deque
+{
+public:
+    using value_type = optional_v2<T>;
+    using contained  = T;
+    using size_type  = std::size_t;
+
+    explicit ws_deque(size_type capacity)
+        : m_mask(round_up(capacity) - 1)
+        , m_slots(new slot[m_mask + 1])
+    {
+        for (size_type i = 0; i <= m_mask; ++i) {
+            m_slots[i].m_seq.store(index(i), std::memory_order_relaxed);
+        }
+    }
+
+    ws_deque(ws_deque const&) = delete;
+    ws_deque& operator=(ws_deque const&) = delete;
+
+    ~ws_deque()
+    {
+        index bottom = m_bottom.load(std::memory_order_relaxed);
+        for (index top = m_top.load(std::memory_order_relaxed); top < bottom; ++top) {
+            std::destroy_at(at(top).value());
+        }
+    }
+
+    size_type capacity() const noexcept { return m_mask + 1; }
+
+    size_type size() const noexcept
+    {
+        index size = m_bottom.load(std::memory_order_acquire) - m_top.load(std::memory_order_acquire);
+        return size > 0 ? size_type(size) : 0;
+    }
+
+    template <typename...Ts>
+    bool try_push(Ts&&...args)
+    {
+        index bottom = m_bottom.load(std::memory_order_relaxed);
+        index top    = m_top.load(std::memory_order_acquire);
+        slot& s      = at(bottom);
+        if (bottom - top > index(m_mask) || s.m_seq.load(std::memory_order_acquire) != bottom) {
+            return false;
+        }
+        new (s.value()) value_type(std::forward<Ts>(args)...);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    value_type try_pop()
+    {
+        index bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        index top = m_top.load(std::memory_order_relaxed);
+        if (top < bottom) {
+            // The next push reuses this index.
+            return take(bottom, bottom);
+        }
+        if (top == bottom) {
+            // The last value, which a thief may be after too.
+            bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            if (won) {
+                return take(bottom, bottom + index(capacity()));
+            }
+        }
+        else {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return value_type(tombstone_tag{});
+    }
+
+    value_type try_steal()
+    {
+        index top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        index bottom = m_bottom.load(std::memory_order_acquire);
+        if (top < bottom
+            && m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return take(top, top + index(capacity()));
+        }
+        return value_type(tombstone_tag{});
+    }
+
+private:
+    using index = std::int64_t;
+
+    static constexpr size_type cache_line = 64;
+
+    struct slot {
+        std::atomic<index>                 m_seq;
+        alignas(value_type) unsigned char  m_storage[sizeof(value_type)];
+
+        value_type* value() noexcept { return std::launder(reinterpret_cast<value_type*>(m_storage)); }
+    };
+
+    static size_type round_up(size_type capacity) noexcept
+    {
+        size_type result = 2;
+        while (result < capacity) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    slot& at(index i) const noexcept
+    {
+        return m_slots[size_type(i) & m_mask];
+    }
+
+    // Moves the value at the claimed index i out, drops the husk and hands
+    // the slot over to the index next.
+    value_type take(index i, index next) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        slot&       s    = at(i);
+        value_type* from = s.value();
+        value_type  result = from->has_value() ? value_type(std::move(*from)) : value_type(tombstone_tag{});
+        detail::drop_husk(from);
+        s.m_seq.store(next, std::memory_order_release);
+        return result;
+    }
+
+    size_type const         m_mask;
+    std::unique_ptr<slot[]> m_slots;
+    alignas(cache_line) std::atomic<index> m_top{ 0 };
+    alignas(cache_line) std::atomic<index> m_bottom{ 0 };
+};
+
+//=============================================================================
+// template <typename Task = std::function<void()>>
+// class work_stealing_pool;
+//
+//  A thread pool where each worker has a ws_deque<Task>.  A worker runs the
+//  newest task in its own deque, then tasks submitted from outside the pool,
+//  then tasks stolen from the oldest end of other workers' deques, trying
+//  the victims in turn from a random one.  A task is moved out of its slot
+//  once, run where it lands and destructed right after, and the husk left in
+//  the slot is dropped without a destructor call.
+//
+//  Tasks are called as task(), and must not throw.
+//
+////
+// Members
+////
+//  explicit work_stealing_pool(
+//      size_type threads        = std::thread::hardware_concurrency(),
+//      size_type deque_capacity = 1024);
+//
+//   Starts threads workers (at least 1), each with a deque of at least
+//   deque_capacity tasks.  Tasks submitted from outside go through a shared
+//   queue of the same capacity.
+//
+//  ~work_stealing_pool();
+//
+//   Waits for all tasks to finish and joins the workers.
+//
+//  template <typename...Ts>
+//  void submit(Ts&&...args);
+//
+//   Constructs a task from args.  On a worker thread of this pool, it is
+//   pushed to the worker's own deque, or run straight away if that is full.
+//   Otherwise it is queued, waiting for room if the queue is full.
+//
+//  void wait_idle();
+//
+//   Waits until every task submitted so far, and every task they submitted,
+//   has finished.  Must not be called from a task.
+//
+//  size_type thread_count() const noexcept;
+template <typename Task = std::function<void()>>
+class work_stealing_pool
+{
+public:
+    using task_type  = Task;
+    using value_type = optional_v2<Task>;
+    using size_type  = std::size_t;
+
+    explicit work_stealing_pool(
+        size_type threads        = std::thread::hardware_concurrency(),
+        size_type deque_capacity = 1024)
+        : m_injected(deque_capacity)
+    {
+        threads = threads ? threads : 1;
+        m_workers.reserve(threads);
+        for (size_type i = 0; i < threads; ++i) {
+            m_workers.push_back(std::make_unique<worker>(this, deque_capacity, i));
+        }
+        try {
+            for (auto& w : m_workers) {
+                w->m_thread = std::thread([this, self = w.get()] { work(*self); });
+            }
+        }
+        catch (...) {
+            stop();
+            throw;
+        }
+    }
+
+    work_stealing_pool(work_stealing_pool const&) = delete;
+    work_stealing_pool& operator=(work_stealing_pool const&) = delete;
+
+    ~work_stealing_pool()
+    {
+        wait_idle();
+        stop();
+    }
+
+    size_type thread_count() const noexcept { return m_workers.size(); }
+
+    template <typename...Ts>
+    void submit(Ts&&...args)
+    {
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+        try {
+            worker* self = current();
+            if (self && self->m_pool == this) {
+                // try_push() doesn't touch args if it fails.
+                if (!self->m_deque.try_push(std::forward<Ts>(args)...)) {
+                    run(value_type(std::forward<Ts>(args)...));
+                    return;
+                }
+            }
+            else {
+                std::lock_guard<std::mutex> lock(m_submit_mutex);
+                while (!m_injected.try_emplace(std::forward<Ts>(args)...)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        catch (...) {
+            finished();
+            throw;
+        }
+        signal();
+    }
+
+    void wait_idle()
+    {
+        std::unique_lock<std::mutex> lock(m_idle_mutex);
+        m_idle.wait(lock, [this] { return m_pending.load(std::memory_order_acquire) == 0; });
+    }
+
+private:
+    struct alignas(64) worker {
+        worker(work_stealing_pool* pool, size_type deque_capacity, size_type i)
+            : m_pool(pool)
+            , m_deque(deque_capacity)
+            , m_rng(0x9E3779B97F4A7C15ull * (i + 1))
+        {}
+
+        work_stealing_pool* m_pool;
+        ws_deque<Task>      m_deque;
+        std::uint64_t       m_rng;
+        std::thread         m_thread;
+    };
+
+    static worker*& current() noexcept
+    {
+        static thread_local worker* mine = nullptr;
+        return mine;
+    }
+
+    static size_type next_random(worker& self) noexcept
+    {
+        // xorshift64
+        self.m_rng ^= self.m_rng << 13;
+        self.m_rng ^= self.m_rng >> 7;
+        self.m_rng ^= self.m_rng << 17;
+        return size_type(self.m_rng);
+    }
+
+    // Wakes a sleeping worker, if there is one, to look for the new task.
+    void signal()
+    {
+        m_signal.fetch_add(1, std::memory_order_seq_cst);
+        if (m_sleepers.load(std::memory_order_seq_cst) != 0) {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_wake.notify_one();
+        }
+    }
+
+    // Runs task, if it has one, and destructs it before counting it done.
+    bool run(value_type&& task) noexcept
+    {
+        if (!task.has_value()) {
+            return false;
+        }
+        task.value()();
+        task.reset();
+        finished();
+        return true;
+    }
+
+    void finished() noexcept
+    {
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(m_idle_mutex);
+            m_idle.notify_all();
+        }
+    }
+
+    value_type try_injected()
+    {
+        std::unique_lock<std::mutex> lock(m_inject_mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return value_type(tombstone_tag{});
+        }
+        return m_injected.try_pop();
+    }
+
+    bool run_one(worker& self) noexcept
+    {
+        if (run(self.m_deque.try_pop()) || run(try_injected())) {
+            return true;
+        }
+        size_type count = m_workers.size();
+        size_type start = next_random(self) % count;
+        for (size_type i = 0; i < count; ++i) {
+            worker& victim = *m_workers[(start + i) % count];
+            if (&victim != &self && run(victim.m_deque.try_steal())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(worker& self) noexcept
+    {
+        current() = &self;
+        for (;;) {
+            std::uint64_t seen = m_signal.load(std::memory_order_seq_cst);
+            if (run_one(self)) {
+                continue;
+            }
+            bool found = false;
+            for (int spin = 0; spin < 64 && !found; ++spin) {
+                std::this_thread::yield();
+                found = run_one(self);
+            }
+            if (found) {
+                continue;
+            }
+            // A submit() either sees the sleeper or changes m_signal first.
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+            m_wake.wait(lock, [&] { return m_stop || m_signal.load(std::memory_order_seq_cst) != seen; });
+            m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+            if (m_stop) {
+                return;
+            }
+        }
+    }
+
+    void stop() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto& w : m_workers) {
+            if (w->m_thread.joinable()) {
+                w->m_thread.join();
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<worker>> m_workers;
+    spsc_ring<Task>                      m_injected;     // producers hold m_submit_mutex, the consumer m_inject_mutex
+    std::mutex                           m_submit_mutex;
+    std::mutex                           m_inject_mutex;
+
+    alignas(64) std::atomic<size_type>     m_pending{ 0 };
+    alignas(64) std::atomic<std::uint64_t> m_signal{ 0 };
+    std::atomic<size_type>                 m_sleepers{ 0 };
+    std::mutex                             m_sleep_mutex;
+    std::condition_variable                m_wake;
+    bool                                   m_stop = false;
+    std::mutex                             m_idle_mutex;
+    std::condition_variable                m_idle;
+};
+
+} // namespace afh
+#endif // #ifndef AFH_WORK_STEALING_POOL_HPP__
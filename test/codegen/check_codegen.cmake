@@ -0,0 +1,94 @@
+# optional_v2 library
+#
+#  Copyright Adrian Hawryluk 2019.
+#
+#  Use, modification and distribution is subject to the
+#  MIT License. (See accompanying
+#  file LICENSE.txt or copy at
+#  https://opensource.org/licenses/MIT)
+#
+# Project home: https://github.com/Ma-XX-oN/destructive-move
+#
+# cmake -DOBJDUMP=<objdump> -DOBJECT=<probes object file> -P check_codegen.cmake
+#
+#  Disassembles the probes and, for every afh_<name> function, fails if it has
+#  more instructions, calls or stores than ref_<name>.  Padding between
+#  functions isn't counted.
+
+if(NOT OBJDUMP OR NOT OBJECT)
+    message(FATAL_ERROR "OBJDUMP and OBJECT must be set.")
+endif()
+
+execute_process(
+    COMMAND ${OBJDUMP} -d --no-show-raw-insn ${OBJECT}
+    OUTPUT_VARIABLE disassembly
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${OBJDUMP} failed on ${OBJECT}.")
+endif()
+
+string(REPLACE ";" "," disassembly "${disassembly}")
+string(REPLACE "\n" ";" lines "${disassembly}")
+
+set(function "")
+set(functions "")
+foreach(line IN LISTS lines)
+    if(line MATCHES "^[0-9a-f]+ <((afh|ref)_[A-Za-z0-9_]+)>:$")
+        set(function ${CMAKE_MATCH_1})
+        list(APPEND functions ${function})
+        set(${function}_instructions 0)
+        set(${function}_calls 0)
+        set(${function}_stores 0)
+        set(${function}_listing "")
+    elseif(line MATCHES "^[0-9a-f]+ <")
+        set(function "")
+    elseif(function AND line MATCHES "^ *[0-9a-f]+:\t(.*)$")
+        set(instruction "${CMAKE_MATCH_1}")
+        if(instruction MATCHES "^(nop|xchg +%ax,%ax|data16|cs nop|int3|hlt|ud2)")
+            continue()
+        endif()
+        math(EXPR ${function}_instructions "${${function}_instructions} + 1")
+        string(APPEND ${function}_listing "\n    ${instruction}")
+        # x86 (AT&T syntax) and AArch64.
+        if(instruction MATCHES "^(call|bl|blr)[a-z]* ")
+            math(EXPR ${function}_calls "${${function}_calls} + 1")
+        endif()
+        if(instruction MATCHES "^(push|st[a-z]*)[a-z]* "
+           OR (NOT instruction MATCHES "^(cmp|test|bt|ucomi|comi|j|call)"
+               AND instruction MATCHES ",[-0-9a-fx]*\\([^)]*\\)( *#.*)?$"))
+            math(EXPR ${function}_stores "${${function}_stores} + 1")
+        endif()
+    endif()
+endforeach()
+
+set(failures "")
+set(compared 0)
+foreach(function IN LISTS functions)
+    if(NOT function MATCHES "^afh_(.*)$")
+        continue()
+    endif()
+    set(name ${CMAKE_MATCH_1})
+    set(ref ref_${name})
+    if(NOT DEFINED ${ref}_instructions)
+        string(APPEND failures "${function} has no ${ref} to compare against.\n")
+        continue()
+    endif()
+    math(EXPR compared "${compared} + 1")
+    foreach(what instructions calls stores)
+        if(${function}_${what} GREATER ${ref}_${what})
+            string(APPEND failures
+                "${name}: ${${function}_${what}} ${what} vs ${${ref}_${what}} for the plain type.\n"
+                "  ${function}:${${function}_listing}\n"
+                "  ${ref}:${${ref}_listing}\n")
+            break()
+        endif()
+    endforeach()
+    message(STATUS "${name}: ${${function}_instructions} instructions, ${${function}_calls} calls, ${${function}_stores} stores (plain type: ${${ref}_instructions}, ${${ref}_calls}, ${${ref}_stores})")
+endforeach()
+
+if(compared EQUAL 0)
+    message(FATAL_ERROR "No afh_* probes found in ${OBJECT}.")
+endif()
+if(failures)
+    message(FATAL_ERROR "optional_v2 added instructions to the hot path:\n${failures}")
+endif()
@@ -0,0 +1,104 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Probe functions for the codegen test.  Each afh_<name> function does with
+// an afh::optional_v2<T> what ref_<name> does with a plain T, and
+// check_codegen.cmake fails if the optimised afh_<name> has more
+// instructions, calls or stores than ref_<name>.
+#include "destructively_movable.hpp"
+#include "destructively_movable_std.hpp"
+#include "relocate.hpp"
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace {
+    // A type with an internal tombstone: the pointer is null once moved
+    // from, and never null when live.
+    struct handle {
+        int* m_p;
+
+        explicit handle(int* p) noexcept : m_p(p) {}
+        handle(handle&& other) noexcept : m_p(std::exchange(other.m_p, nullptr)) {}
+        handle& operator=(handle&& other) noexcept { std::swap(m_p, other.m_p); return *this; }
+        ~handle() { delete m_p; }
+
+        using Tombstone_functions = afh::tombstone_via_member<&handle::m_p>;
+    };
+
+    static_assert(sizeof(afh::optional_v2<handle>) == sizeof(handle));
+}
+
+#define AFH___PROBE extern "C" __attribute__((noinline))
+
+//=============================================================================
+// Trivially destructible, so no tombstone at all.
+
+AFH___PROBE void ref_construct_int(void* where, int i) { new (where) int(i); }
+AFH___PROBE void afh_construct_int(void* where, int i) { new (where) afh::optional_v2<int>(afh::emplace<int>(i)); }
+
+AFH___PROBE int ref_move_int(int* from) { int to(std::move(*from)); return to; }
+AFH___PROBE int afh_move_int(afh::optional_v2<int>* from) { afh::optional_v2<int> to(std::move(*from)); return to.value(); }
+
+AFH___PROBE void ref_assign_int(int* to, int* from) { *to = std::move(*from); }
+AFH___PROBE void afh_assign_int(afh::optional_v2<int>* to, afh::optional_v2<int>* from) { *to = std::move(*from); }
+
+AFH___PROBE void ref_destroy_int(int* p) { std::destroy_at(p); }
+AFH___PROBE void afh_destroy_int(afh::optional_v2<int>* p) { std::destroy_at(p); }
+
+// has_been_moved() is free when there is nothing to mark.
+AFH___PROBE void ref_has_been_moved_int(int*) {}
+AFH___PROBE void afh_has_been_moved_int(afh::optional_v2<int>* p) { p->has_been_moved(); }
+
+//=============================================================================
+// Internal tombstones.  Relocating a live object moves it and then destructs
+// (or drops) the source.  afh::relocate_at() also has to handle a tombstoned
+// source, so it is only compared for a trivially relocatable type.
+
+AFH___PROBE void ref_relocate_handle(handle* from, handle* to)
+{
+    new (to) handle(std::move(*from));
+    std::destroy_at(from);
+}
+AFH___PROBE void afh_relocate_handle(afh::optional_v2<handle>* from, afh::optional_v2<handle>* to)
+{
+    new (to) afh::optional_v2<handle>(afh::emplace<handle>(std::move(*from).value()));
+    from->has_been_moved();
+    std::destroy_at(from);
+}
+
+AFH___PROBE void ref_relocate_unique_ptr(std::unique_ptr<int>* from, std::unique_ptr<int>* to)
+{
+    new (to) std::unique_ptr<int>(std::move(*from));
+    std::destroy_at(from);
+}
+AFH___PROBE void afh_relocate_unique_ptr(afh::optional_v2<std::unique_ptr<int>>* from, afh::optional_v2<std::unique_ptr<int>>* to)
+{
+    afh::relocate_at(from, to);
+}
+
+// Moving the value out and marking the husk costs no more than moving out of
+// a T and destructing it.
+AFH___PROBE int* ref_take_handle(handle* from)
+{
+    handle taken(std::move(*from));
+    std::destroy_at(from);
+    return std::exchange(taken.m_p, nullptr);
+}
+AFH___PROBE int* afh_take_handle(afh::optional_v2<handle>* from)
+{
+    handle taken(std::move(*from).value());
+    from->has_been_moved();
+    std::destroy_at(from);
+    return std::exchange(taken.m_p, nullptr);
+}
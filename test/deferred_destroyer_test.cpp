@@ -0,0 +1,101 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that deferred_destroyer relocates values out of their slots, that
+// a full queue pushes back, and that each deferred value is destructed
+// exactly once, by drain(), the background thread or the destructor.
+#include "deferred_destroyer.hpp"
+#include "test_types.hpp"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <utility>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+    using afh::test::moves;
+
+    // Deferring one is a memcpy, so its move constructor isn't called.
+    struct relocatable : owner {
+        static constexpr bool is_trivially_relocatable = true;
+    };
+
+    template <typename T>
+    using slot = afh::optional_v2<T>;
+}
+
+int main()
+{
+    {
+        afh::deferred_destroyer<owner> destroyer(4);
+        assert(destroyer.capacity() == 4);
+
+        slot<owner> slots[6] = {
+            afh::emplace<owner>(), afh::emplace<owner>(), afh::emplace<owner>(),
+            afh::emplace<owner>(), afh::emplace<owner>(), afh::emplace<owner>()
+        };
+        for (int i = 0; i != 4; ++i) {
+            assert(destroyer.try_defer(slots[i]));
+            assert(slots[i].is_tombstoned());
+        }
+        assert(destroyer.depth() == 4 && owners == 6);
+
+        // A full queue leaves the slot alone, or destroys it here.
+        assert(!destroyer.try_defer(slots[4]) && slots[4].has_value());
+        destroyer.defer(slots[4]);
+        assert(slots[4].is_tombstoned() && destroyer.overflowed() == 1 && owners == 5);
+
+        // A tombstoned slot has nothing to defer.
+        assert(destroyer.try_defer(slots[0]) && destroyer.depth() == 4);
+
+        // Values are destroyed where they are queued, not moved out first.
+        moves = 0;
+        assert(destroyer.drain(3) == 3 && destroyer.depth() == 1 && owners == 2);
+        assert(moves == 0);
+        destroyer.defer(slots[5]);
+        assert(destroyer.drain() == 2 && destroyer.depth() == 0 && owners == 0);
+
+        // The destructor destroys what is left.
+        slot<owner> last(afh::emplace<owner>());
+        destroyer.defer(last);
+        assert(owners == 1);
+    }
+    assert(owners == 0);
+
+    {
+        afh::deferred_destroyer<relocatable> destroyer(8);
+        slot<relocatable> value(afh::emplace<relocatable>());
+        moves = 0;
+        assert(destroyer.try_defer(value) && moves == 0);
+        assert(value.is_tombstoned() && owners == 1);
+        assert(destroyer.drain() == 1 && owners == 0);
+    }
+
+    // The background thread keeps up with a producer deferring faster than
+    // the queue can hold.
+    {
+        afh::deferred_destroyer<owner> destroyer(64, std::chrono::microseconds(50), 16);
+        for (int i = 0; i != 10000; ++i) {
+            slot<owner> value(afh::emplace<owner>());
+            destroyer.defer(value);
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (destroyer.depth() != 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        assert(destroyer.depth() == 0);
+    }
+    assert(owners == 0);
+}
@@ -0,0 +1,154 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that destroy_n() and destroy_range() run each live slot's
+// destructor exactly once, only destruct the destructive_move_exempt members
+// of husks, and leave husks with nothing to destruct alone, across several
+// classification blocks.
+#include "relocate.hpp"
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    // More than one block, and not a multiple of its size.
+    constexpr int count = 1000;
+
+    int destructed[count]; // whole object destructions, by id
+    int kept      [count]; // exempt member destructions, by id
+
+    void clear_counts()
+    {
+        std::fill_n(destructed, count, 0);
+        std::fill_n(kept      , count, 0);
+    }
+
+    struct keeper {
+        int m_id;
+
+        explicit keeper(int id) noexcept : m_id(id) {}
+        ~keeper() { ++kept[m_id]; }
+    };
+
+    // Its husk still has m_keep to destruct.
+    struct with_exempt {
+        int         m_id;
+        keeper      m_keep;
+        std::string m_text;
+
+        explicit with_exempt(int id) : m_id(id), m_keep(id), m_text(32, 'x') {}
+        with_exempt(with_exempt&&) = default;
+        ~with_exempt() { ++destructed[m_id]; }
+    };
+
+    // Its husk has nothing to destruct.
+    struct plain {
+        int         m_id;
+        std::string m_text;
+
+        explicit plain(int id) : m_id(id), m_text(32, 'x') {}
+        plain(plain&&) = default;
+        ~plain() { ++destructed[m_id]; }
+    };
+
+    // count uninitialised slots.
+    template <typename T>
+    struct table {
+        using slot = afh::optional_v2<T>;
+
+        table() : m_slots(static_cast<slot*>(::operator new(count * sizeof(slot), std::align_val_t(alignof(slot))))) {}
+        ~table() { ::operator delete(m_slots, std::align_val_t(alignof(slot))); }
+
+        slot* m_slots;
+    };
+
+    bool is_live(int i) { return i % 3 != 1 && i % 7 != 0; }
+}
+
+template <>
+struct afh::destructively_movable_traits<with_exempt>
+{
+    using Tombstone_functions = void;
+    static constexpr auto destructive_move_exempt = afh::destructive_move_exempt(&with_exempt::m_keep);
+};
+
+static_assert(!afh::optional_v2<with_exempt>::has_nothing_to_destruct_after_move);
+static_assert( afh::optional_v2<plain      >::has_nothing_to_destruct_after_move);
+
+int main()
+{
+    // Live slots and husks with exempt members.
+    {
+        clear_counts();
+        table<with_exempt> t;
+        std::vector<with_exempt> moved;
+        moved.reserve(count);
+        for (int i = 0; i != count; ++i) {
+            auto* s = new (t.m_slots + i) afh::optional_v2<with_exempt>(afh::emplace<with_exempt>(i));
+            if (!is_live(i)) {
+                moved.push_back(std::move(s->value()));
+                s->has_been_moved();
+            }
+        }
+        assert(afh::destroy_n(t.m_slots, count) == t.m_slots + count);
+        for (int i = 0; i != count; ++i) {
+            // A husk's m_keep is destructed, but not the rest of it.
+            assert(destructed[i] == (is_live(i) ? 1 : 0));
+            assert(kept[i] == 1);
+        }
+    }
+
+    // Live slots, husks left by has_been_moved() and reset() slots, none of
+    // which have anything left to destruct.
+    {
+        clear_counts();
+        table<plain> t;
+        std::vector<plain> moved;
+        moved.reserve(count);
+        for (int i = 0; i != count; ++i) {
+            auto* s = new (t.m_slots + i) afh::optional_v2<plain>(afh::emplace<plain>(i));
+            if (!is_live(i)) {
+                if (i % 2) {
+                    moved.push_back(std::move(s->value()));
+                    s->has_been_moved();
+                }
+                else {
+                    s->reset();
+                    assert(destructed[i] == 1);
+                    destructed[i] = 0;
+                }
+            }
+        }
+        afh::destroy_range(t.m_slots, t.m_slots + count);
+        for (int i = 0; i != count; ++i) {
+            assert(destructed[i] == (is_live(i) ? 1 : 0));
+        }
+    }
+
+    // A range that starts part way into the table.
+    {
+        clear_counts();
+        table<plain> t;
+        for (int i = 0; i != count; ++i) {
+            new (t.m_slots + i) afh::optional_v2<plain>(afh::emplace<plain>(i));
+        }
+        afh::destroy_n(t.m_slots + 300, count - 300);
+        afh::destroy_n(t.m_slots, 300);
+        for (int i = 0; i != count; ++i) {
+            assert(destructed[i] == 1);
+        }
+    }
+}
@@ -0,0 +1,428 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks the sorting and heap algorithms in dm_algorithm.hpp against their
+// std:: equivalents, at sizes around the insertion sort cutoff of 16, and
+// that a throwing comparator leaves the range full of the same values.
+// Checks that remove_if(), unique() and erase_if() keep the survivors in
+// order, hand the removed elements to sink, leave a tombstoned tail and
+// destruct every removed element exactly once.
+#include "dm_algorithm.hpp"
+#include "dm_vector.hpp"
+#include "test_types.hpp"
+#include <algorithm>
+#include <cassert>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+
+    std::mt19937 rng(12345);
+
+    template <typename T>
+    using slots = std::vector<afh::optional_v2<T>>;
+
+    template <typename T>
+    slots<T> to_slots(std::vector<T> const& values)
+    {
+        slots<T> result;
+        result.reserve(values.size());
+        for (auto& value : values) {
+            result.emplace_back(value);
+        }
+        return result;
+    }
+
+    template <typename T>
+    std::vector<T> to_values(slots<T> const& range)
+    {
+        std::vector<T> result;
+        for (auto& slot : range) {
+            assert(slot.has_value());
+            result.push_back(slot.value());
+        }
+        return result;
+    }
+
+    template <typename T>
+    auto* begin_of(slots<T>& range) { return range.data(); }
+    template <typename T>
+    auto* end_of  (slots<T>& range) { return range.data() + range.size(); }
+
+    // Keys with plenty of duplicates.  A string is long enough to be heap
+    // allocated, so that it isn't trivially relocatable.
+    int         make(int key, int) { return key; }
+    std::string make(int key, std::string) { return std::string(20, '0') + std::to_string(1000 + key); }
+
+    template <typename T>
+    std::vector<std::vector<T>> inputs(std::size_t size)
+    {
+        std::vector<T> random, sorted, equal;
+        std::uniform_int_distribution<int> key(0, int(size / 2));
+        for (std::size_t i = 0; i < size; ++i) {
+            random.push_back(make(key(rng), T()));
+            equal .push_back(make(7, T()));
+        }
+        sorted = random;
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<T> reversed(sorted.rbegin(), sorted.rend());
+        return { random, sorted, reversed, equal };
+    }
+
+    std::size_t const sizes[] = { 0, 1, 2, 3, 15, 16, 17, 18, 31, 32, 33, 100, 1000 };
+
+    template <typename T>
+    void check_sorts()
+    {
+        for (std::size_t size : sizes) {
+            for (auto& input : inputs<T>(size)) {
+                std::vector<T> expected = input;
+                std::sort(expected.begin(), expected.end());
+
+                auto range = to_slots(input);
+                afh::sort(begin_of(range), end_of(range));
+                assert(to_values(range) == expected);
+
+                range = to_slots(input);
+                afh::sort(begin_of(range), end_of(range), std::greater<T>());
+                assert(to_values(range) == std::vector<T>(expected.rbegin(), expected.rend()));
+
+                for (std::size_t nth = 0; nth < size; nth += 1 + size / 7) {
+                    range = to_slots(input);
+                    afh::nth_element(begin_of(range), begin_of(range) + nth, end_of(range));
+                    auto values = to_values(range);
+                    assert(values[nth] == expected[nth]);
+                    for (std::size_t i = 0; i < size; ++i) {
+                        assert(i < nth ? !(values[nth] < values[i]) : !(values[i] < values[nth]));
+                    }
+                }
+
+                range = to_slots(input);
+                afh::make_heap(begin_of(range), end_of(range));
+                auto heap = to_values(range);
+                assert(std::is_heap(heap.begin(), heap.end()));
+                for (std::size_t end = size; end > 0; --end) {
+                    afh::pop_heap(begin_of(range), begin_of(range) + end);
+                    assert(range[end - 1].value() == expected[end - 1]);
+                }
+                assert(to_values(range) == expected);
+
+                range.clear();
+                for (auto& value : input) {
+                    range.emplace_back(value);
+                    afh::push_heap(begin_of(range), end_of(range));
+                    heap = to_values(range);
+                    assert(std::is_heap(heap.begin(), heap.end()));
+                }
+                afh::sort_heap(begin_of(range), end_of(range));
+                assert(to_values(range) == expected);
+            }
+        }
+    }
+
+    // Sorts on the key only, so that the order of equal keys shows.
+    void check_stable_sort()
+    {
+        using item = std::pair<int, std::string>;
+        auto by_key = [](item const& a, item const& b) { return a.first < b.first; };
+        for (std::size_t size : sizes) {
+            std::vector<item> input;
+            std::uniform_int_distribution<int> key(0, int(size / 4));
+            for (std::size_t i = 0; i < size; ++i) {
+                input.emplace_back(key(rng), std::string(20, 'x') + std::to_string(i));
+            }
+            std::vector<item> expected = input;
+            std::stable_sort(expected.begin(), expected.end(), by_key);
+
+            auto range = to_slots(input);
+            afh::stable_sort(begin_of(range), end_of(range), by_key);
+            assert(to_values(range) == expected);
+        }
+    }
+
+    // Throws on its limit'th call.
+    struct throwing_less
+    {
+        int* calls;
+        int  limit;
+
+        bool operator()(std::string const& a, std::string const& b) const
+        {
+            if (++*calls == limit) {
+                throw std::runtime_error("comp");
+            }
+            return a < b;
+        }
+    };
+
+    template <typename Algorithm>
+    void check_throwing(Algorithm algorithm)
+    {
+        for (std::size_t size : { std::size_t(16), std::size_t(17), std::size_t(200) }) {
+            std::vector<std::string> input = inputs<std::string>(size)[0];
+            std::vector<std::string> sorted = input;
+            std::sort(sorted.begin(), sorted.end());
+            for (int limit = 1; limit < 400; limit += 7) {
+                auto range = to_slots(input);
+                int  calls = 0;
+                try {
+                    algorithm(begin_of(range), end_of(range), throwing_less{ &calls, limit });
+                }
+                catch (std::runtime_error const&) {
+                }
+                // Every slot still has a value, and they are the same values.
+                auto values = to_values(range);
+                std::sort(values.begin(), values.end());
+                assert(values == sorted);
+            }
+        }
+    }
+
+    // ids 0 to count - 1, with the slots of the ids in tombstoned moved out.
+    slots<owner> owner_slots(int count, std::vector<int> const& tombstoned)
+    {
+        slots<owner> range;
+        range.reserve(std::size_t(count));
+        for (int id = 0; id < count; ++id) {
+            range.emplace_back(afh::emplace<owner>(id));
+        }
+        for (int id : tombstoned) {
+            owner taken(std::move(range[std::size_t(id)]).value());
+            range[std::size_t(id)].has_been_moved();
+        }
+        return range;
+    }
+
+    template <typename Slot>
+    std::vector<int> ids(Slot const* first, Slot const* last)
+    {
+        std::vector<int> result;
+        for (; first != last; ++first) {
+            assert(first->has_value());
+            result.push_back(first->value().m_id);
+        }
+        return result;
+    }
+
+    template <typename Slot>
+    bool tombstoned(Slot const* first, Slot const* last)
+    {
+        return std::all_of(first, last, [](Slot const& slot) { return slot.is_tombstoned(); });
+    }
+
+    // Keeps what it is given, so it shows what was removed and in what order.
+    struct collecting_sink
+    {
+        std::vector<owner>* removed;
+        void operator()(owner&& value) const { removed->push_back(std::move(value)); }
+    };
+
+    // Neither moves from nor keeps what it is given.
+    struct ignoring_sink
+    {
+        int* calls;
+        void operator()(owner&&) const { ++*calls; }
+    };
+
+    // Throws on its limit'th call.
+    struct throwing_sink
+    {
+        int* calls;
+        int  limit;
+        void operator()(owner&&) const
+        {
+            if (++*calls == limit) {
+                throw std::runtime_error("sink");
+            }
+        }
+    };
+
+    std::vector<int> ids(std::vector<owner> const& values)
+    {
+        std::vector<int> result;
+        for (auto& value : values) {
+            result.push_back(value.m_id);
+        }
+        return result;
+    }
+
+    // Removes multiples of 3 from ids 0 to 39, where 8 and 13 (which are kept)
+    // and 9 (which is removed) are already tombstoned.
+    void check_remove_if()
+    {
+        std::vector<int> const tombstones = { 8, 9, 13 };
+        auto removed_id = [](owner const& value) { return value.m_id % 3 == 0; };
+        std::vector<int> kept, sunk;
+        for (int id = 0; id < 40; ++id) {
+            if (std::find(tombstones.begin(), tombstones.end(), id) != tombstones.end()) {
+                continue;
+            }
+            (removed_id(owner(id)) ? sunk : kept).push_back(id);
+        }
+        assert(owners == 0);
+        {
+            auto range   = owner_slots(40, tombstones);
+            auto new_end = afh::remove_if(begin_of(range), end_of(range), removed_id);
+            assert(ids(begin_of(range), new_end) == kept);
+            assert(tombstoned(new_end, end_of(range)));
+            assert(owners == long(kept.size()));
+        }
+        assert(owners == 0);
+        {
+            std::vector<owner> removed;
+            auto range   = owner_slots(40, tombstones);
+            auto new_end = afh::remove_if(begin_of(range), end_of(range), removed_id, collecting_sink{ &removed });
+            assert(ids(begin_of(range), new_end) == kept);
+            assert(tombstoned(new_end, end_of(range)));
+            assert(ids(removed) == sunk);
+            assert(owners == long(kept.size() + sunk.size()));
+        }
+        assert(owners == 0);
+        {
+            // What a sink doesn't take is still destructed.
+            int  calls   = 0;
+            auto range   = owner_slots(40, tombstones);
+            auto new_end = afh::remove_if(begin_of(range), end_of(range), removed_id, ignoring_sink{ &calls });
+            assert(ids(begin_of(range), new_end) == kept);
+            assert(calls == int(sunk.size()));
+            assert(owners == long(kept.size()));
+        }
+        assert(owners == 0);
+        for (int limit = 1; limit <= int(sunk.size()); ++limit) {
+            // Every slot is still valid, and only what was handed to sink is
+            // gone.
+            int  calls = 0;
+            auto range = owner_slots(40, tombstones);
+            try {
+                afh::remove_if(begin_of(range), end_of(range), removed_id, throwing_sink{ &calls, limit });
+                assert(false);
+            }
+            catch (std::runtime_error const&) {
+            }
+            long values = 0;
+            for (auto& slot : range) {
+                assert(slot.has_value() || slot.is_tombstoned());
+                values += slot.has_value();
+            }
+            assert(values == long(kept.size() + sunk.size()) - limit);
+            assert(owners == values);
+        }
+        assert(owners == 0);
+    }
+
+    // Keeps the first of each run of ids with the same id / 4 from ids 0 to
+    // 39, where 8 (so 9 is kept instead), 14 and 15 are already tombstoned.
+    void check_unique()
+    {
+        std::vector<int> const tombstones = { 8, 14, 15 };
+        auto same_key = [](owner const& a, owner const& b) { return a.m_id / 4 == b.m_id / 4; };
+        std::vector<int> kept, sunk;
+        for (int id = 0; id < 40; ++id) {
+            if (std::find(tombstones.begin(), tombstones.end(), id) != tombstones.end()) {
+                continue;
+            }
+            (kept.empty() || kept.back() / 4 != id / 4 ? kept : sunk).push_back(id);
+        }
+        {
+            auto range   = owner_slots(40, tombstones);
+            auto new_end = afh::unique(begin_of(range), end_of(range), same_key);
+            assert(ids(begin_of(range), new_end) == kept);
+            assert(tombstoned(new_end, end_of(range)));
+            assert(owners == long(kept.size()));
+        }
+        assert(owners == 0);
+        {
+            std::vector<owner> removed;
+            auto range   = owner_slots(40, tombstones);
+            auto new_end = afh::unique(begin_of(range), end_of(range), same_key, collecting_sink{ &removed });
+            assert(ids(begin_of(range), new_end) == kept);
+            assert(tombstoned(new_end, end_of(range)));
+            assert(ids(removed) == sunk);
+            assert(owners == long(kept.size() + sunk.size()));
+        }
+        assert(owners == 0);
+        {
+            int  calls   = 0;
+            auto range   = owner_slots(40, tombstones);
+            auto new_end = afh::unique(begin_of(range), end_of(range), same_key, ignoring_sink{ &calls });
+            assert(ids(begin_of(range), new_end) == kept);
+            assert(calls == int(sunk.size()));
+            assert(owners == long(kept.size()));
+        }
+        assert(owners == 0);
+
+        // The default predicate.  An int needs no tombstone, so the tail is
+        // just left behind.
+        auto range = to_slots(std::vector<int>{ 1, 1, 2, 2, 2, 1, 3, 3 });
+        auto new_end = afh::unique(begin_of(range), end_of(range));
+        range.erase(range.begin() + (new_end - begin_of(range)), range.end());
+        assert(to_values(range) == (std::vector<int>{ 1, 2, 1, 3 }));
+    }
+
+    void check_erase_if()
+    {
+        auto odd = [](owner const& value) { return value.m_id % 2 != 0; };
+        {
+            auto range = owner_slots(25, { 4 });
+            assert(afh::erase_if(range, odd) == 13);
+            assert(ids(begin_of(range), end_of(range)) == (std::vector<int>{ 0, 2, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24 }));
+            assert(owners == 12);
+        }
+        assert(owners == 0);
+        {
+            afh::dm_vector<owner> v;
+            for (int id = 0; id < 25; ++id) {
+                v.emplace_back(id);
+            }
+            assert(afh::erase_if(v, odd) == 12);
+            assert(v.size() == 13);
+            assert(ids(v.begin(), v.end()) == (std::vector<int>{ 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24 }));
+            assert(owners == 13);
+            assert(afh::erase_if(v, [](owner const&) { return false; }) == 0);
+            assert(afh::erase_if(v, [](owner const&) { return true; }) == 13);
+            assert(v.empty());
+            assert(owners == 0);
+        }
+    }
+}
+
+int main()
+{
+    check_sorts<int>();
+    check_sorts<std::string>();
+    check_stable_sort();
+
+    using slot = afh::optional_v2<std::string>;
+    check_throwing([](slot* first, slot* last, throwing_less comp) { afh::sort       (first, last, comp); });
+    check_throwing([](slot* first, slot* last, throwing_less comp) { afh::stable_sort(first, last, comp); });
+    check_throwing([](slot* first, slot* last, throwing_less comp) { afh::nth_element(first, first + (last - first) / 2, last, comp); });
+    check_throwing([](slot* first, slot* last, throwing_less comp) { afh::make_heap  (first, last, comp); });
+    check_throwing([](slot* first, slot* last, throwing_less comp) {
+        afh::make_heap(first, last, std::less<std::string>());
+        afh::sort_heap(first, last, comp);
+    });
+    check_throwing([](slot* first, slot* last, throwing_less comp) {
+        for (slot* end = first + 1; end <= last; ++end) {
+            afh::push_heap(first, end, comp);
+        }
+    });
+
+    check_remove_if();
+    check_unique();
+    check_erase_if();
+}
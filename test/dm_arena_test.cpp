@@ -0,0 +1,110 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that dm_arena destructs the survivors, in reverse order of
+// creation, and only drops the objects that were moved out of.
+#include "dm_arena.hpp"
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    std::vector<int> destructed;
+
+    // Records its id when destructed while it still owns something.
+    struct recorder {
+        int  m_id;
+        bool m_owns = true;
+
+        explicit recorder(int id) noexcept : m_id(id) {}
+        recorder(recorder&& other) noexcept : m_id(other.m_id), m_owns(std::exchange(other.m_owns, false)) {}
+        ~recorder() { if (m_owns) destructed.push_back(m_id); }
+    };
+
+    struct alignas(64) over_aligned { double d[9]; };
+}
+
+int main()
+{
+    {
+        afh::dm_arena arena(256);
+        std::vector<afh::optional_v2<recorder>*> objects;
+        for (int i = 0; i < 1000; ++i) {
+            objects.push_back(arena.make<recorder>(afh::emplace<recorder>(i)));
+        }
+        // Trivially destructible objects aren't recorded.
+        for (int i = 0; i < 100; ++i) {
+            auto* value = arena.make<int>(i);
+            assert(value->value() == i);
+        }
+        assert(arena.registered() == 1000);
+
+        // Move every third one out.
+        std::vector<recorder> moved;
+        for (int i = 0; i < 1000; i += 3) {
+            moved.push_back(std::move(*objects[i]).value());
+            objects[i]->has_been_moved();
+        }
+
+        arena.reset();
+        assert(arena.registered() == 0 && arena.bytes_allocated() == 0);
+        std::vector<int> expected;
+        for (int i = 999; i >= 0; --i) {
+            if (i % 3 != 0) {
+                expected.push_back(i);
+            }
+        }
+        assert(destructed == expected);
+        destructed.clear();
+    }
+    assert(destructed.size() == 334); // the moved out ones
+    destructed.clear();
+
+    // Alignment, large objects and raw allocations, across resets.
+    {
+        afh::dm_arena arena(256);
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < 500; ++i) {
+                auto* aligned = arena.make<over_aligned>();
+                assert(reinterpret_cast<std::uintptr_t>(&aligned->value()) % 64 == 0);
+                auto* text = arena.make<std::string>(std::string(50, char('a' + i % 26)));
+                assert(text->value() == std::string(50, char('a' + i % 26)));
+                void* raw = arena.allocate(24, 8);
+                assert(reinterpret_cast<std::uintptr_t>(raw) % 8 == 0);
+            }
+            auto* huge = arena.make<std::vector<char>>(std::vector<char>(10, 'x'));
+            void* block = arena.allocate(2 << 20, 16);
+            assert(block && huge->value().size() == 10);
+            arena.reset();
+        }
+    }
+
+    // Moving an arena moves its objects.
+    {
+        afh::dm_arena a;
+        a.make<recorder>(afh::emplace<recorder>(1));
+        afh::dm_arena b(std::move(a));
+        assert(a.registered() == 0 && b.registered() == 1);
+        a.reset();
+        assert(destructed.empty());
+
+        afh::dm_arena c;
+        c.make<recorder>(afh::emplace<recorder>(2));
+        c = std::move(b);
+        assert(destructed == std::vector<int>{ 2 });
+        assert(c.registered() == 1);
+    }
+    assert((destructed == std::vector<int>{ 2, 1 }));
+}
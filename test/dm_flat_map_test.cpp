@@ -0,0 +1,86 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks dm_flat_map against std::unordered_map, both for a pair whose slot
+// has a tombstone and for a trivial pair that needs the occupied flags.
+#include "dm_flat_map.hpp"
+#include <cassert>
+#include <string>
+#include <unordered_map>
+
+template <typename Map, typename Make_key, typename Make_value>
+void check_against_std(Make_key make_key, Make_value make_value)
+{
+    using K = typename Map::key_type;
+    using V = typename Map::mapped_type;
+    Map                      map;
+    std::unordered_map<K, V> expected;
+
+    // Insert enough to rehash several times, erase every third key and
+    // extract every fifth, then check everything left is still found.
+    for (int i = 0; i < 1000; ++i) {
+        auto result = map.try_emplace(make_key(i), make_value(i));
+        assert(result.second && result.first->second == make_value(i));
+        expected.emplace(make_key(i), make_value(i));
+    }
+    assert(!map.try_emplace(make_key(7), make_value(0)).second);
+    for (int i = 0; i < 1000; i += 3) {
+        assert(map.erase(make_key(i)) == 1);
+        expected.erase(make_key(i));
+    }
+    assert(map.erase(make_key(0)) == 0);
+    for (int i = 1; i < 1000; i += 15) {
+        auto extracted = map.extract(make_key(i));
+        assert(extracted.has_value() && extracted.value().second == make_value(i));
+        expected.erase(make_key(i));
+    }
+    assert(!map.extract(make_key(1)).has_value());
+
+    assert(map.size() == expected.size());
+    for (auto& [key, value] : expected) {
+        assert(map.contains(key) && map.at(key) == value);
+    }
+    std::size_t visited = 0;
+    for (auto& entry : map) {
+        assert(expected.at(entry.first) == entry.second);
+        ++visited;
+    }
+    assert(visited == expected.size());
+
+    Map copy(map);
+    assert(copy.size() == map.size());
+    for (auto& [key, value] : expected) {
+        assert(copy.at(key) == value);
+    }
+
+    map.clear();
+    assert(map.empty() && map.begin() == map.end() && !map.contains(make_key(2)));
+    map[make_key(2)] = make_value(3);
+    assert(map.size() == 1 && map.at(make_key(2)) == make_value(3));
+}
+
+int main()
+{
+    check_against_std<afh::dm_flat_map<std::string, std::string>>(
+        [](int i) { return "key " + std::to_string(i); },
+        [](int i) { return std::string(i % 40, 'v'); });
+
+    // std::pair<int, int> is trivially destructible with no internal
+    // tombstone.
+    check_against_std<afh::dm_flat_map<int, int>>(
+        [](int i) { return i * 7; },
+        [](int i) { return -i; });
+    check_against_std<afh::dm_flat_map<int, double>>(
+        [](int i) { return i; },
+        [](int i) { return i * 0.5; });
+}
@@ -0,0 +1,157 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks where dm_function keeps its callable, that moving it memcpy's a
+// trivially relocatable callable and otherwise moves it and drops the husk,
+// and that each callable is destructed exactly once.
+#include "dm_function.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <functional>
+#include <utility>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+    using afh::test::moves;
+
+    int kept = 0; // keeper destructions
+
+    struct keeper {
+        ~keeper() { ++kept; }
+    };
+
+    // Memcpy'd when its dm_function is moved.
+    struct relocatable_call {
+        owner m_owner;
+
+        static constexpr bool is_trivially_relocatable = true;
+
+        int operator()(int x) const { return x + m_owner.m_id; }
+    };
+
+    // Moved when its dm_function is moved, and its husk only destructs
+    // m_keep.
+    struct exempt_call {
+        owner  m_owner;
+        keeper m_keep;
+
+        int operator()(int x) const { return x * m_owner.m_id; }
+    };
+
+    // Too big to be inline.
+    struct big_call {
+        owner m_owner;
+        char  m_bytes[64] = {};
+
+        int operator()(int x) const { return x - m_owner.m_id; }
+    };
+
+    struct alignas(32) aligned_call {
+        int operator()(int x) const { return x; }
+    };
+
+    int twice(int x) { return 2 * x; }
+
+    using function = afh::dm_function<int(int)>;
+}
+
+template <>
+struct afh::destructively_movable_traits<exempt_call>
+{
+    using Tombstone_functions = void;
+    static constexpr auto destructive_move_exempt = afh::destructive_move_exempt(&exempt_call::m_keep);
+};
+
+static_assert(sizeof(afh::optional_v2<function>) == sizeof(function));
+static_assert( function::stored_inline<relocatable_call>);
+static_assert( function::stored_inline<exempt_call>);
+static_assert( function::stored_inline<int (*)(int)>);
+static_assert(!function::stored_inline<big_call>);
+static_assert(!function::stored_inline<aligned_call>);
+
+int main()
+{
+    // Empty.
+    {
+        function empty;
+        assert(!empty && empty == nullptr);
+        bool threw = false;
+        try {
+            empty(1);
+        }
+        catch (std::bad_function_call const&) {
+            threw = true;
+        }
+        assert(threw);
+
+        int (*null)(int) = nullptr;
+        function from_null(null);
+        assert(!from_null);
+
+        int (relocatable_call::*null_member)(int) const = nullptr;
+        afh::dm_function<int(relocatable_call const&, int)> from_null_member(null_member);
+        assert(!from_null_member);
+
+        function f(twice);
+        assert(f && f(4) == 8);
+        f = nullptr;
+        assert(!f);
+    }
+
+    // Trivially relocatable, so moving doesn't call its move constructor.
+    {
+        function a(relocatable_call{ owner(10) });
+        assert(owners == 1 && a(1) == 11);
+        moves = 0;
+        function b(std::move(a));
+        assert(!a && b(2) == 12 && moves == 0 && owners == 1);
+        a = std::move(b);
+        assert(!b && a(3) == 13 && moves == 0 && owners == 1);
+    }
+    assert(owners == 0);
+
+    // Moved and its husk dropped, which only destructs m_keep.
+    {
+        function a(exempt_call{ owner(3), keeper() });
+        kept = 0;
+        moves = 0;
+        function b(std::move(a));
+        assert(!a && b(2) == 6 && owners == 1);
+        assert(moves == 1 && kept == 1);
+        b = nullptr;
+        assert(owners == 0 && kept == 2);
+    }
+
+    // On the heap, so moving just takes the pointer.
+    {
+        function a(big_call{ owner(5) });
+        moves = 0;
+        function b(std::move(a));
+        assert(!a && b(7) == 2 && moves == 0 && owners == 1);
+        function c(aligned_call{});
+        swap(b, c);
+        assert(b(9) == 9 && c(7) == 2);
+    }
+    assert(owners == 0);
+
+    // optional_v2<dm_function> keeps its tombstone in the vtable pointer.
+    {
+        afh::optional_v2<function> opt(afh::emplace<function>(exempt_call{ owner(4), keeper() }));
+        assert(opt.value()(2) == 8);
+        function out(std::move(opt).value());
+        opt.has_been_moved();
+        assert(opt.is_tombstoned() && out(3) == 12 && owners == 1);
+    }
+    assert(owners == 0);
+}
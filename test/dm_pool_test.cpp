@@ -0,0 +1,108 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks dm_pool's emplace, release and take, and that tearing the pool down
+// destructs exactly the slots that weren't released.
+#include "dm_pool.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+}
+
+int main()
+{
+    {
+        afh::dm_pool<std::string> pool(4);
+        auto* a = pool.emplace(std::string(40, 'a'));
+        auto* b = pool.emplace(afh::emplace<std::string>(3, 'b'));
+        assert(pool.size() == 2 && pool.capacity() == 4);
+        assert(a->value() == std::string(40, 'a') && b->value() == "bbb");
+
+        assert(pool.take(a) == std::string(40, 'a'));
+        assert(pool.size() == 1);
+        // A released slot is the next one handed out.
+        auto* c = pool.emplace(std::string("c"));
+        assert(c == a && c->value() == "c");
+
+        // Releasing a slot that was moved out of only drops its husk.
+        std::string moved(std::move(*b).value());
+        b->has_been_moved();
+        pool.release(b);
+        pool.release(c);
+        assert(pool.size() == 0);
+    }
+
+    // Slots never move, across several slabs.
+    {
+        afh::dm_pool<owner> pool(3);
+        std::vector<afh::optional_v2<owner>*> slots;
+        for (int i = 0; i < 10; ++i) {
+            slots.push_back(pool.emplace(afh::emplace<owner>(i)));
+        }
+        assert(pool.capacity() == 12 && owners == 10);
+        for (int i = 0; i < 10; ++i) {
+            assert(slots[i]->value().m_id == i);
+        }
+        for (auto* slot : slots) {
+            pool.release(slot);
+        }
+        assert(pool.size() == 0 && owners == 0);
+    }
+
+    // Teardown destructs exactly the slots that weren't released or taken,
+    // whatever order the free list is in.
+    std::mt19937 rng(7);
+    for (int round = 0; round < 50; ++round) {
+        {
+            afh::dm_pool<owner> pool(1 + round % 7);
+            std::vector<afh::optional_v2<owner>*> live;
+            for (int i = 0; i < 200; ++i) {
+                if (live.empty() || rng() % 3 != 0) {
+                    live.push_back(pool.emplace(afh::emplace<owner>(i)));
+                }
+                else {
+                    std::size_t pick = rng() % live.size();
+                    auto*       slot = live[pick];
+                    live.erase(live.begin() + pick);
+                    if (rng() % 2) {
+                        pool.release(slot);
+                    }
+                    else {
+                        owner taken = pool.take(slot);
+                        assert(taken.m_owns);
+                    }
+                }
+            }
+            assert(pool.size() == live.size() && owners == long(live.size()));
+        }
+        assert(owners == 0);
+    }
+
+    // Moving the pool moves the ownership of its slots.
+    {
+        afh::dm_pool<owner> pool(2);
+        pool.emplace(afh::emplace<owner>(1));
+        pool.emplace(afh::emplace<owner>(2));
+        pool.emplace(afh::emplace<owner>(3));
+        afh::dm_pool<owner> other(std::move(pool));
+        assert(other.size() == 3 && pool.size() == 0 && owners == 3);
+    }
+    assert(owners == 0);
+}
@@ -0,0 +1,227 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks the dm_stats counters after known sequences of constructions,
+// moves, resets, relocations and destructions, that tombstone checks are
+// counted against the kind of tombstone the type has, that counts from
+// several threads are summed, and that types without collect_stats count
+// nothing.
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::dm_counter;
+
+    // Has an external tombstone.
+    struct counted {
+        owner m_owner;
+
+        static constexpr bool collect_stats = true;
+
+        explicit counted(int id) noexcept : m_owner(id) {}
+    };
+
+    // Has an internal tombstone, and sets collect_stats in its traits.
+    struct handle {
+        int* m_p;
+
+        explicit handle(int* p) noexcept : m_p(p) {}
+        ~handle() {}
+    };
+
+    struct keeper {
+        ~keeper() {}
+    };
+
+    // Its husk destructs m_keep.
+    struct exempt_counted {
+        owner  m_owner;
+        keeper m_keep;
+
+        explicit exempt_counted(int id) noexcept : m_owner(id) {}
+    };
+
+    struct uncounted {
+        owner m_owner;
+    };
+}
+
+template <>
+struct afh::destructively_movable_traits<handle>
+{
+    using Tombstone_functions = afh::tombstone_via_member<&handle::m_p>;
+    static constexpr bool collect_stats = true;
+};
+
+template <>
+struct afh::destructively_movable_traits<exempt_counted>
+{
+    using Tombstone_functions = void;
+    static constexpr auto destructive_move_exempt = afh::destructive_move_exempt(&exempt_counted::m_keep);
+    static constexpr bool collect_stats = true;
+};
+
+static_assert( afh::collect_stats<counted>);
+static_assert( afh::collect_stats<handle>);
+static_assert( afh::collect_stats<exempt_counted>);
+static_assert(!afh::collect_stats<uncounted>);
+
+namespace {
+    template <typename T>
+    using slot = afh::optional_v2<T>;
+
+    template <typename T>
+    std::uint64_t total(dm_counter counter) { return afh::dm_stats<T>::totals()[counter]; }
+
+    // Checks the counters that don't depend on how often the library reads
+    // the tombstone.
+    template <typename T>
+    void check_counts(std::uint64_t constructions, std::uint64_t moves, std::uint64_t destructions,
+        std::uint64_t elided, std::uint64_t exempt)
+    {
+        auto totals = afh::dm_stats<T>::totals();
+        assert(totals[dm_counter::constructions]       == constructions);
+        assert(totals[dm_counter::destructive_moves]   == moves);
+        assert(totals[dm_counter::destructions]        == destructions);
+        assert(totals[dm_counter::elided_destructions] == elided);
+        assert(totals[dm_counter::exempt_destructions] == exempt);
+    }
+
+    void check_sequence()
+    {
+        using stats = afh::dm_stats<counted>;
+        stats::clear();
+        check_counts<counted>(0, 0, 0, 0, 0);
+        {
+            slot<counted> a(afh::emplace<counted>(1));
+            check_counts<counted>(1, 0, 0, 0, 0);
+
+            // Moving constructs in b and moves out of a.
+            slot<counted> b(std::move(a));
+            check_counts<counted>(2, 1, 0, 0, 0);
+
+            b.reset();
+            check_counts<counted>(2, 1, 1, 0, 0);
+
+            b.emplace(2);
+            check_counts<counted>(3, 1, 1, 0, 0);
+
+            counted taken(std::move(b).value());
+            b.has_been_moved();
+            check_counts<counted>(3, 2, 1, 0, 0);
+
+            // A relocation drops the husk without destructing it.
+            a.emplace(3);
+            alignas(slot<counted>) unsigned char buffer[sizeof(slot<counted>)];
+            auto* c = reinterpret_cast<slot<counted>*>(buffer);
+            afh::relocate_at(std::addressof(a), c);
+            check_counts<counted>(5, 3, 1, 1, 0);
+            new (std::addressof(a)) slot<counted>(afh::tombstone_tag{});
+
+            std::destroy_at(c);
+            check_counts<counted>(5, 3, 2, 1, 0);
+        }
+        // a and b were tombstoned.
+        check_counts<counted>(5, 3, 2, 3, 0);
+        assert(stats::totals().elision_ratio() == 3.0 / 5.0);
+
+        stats::clear();
+        check_counts<counted>(0, 0, 0, 0, 0);
+        assert(stats::totals().elision_ratio() == 0.0);
+    }
+
+    void check_exempt()
+    {
+        afh::dm_stats<exempt_counted>::clear();
+        {
+            slot<exempt_counted> a(afh::emplace<exempt_counted>(1));
+            slot<exempt_counted> b(std::move(a));
+            check_counts<exempt_counted>(2, 1, 0, 0, 0);
+        }
+        // a's husk still destructed m_keep.
+        check_counts<exempt_counted>(2, 1, 1, 1, 1);
+    }
+
+    void check_tombstone_checks()
+    {
+        int value = 0;
+        afh::dm_stats<handle>::clear();
+        afh::dm_stats<counted>::clear();
+        {
+            slot<handle>  h(afh::emplace<handle>(&value));
+            slot<counted> c(afh::emplace<counted>(1));
+
+            auto before = afh::dm_stats<handle>::totals();
+            assert(h.has_value());
+            auto after = afh::dm_stats<handle>::totals();
+            assert(after[dm_counter::internal_tombstone_checks] == before[dm_counter::internal_tombstone_checks] + 1);
+
+            before = afh::dm_stats<counted>::totals();
+            assert(c.has_value());
+            after = afh::dm_stats<counted>::totals();
+            assert(after[dm_counter::external_tombstone_checks] == before[dm_counter::external_tombstone_checks] + 1);
+        }
+        assert(total<handle> (dm_counter::external_tombstone_checks) == 0);
+        assert(total<counted>(dm_counter::internal_tombstone_checks) == 0);
+        assert(total<handle> (dm_counter::internal_tombstone_checks) >= 2);
+        assert(total<counted>(dm_counter::external_tombstone_checks) >= 2);
+    }
+
+    // Each thread's counts go in its own block, and totals() sums them.
+    void check_threads()
+    {
+        int const per_thread = 1000;
+        afh::dm_stats<counted>::clear();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([] {
+                for (int i = 0; i < per_thread; ++i) {
+                    slot<counted> a(afh::emplace<counted>(i));
+                    slot<counted> b(std::move(a));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        check_counts<counted>(8 * per_thread, 4 * per_thread, 4 * per_thread, 4 * per_thread, 0);
+    }
+
+    void check_uncounted()
+    {
+        {
+            slot<uncounted> a(afh::emplace<uncounted>());
+            slot<uncounted> b(std::move(a));
+            assert(b.has_value());
+        }
+        check_counts<uncounted>(0, 0, 0, 0, 0);
+        assert(total<uncounted>(dm_counter::external_tombstone_checks) == 0);
+    }
+}
+
+int main()
+{
+    check_sequence();
+    check_exempt();
+    check_tombstone_checks();
+    check_threads();
+    check_uncounted();
+}
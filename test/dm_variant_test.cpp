@@ -0,0 +1,127 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that moving a dm_variant's alternative out leaves it valueless, and
+// that every alternative that still owns something is destructed exactly
+// once.
+#include "dm_variant.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+
+    struct thrower {
+        explicit thrower(int) { throw std::runtime_error("thrower"); }
+    };
+
+    using variant = afh::dm_variant<int, std::string, owner, thrower>;
+}
+
+// A const dm_variant only hands out const access to its alternative.
+static_assert(std::is_same_v<decltype(std::declval<variant const&>().get<1>()), std::string const&>);
+static_assert(std::is_same_v<decltype(std::declval<variant const&>().get<std::string>()), std::string const&>);
+static_assert(std::is_same_v<decltype(std::declval<variant const&>().get_if<1>()), std::string const*>);
+static_assert(std::is_same_v<decltype(std::declval<variant const&>().get_if<std::string>()), std::string const*>);
+static_assert(std::is_same_v<decltype(std::declval<variant&>().get<1>()), std::string&>);
+static_assert(std::is_same_v<decltype(std::declval<variant&&>().get<1>()), std::string&&>);
+static_assert(std::is_same_v<decltype(std::declval<variant&>().get_if<1>()), std::string*>);
+
+int main()
+{
+    static_assert(sizeof(afh::optional_v2<variant>) == sizeof(variant));
+    {
+        variant v;
+        assert(v.index() == 0 && v.get<int>() == 0);
+
+        v = std::string("text");
+        assert(v.holds_alternative<std::string>() && v.get<1>() == "text");
+        assert(v.get_if<int>() == nullptr && *v.get_if<std::string>() == "text");
+
+        // A const visit passes a const reference.
+        variant const& cv = v;
+        bool visited_const = cv.visit([](auto& alternative) {
+            return std::is_const_v<std::remove_reference_t<decltype(alternative)>>;
+        });
+        assert(visited_const);
+
+        v.emplace<owner>(1);
+        assert(owners == 1 && v.index() == 2 && v.get<owner>().m_id == 1);
+
+        // Copying makes a second owner, moving doesn't.
+        variant copy(v);
+        assert(owners == 2 && copy.get<owner>().m_id == 1);
+        variant moved(std::move(v));
+        assert(owners == 2 && v.valueless() && v.index() == std::variant_npos);
+        assert(moved.get<owner>().m_id == 1);
+
+        owner taken = moved.get_and_drop<owner>();
+        assert(owners == 2 && moved.valueless() && taken.m_id == 1);
+
+        // Replacing an alternative destructs it.
+        copy.emplace<std::string>(3, 'c');
+        assert(owners == 1 && copy.get<std::string>() == "ccc");
+
+        // A throwing emplace leaves the dm_variant valueless.
+        bool threw = false;
+        try {
+            copy.emplace<thrower>(0);
+        }
+        catch (std::runtime_error const&) {
+            threw = true;
+        }
+        assert(threw && copy.valueless());
+
+        copy.emplace<owner>(2);
+        int id = copy.visit_and_drop([](auto&& alternative) {
+            using type = std::decay_t<decltype(alternative)>;
+            if constexpr (std::is_same_v<type, owner>) {
+                owner local(std::move(alternative));
+                return local.m_id;
+            }
+            else {
+                return -1;
+            }
+        });
+        assert(id == 2 && copy.valueless() && owners == 1);
+
+        // Move assignment destructs the target's alternative.
+        variant a(std::in_place_type<owner>, 3);
+        variant b(std::in_place_index<2>, 4);
+        assert(owners == 3);
+        a = std::move(b);
+        assert(owners == 2 && b.valueless() && a.get<owner>().m_id == 4);
+
+        swap(a, b);
+        assert(a.valueless() && b.get<owner>().m_id == 4);
+        b.reset();
+        assert(owners == 1 && b.valueless());
+
+    }
+    assert(owners == 0);
+
+    // optional_v2<dm_variant> keeps its tombstone in the index.
+    {
+        afh::optional_v2<variant> opt(afh::emplace<variant>(std::in_place_type<owner>, 5));
+        assert(owners == 1 && opt.value().get<owner>().m_id == 5);
+        variant out(std::move(opt).value());
+        opt.has_been_moved();
+        assert(owners == 1 && out.get<owner>().m_id == 5);
+    }
+    assert(owners == 0);
+}
@@ -0,0 +1,252 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that dm_vector keeps its elements in order through growth, insert,
+// erase, pop_back() and compact(), that it memcpy's a trivially relocatable
+// element instead of moving it, and that each element (and each exempt
+// member of a husk) is destructed exactly once.
+#include "dm_vector.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+    using afh::test::moves;
+
+    long keepers = 0; // live keeper objects
+
+    struct keeper {
+        keeper() noexcept { ++keepers; }
+        keeper(keeper const&) noexcept { ++keepers; }
+        ~keeper() { --keepers; }
+    };
+
+    // Moved when relocated, and its husk only destructs m_keep.
+    struct exempt_owner {
+        owner  m_owner;
+        keeper m_keep;
+
+        explicit exempt_owner(int id) noexcept : m_owner(id) {}
+    };
+}
+
+template <>
+struct afh::destructively_movable_traits<exempt_owner>
+{
+    using Tombstone_functions = void;
+    static constexpr auto destructive_move_exempt = afh::destructive_move_exempt(&exempt_owner::m_keep);
+};
+
+namespace {
+    // Memcpy'd when relocated.
+    struct relocatable_owner {
+        owner m_owner;
+
+        static constexpr bool is_trivially_relocatable = true;
+
+        explicit relocatable_owner(int id) noexcept : m_owner(id) {}
+    };
+
+    template <typename T>
+    std::vector<int> ids(afh::dm_vector<T> const& v)
+    {
+        std::vector<int> result;
+        for (auto& slot : v) {
+            assert(slot.has_value());
+            if constexpr (std::is_same_v<T, owner>) {
+                result.push_back(slot.value().m_id);
+            }
+            else {
+                result.push_back(slot.value().m_owner.m_id);
+            }
+        }
+        return result;
+    }
+
+    void check_growth()
+    {
+        {
+            afh::dm_vector<owner> v;
+            std::vector<int> expected;
+            moves = 0;
+            long relocated = 0;
+            for (int id = 0; id < 100; ++id) {
+                if (v.size() == v.capacity()) {
+                    relocated += long(v.size());
+                }
+                v.emplace_back(id);
+                expected.push_back(id);
+                assert(owners == id + 1);
+            }
+            assert(ids(v) == expected);
+            assert(v.capacity() == 128);
+            // Growth moves each element once and drops its husk.
+            assert(moves == relocated);
+
+            v.shrink_to_fit();
+            assert(v.capacity() == 100);
+            assert(ids(v) == expected);
+            assert(owners == 100);
+        }
+        assert(owners == 0);
+        {
+            afh::dm_vector<relocatable_owner> v;
+            moves = 0;
+            for (int id = 0; id < 100; ++id) {
+                v.emplace_back(id);
+            }
+            assert(moves == 0);
+            assert(owners == 100);
+        }
+        assert(owners == 0);
+    }
+
+    void check_insert_erase()
+    {
+        {
+            afh::dm_vector<owner> v;
+            for (int id = 0; id < 8; ++id) {
+                v.emplace_back(id);
+            }
+            assert(v.capacity() == 8);
+            v.insert(v.begin() + 3, owner(30));  // reallocates
+            v.emplace(v.begin(), 40);
+            v.emplace(v.end(), 50);
+            v.insert(v.begin() + 5, owner(60));  // in place
+            assert(ids(v) == (std::vector<int>{ 40, 0, 1, 2, 30, 60, 3, 4, 5, 6, 7, 50 }));
+            assert(owners == 12);
+
+            // An element of the vector itself, which is relocated by the
+            // insert.
+            v.insert(v.begin(), v[6].value());
+            assert(ids(v) == (std::vector<int>{ 3, 40, 0, 1, 2, 30, 60, 3, 4, 5, 6, 7, 50 }));
+            assert(owners == 13);
+
+            auto at = v.erase(v.begin() + 1);
+            assert(at == v.begin() + 1 && at->value().m_id == 0);
+            at = v.erase(v.begin() + 4, v.begin() + 9);
+            assert(at->value().m_id == 6);
+            assert(ids(v) == (std::vector<int>{ 3, 0, 1, 2, 6, 7, 50 }));
+            assert(owners == 7);
+            v.erase(v.end(), v.end());
+            assert(owners == 7);
+
+            owner last = v.pop_back();
+            assert(last.m_id == 50 && last.m_owns);
+            assert(owners == 7);
+            assert(ids(v) == (std::vector<int>{ 3, 0, 1, 2, 6, 7 }));
+
+            bool threw = false;
+            try {
+                v.at(6);
+            }
+            catch (std::out_of_range const&) {
+                threw = true;
+            }
+            assert(threw);
+        }
+        assert(owners == 0);
+    }
+
+    void check_compact()
+    {
+        {
+            afh::dm_vector<owner> v;
+            for (int id = 0; id < 10; ++id) {
+                v.emplace_back(id);
+            }
+            for (int i : { 0, 4, 5, 9 }) {
+                owner taken(std::move(v[i]).value());
+                v[i].has_been_moved();
+            }
+            assert(owners == 6);
+            assert(v.compact() == 6);
+            assert(ids(v) == (std::vector<int>{ 1, 2, 3, 6, 7, 8 }));
+            assert(owners == 6);
+
+            assert(afh::erase_if(v, [](owner const& o) { return o.m_id % 2 == 0; }) == 3);
+            assert(ids(v) == (std::vector<int>{ 1, 3, 7 }));
+            assert(owners == 3);
+        }
+        assert(owners == 0);
+    }
+
+    void check_exempt()
+    {
+        {
+            afh::dm_vector<exempt_owner> v;
+            for (int id = 0; id < 20; ++id) {
+                v.emplace_back(id);
+            }
+            // The husks left by growth have had their keepers destructed.
+            assert(keepers == 20);
+            v.erase(v.begin() + 2, v.begin() + 5);
+            v.emplace(v.begin(), 100);
+            assert(keepers == 18);
+            exempt_owner last = v.pop_back();
+            assert(last.m_owner.m_id == 19);
+            assert(keepers == 18);
+            assert(ids(v) == (std::vector<int>{ 100, 0, 1, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18 }));
+            assert(owners == 18);
+        }
+        assert(keepers == 0);
+        assert(owners == 0);
+    }
+
+    void check_copy_move()
+    {
+        {
+            afh::dm_vector<owner> a;
+            for (int id = 0; id < 5; ++id) {
+                a.emplace_back(id);
+            }
+            afh::dm_vector<owner> b(a);
+            assert(ids(b) == ids(a));
+            assert(owners == 10);
+
+            afh::dm_vector<owner> c(std::move(a));
+            assert(a.empty() && ids(c) == ids(b));
+            assert(owners == 10);
+
+            b.erase(b.begin());
+            c = b;
+            assert(ids(c) == (std::vector<int>{ 1, 2, 3, 4 }));
+            assert(owners == 8);
+
+            swap(a, c);
+            assert(c.empty() && a.size() == 4);
+            a = std::move(b);
+            assert(ids(a) == (std::vector<int>{ 1, 2, 3, 4 }));
+            assert(owners == 4);
+
+            a.clear();
+            assert(a.empty());
+            assert(owners == 0);
+        }
+        assert(owners == 0);
+    }
+}
+
+int main()
+{
+    check_growth();
+    check_insert_erase();
+    check_compact();
+    check_exempt();
+    check_copy_move();
+}
@@ -0,0 +1,225 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks every liveness kernel set this CPU can run against a plain loop,
+// for sizes that aren't multiples of the vector width, with every from, and
+// checks the public functions on bitmaps whose padding bits are clear.
+#include "liveness.hpp"
+#include <cassert>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace {
+    using afh::tombstone_word;
+    using afh::detail::liveness_kernels;
+    using afh::detail::tombstone_word_bits;
+
+    std::mt19937_64 rng(7);
+
+    std::vector<liveness_kernels> runnable_kernels()
+    {
+        using namespace afh::detail;
+        std::vector<liveness_kernels> sets;
+        sets.push_back({ "scalar", count_tombstoned_words_scalar, find_live_word_scalar
+                       , count_tombstoned_bytes_scalar, find_live_byte_scalar, live_byte_mask_scalar });
+#if AFH___LIVENESS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+            sets.push_back({ "sse4.2", count_tombstoned_words_sse42, find_live_word_sse42
+                           , count_tombstoned_bytes_sse42, find_live_byte_sse42, live_byte_mask_sse42 });
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            sets.push_back({ "avx2", count_tombstoned_words_avx2, find_live_word_avx2
+                           , count_tombstoned_bytes_avx2, find_live_byte_avx2, live_byte_mask_avx2 });
+        }
+#endif
+        return sets;
+    }
+
+    // Mostly all set words, so that finding a live one has to skip some.
+    tombstone_word random_word()
+    {
+        switch (rng() % 4) {
+        case 0:  return rng();
+        case 1:  return ~(tombstone_word(1) << (rng() % 64));
+        default: return ~tombstone_word(0);
+        }
+    }
+
+    // Mostly true flags, in runs.
+    bool random_flag()
+    {
+        return rng() % 8 != 0;
+    }
+
+    void check_word_kernels(liveness_kernels const& k)
+    {
+        for (std::size_t word_count = 0; word_count != 40; ++word_count) {
+            for (int round = 0; round != 20; ++round) {
+                std::vector<tombstone_word> words(word_count);
+                for (auto& word : words) {
+                    word = random_word();
+                }
+                std::size_t set = 0;
+                for (auto word : words) {
+                    for (std::size_t b = 0; b != tombstone_word_bits; ++b) {
+                        set += (word >> b) & 1;
+                    }
+                }
+                assert(k.count_tombstoned_words(words.data(), word_count) == set);
+
+                for (std::size_t from = 0; from <= word_count; ++from) {
+                    std::size_t expected = from;
+                    while (expected != word_count && words[expected] == ~tombstone_word(0)) {
+                        ++expected;
+                    }
+                    assert(k.find_live_word(words.data(), from, word_count) == expected);
+                }
+            }
+        }
+    }
+
+    void check_byte_kernels(liveness_kernels const& k)
+    {
+        // One extra leading flag, so the loads are also unaligned.
+        for (std::size_t count = 0; count != 200; ++count) {
+            for (int round = 0; round != 5; ++round) {
+                bool* flags = new bool[count + 1];
+                for (std::size_t i = 0; i != count + 1; ++i) {
+                    flags[i] = random_flag();
+                }
+                std::size_t set = 0;
+                for (std::size_t i = 1; i != count + 1; ++i) {
+                    set += flags[i];
+                }
+                assert(k.count_tombstoned_bytes(flags + 1, count) == set);
+
+                for (std::size_t from = 0; from <= count; ++from) {
+                    std::size_t expected = from;
+                    while (expected != count && flags[1 + expected]) {
+                        ++expected;
+                    }
+                    assert(k.find_live_byte(flags + 1, from, count) == expected);
+                }
+
+                if (count >= tombstone_word_bits) {
+                    tombstone_word expected = 0;
+                    for (std::size_t i = 0; i != tombstone_word_bits; ++i) {
+                        expected |= tombstone_word(!flags[1 + i]) << i;
+                    }
+                    assert(k.live_byte_mask(flags + 1) == expected);
+                }
+                delete[] flags;
+            }
+        }
+    }
+
+    // A bitmap of count elements, with the padding bits clear.
+    std::vector<tombstone_word> random_bitmap(std::size_t count, std::vector<bool>& tombstoned)
+    {
+        std::vector<tombstone_word> bitmap(afh::detail::tombstone_words(count));
+        tombstoned.assign(count, false);
+        for (std::size_t i = 0; i != count; ++i) {
+            tombstoned[i] = rng() % 16 != 0;
+            if (tombstoned[i]) {
+                bitmap[i / tombstone_word_bits] |= tombstone_word(1) << (i % tombstone_word_bits);
+            }
+        }
+        return bitmap;
+    }
+
+    void check_public_bitmap()
+    {
+        for (std::size_t count : { 1, 63, 64, 65, 127, 128, 129, 255, 256, 257, 300, 511, 1000 }) {
+            for (int round = 0; round != 20; ++round) {
+                std::vector<bool> tombstoned;
+                auto bitmap = random_bitmap(count, tombstoned);
+                // Every element tombstoned, so only the padding reads as live.
+                if (round == 0) {
+                    afh::detail::tombstone_all(bitmap.data(), count);
+                    tombstoned.assign(count, true);
+                }
+
+                std::size_t live = 0;
+                std::vector<unsigned> expected_indices;
+                for (std::size_t i = 0; i != count; ++i) {
+                    if (!tombstoned[i]) {
+                        ++live;
+                        expected_indices.push_back(unsigned(i));
+                    }
+                }
+                assert(afh::count_live(bitmap.data(), count) == live);
+
+                std::vector<unsigned> indices(count);
+                assert(afh::live_indices(bitmap.data(), count, indices.data()) == live);
+                indices.resize(live);
+                assert(indices == expected_indices);
+
+                for (std::size_t from = 0; from <= count + 1; ++from) {
+                    std::size_t expected = from;
+                    while (expected < count && tombstoned[expected]) {
+                        ++expected;
+                    }
+                    if (expected > count) {
+                        expected = count;
+                    }
+                    assert(afh::find_next_live(bitmap.data(), from, count) == expected);
+                }
+            }
+        }
+    }
+
+    void check_public_flags()
+    {
+        for (std::size_t count : { 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 130, 1000 }) {
+            for (int round = 0; round != 20; ++round) {
+                std::vector<char> storage(count);
+                bool* flags = reinterpret_cast<bool*>(storage.data());
+                std::vector<unsigned> expected_indices;
+                for (std::size_t i = 0; i != count; ++i) {
+                    flags[i] = round == 0 || rng() % 16 != 0;
+                    if (!flags[i]) {
+                        expected_indices.push_back(unsigned(i));
+                    }
+                }
+                assert(afh::count_live(flags, count) == expected_indices.size());
+
+                std::vector<unsigned> indices(count);
+                indices.resize(afh::live_indices(flags, count, indices.data()));
+                assert(indices == expected_indices);
+
+                for (std::size_t from = 0; from <= count + 1; ++from) {
+                    std::size_t expected = from;
+                    while (expected < count && flags[expected]) {
+                        ++expected;
+                    }
+                    if (expected > count) {
+                        expected = count;
+                    }
+                    assert(afh::find_next_live(flags, from, count) == expected);
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    for (auto const& kernels : runnable_kernels()) {
+        check_word_kernels(kernels);
+        check_byte_kernels(kernels);
+    }
+    check_public_bitmap();
+    check_public_flags();
+}
@@ -0,0 +1,83 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that each optional_pack member is independently optional, whether
+// its tombstone is internal or a packed bit, and that moving or copying the
+// pack destructs each member that still owns something exactly once.
+#include "optional_pack.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+
+    using pack = afh::optional_pack<owner, std::string, int, owner, char>;
+}
+
+#if AFH_HAS_STD_TOMBSTONES
+// Members with an internal tombstone don't need a flag.
+static_assert(sizeof(afh::optional_pack<std::string, std::unique_ptr<int>>)
+    == sizeof(std::string) + sizeof(std::unique_ptr<int>));
+#endif
+static_assert(!std::is_copy_constructible_v<afh::optional_pack<int, std::unique_ptr<int>>>);
+
+int main()
+{
+    {
+        pack p;
+        assert(!p.has_value<0>() && !p.has_value<1>() && !p.has_value<2>()
+            && !p.has_value<3>() && !p.has_value<4>());
+
+        p.emplace<0>(1);
+        p.emplace<1>(afh::emplace<std::string>(40, 's'));
+        p.emplace<3>(3);
+        assert(owners == 2);
+        assert(p.has_value<0>() && p.has_value<1>() && !p.has_value<2>() && p.has_value<3>());
+        assert(p.get<0>().m_id == 1 && p.get<1>() == std::string(40, 's') && p.get<3>().m_id == 3);
+
+        // Emplacing over a member destructs it.
+        p.emplace<0>(2);
+        assert(owners == 2 && p.get<0>().m_id == 2);
+
+        owner taken = p.get_and_drop<0>();
+        assert(owners == 2 && !p.has_value<0>() && p.has_value<3>());
+
+        std::string moved(std::move(p.get<1>()));
+        p.has_been_moved<1>();
+        assert(!p.has_value<1>() && moved == std::string(40, 's'));
+
+        // Copying makes new owners, moving doesn't.
+        p.emplace<4>('c');
+        pack copy(p);
+        assert(owners == 3 && copy.get<3>().m_id == 3 && copy.get<4>() == 'c');
+        pack other(std::move(p));
+        assert(owners == 3 && !p.has_value<3>() && !p.has_value<4>());
+        assert(other.get<3>().m_id == 3 && other.get<4>() == 'c');
+
+        // Assignment destructs the target's members.
+        copy.emplace<0>(4);
+        assert(owners == 4);
+        copy = std::move(other);
+        assert(owners == 2 && !copy.has_value<0>() && copy.get<3>().m_id == 3);
+
+        copy.reset<3>();
+        assert(owners == 1 && !copy.has_value<3>() && copy.has_value<4>());
+        copy.reset();
+        assert(!copy.has_value<4>());
+    }
+    assert(owners == 0);
+}
@@ -0,0 +1,218 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks per-index emplace(), reset() and has_been_moved() on
+// optional_v2_array and optional_v2_dynarray, that an emplace<T>(...) object
+// is used as is whether it is an rvalue, a const lvalue or a non-const
+// lvalue, that has_been_moved() only destructs the destructive_move_exempt
+// members, and that compact() keeps the live elements in order.
+#include "optional_v2_array.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+    using afh::test::moves;
+
+    long keepers = 0; // live keeper objects
+
+    struct keeper {
+        keeper() noexcept { ++keepers; }
+        keeper(keeper const&) noexcept { ++keepers; }
+        ~keeper() { --keepers; }
+    };
+
+    // Its husk only destructs m_keep.
+    struct exempt_owner {
+        owner  m_owner;
+        keeper m_keep;
+
+        explicit exempt_owner(int id) noexcept : m_owner(id) {}
+    };
+}
+
+template <>
+struct afh::destructively_movable_traits<exempt_owner>
+{
+    using Tombstone_functions = void;
+    static constexpr auto destructive_move_exempt = afh::destructive_move_exempt(&exempt_owner::m_keep);
+};
+
+namespace {
+    // Records how it was constructed.
+    struct made {
+        enum from { value, copy, move };
+        from m_from;
+
+        explicit made(owner const&) noexcept : m_from(copy) {}
+        explicit made(owner&&)      noexcept : m_from(move) {}
+        explicit made(int)          noexcept : m_from(value) {}
+    };
+
+    int id_of(owner const& value) { return value.m_id; }
+    int id_of(exempt_owner const& value) { return value.m_owner.m_id; }
+
+    // The ids of the live elements, with -1 for each tombstoned one.
+    template <typename Array>
+    std::vector<int> ids(Array const& array)
+    {
+        std::vector<int> result;
+        for (std::size_t i = 0; i != array.size(); ++i) {
+            result.push_back(array.has_value(i) ? id_of(array[i]) : -1);
+        }
+        return result;
+    }
+
+    template <typename Array>
+    void check_emplace_params(Array& array)
+    {
+        owner source(1);
+
+        // A named emplace<T>(...) object is passed on as is, not wrapped in
+        // another one, and is used as const, so each use moves from a copy
+        // of source rather than from source.
+        auto params = afh::emplace<made>(std::move(source));
+        array.emplace(0, params);
+        assert(array[0].m_from == made::move && source.m_owns);
+        array.emplace(1, std::as_const(params));
+        assert(array[1].m_from == made::move && source.m_owns);
+
+        array.emplace(2, afh::emplace<made>(std::move(source)));
+        assert(array[2].m_from == made::move && source.m_owns);
+
+        array.emplace(3, 7);
+        assert(array[3].m_from == made::value);
+        array.emplace(4, source);
+        assert(array[4].m_from == made::copy);
+        assert(source.m_owns);
+    }
+
+    // Array is an array of 70 T's (more than one tombstone word).
+    template <typename T, typename Array>
+    void check(Array& array)
+    {
+        assert(array.count() == 0);
+        for (std::size_t i = 0; i != array.size(); ++i) {
+            assert(array.is_tombstoned(i));
+        }
+        for (int id = 0; id < 70; ++id) {
+            array.emplace(std::size_t(id), afh::emplace<T>(id));
+        }
+        assert(array.count() == 70);
+        assert(owners == 70);
+        long const keepers_per = std::is_same_v<T, exempt_owner> ? 1 : 0;
+        assert(keepers == 70 * keepers_per);
+
+        // Reset destructs the whole element.
+        array.reset(3);
+        assert(array.is_tombstoned(3));
+        assert(owners == 69);
+        assert(keepers == 69 * keepers_per);
+
+        // has_been_moved() only destructs exempt members.
+        for (std::size_t i : { 0, 10, 63, 64, 69 }) {
+            T taken(std::move(array[i]));
+            array.has_been_moved(i);
+            assert(array.is_tombstoned(i));
+        }
+        assert(owners == 64);
+        assert(keepers == 64 * keepers_per);
+        assert(array.count() == 64);
+
+        bool threw = false;
+        try {
+            array.at(10);
+        }
+        catch (std::logic_error const&) {
+            threw = true;
+        }
+        assert(threw);
+
+        // Refill a tombstoned slot.
+        array.emplace(64, afh::emplace<T>(100));
+        assert(array.count() == 65);
+
+        // Every live element not already in its place is moved down.
+        std::vector<int> expected;
+        long             relocated = 0;
+        auto             before    = ids(array);
+        for (std::size_t i = 0; i != before.size(); ++i) {
+            if (before[i] != -1) {
+                relocated += i != expected.size();
+                expected.push_back(before[i]);
+            }
+        }
+        moves = 0;
+        assert(array.compact() == 65);
+        assert(moves == (afh::is_trivially_relocatable<T> ? 0 : relocated));
+        auto after = ids(array);
+        assert(std::vector<int>(after.begin(), after.begin() + 65) == expected);
+        for (std::size_t i = 65; i != 70; ++i) {
+            assert(array.is_tombstoned(i));
+        }
+        assert(array.find_next_live(65) == 70);
+        assert(owners == 65);
+        assert(keepers == 65 * keepers_per);
+    }
+
+    template <typename T>
+    void check_all()
+    {
+        {
+            afh::optional_v2_array<T, 70> array;
+            check<T>(array);
+
+            auto copy = array;
+            assert(ids(copy) == ids(array));
+            assert(owners == 130);
+            auto moved = std::move(copy);
+            assert(copy.count() == 0 && moved.count() == 65);
+            assert(owners == 130);
+        }
+        assert(owners == 0);
+        assert(keepers == 0);
+        {
+            afh::optional_v2_dynarray<T> array(70);
+            check<T>(array);
+
+            auto copy = array;
+            assert(ids(copy) == ids(array));
+            assert(owners == 130);
+            auto moved = std::move(copy);
+            assert(moved.count() == 65);
+            assert(owners == 130);
+        }
+        assert(owners == 0);
+        assert(keepers == 0);
+    }
+}
+
+int main()
+{
+    check_all<owner>();
+    check_all<exempt_owner>();
+    {
+        afh::optional_v2_array<made, 5> array;
+        check_emplace_params(array);
+    }
+    {
+        afh::optional_v2_dynarray<made> array(5);
+        check_emplace_params(array);
+    }
+    assert(owners == 0);
+}
@@ -0,0 +1,104 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that optional_v2_epoch_array's drop_all() tombstones every element,
+// that no element comes back to life when the epoch wraps, and that each
+// element that still owns something is destructed exactly once.
+#include "optional_v2_epoch_array.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+}
+
+int main()
+{
+    {
+        afh::optional_v2_epoch_array<owner> array(8);
+        assert(array.size() == 8 && array.count() == 0);
+        for (int i = 0; i != 8; ++i) {
+            array.emplace(i, i);
+        }
+        assert(owners == 8 && array.count() == 8 && array[5].m_id == 5);
+
+        array.reset(1);
+        assert(owners == 7 && array.is_tombstoned(1));
+
+        bool threw = false;
+        try {
+            array.at(1);
+        }
+        catch (std::logic_error const&) {
+            threw = true;
+        }
+        assert(threw);
+
+        // Move every live element out, then tombstone them all at once.
+        std::vector<owner> moved;
+        for (int i = 0; i != 8; ++i) {
+            if (array.has_value(i)) {
+                moved.push_back(std::move(array[i]));
+            }
+        }
+        auto epoch = array.epoch();
+        array.drop_all();
+        assert(array.epoch() == epoch + 1 && array.count() == 0 && owners == 7);
+        moved.clear();
+        assert(owners == 0);
+
+        // Elements can be brought back, one moved out on its own and the
+        // rest destructed by reset_all().
+        int  id     = 30;
+        auto params = afh::emplace<owner>(id);
+        array.emplace(2, afh::emplace<owner>(20));
+        array.emplace(3, params);
+        array.emplace(4, 40);
+        owner taken(std::move(array[3]));
+        array.has_been_moved(3);
+        assert(owners == 3 && array.count() == 2);
+
+        auto copy(array);
+        assert(owners == 5 && copy.count() == 2 && copy.at(4).m_id == 40);
+        array.reset_all();
+        assert(owners == 3 && array.count() == 0);
+
+        auto other(std::move(copy));
+        assert(copy.size() == 0 && other.count() == 2);
+        array = std::move(other);
+        assert(owners == 3 && array[2].m_id == 20);
+    }
+    assert(owners == 0);
+
+    // An element left behind in epoch 1 stays tombstoned when the epoch
+    // wraps back to 1.
+    {
+        afh::optional_v2_epoch_array<int, std::uint8_t> array(4);
+        array.emplace(0, 1);
+        array.emplace(1, 2);
+        for (int i = 0; i != std::numeric_limits<std::uint8_t>::max(); ++i) {
+            array.drop_all();
+        }
+        assert(array.epoch() == 1);
+        assert(array.count() == 0 && array.is_tombstoned(0) && array.is_tombstoned(1));
+        array.emplace(1, 3);
+        assert(array.count() == 1 && array[1] == 3);
+    }
+}
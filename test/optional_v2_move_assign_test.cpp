@@ -0,0 +1,106 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Move assigning one live optional_v2<T> to another must not leak what the
+// move assignment left in the source.  libstdc++'s std::string hands its old
+// buffer back to the source, so dropping the source's husk leaked it.
+#include "destructively_movable.hpp"
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+static long live_allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    if (void* p = std::malloc(size ? size : 1)) {
+        ++live_allocations;
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p) {
+        --live_allocations;
+        std::free(p);
+    }
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+// Hands its old resource back to the source on move assignment, like
+// std::string, but its move constructor can throw.
+struct throwing_move {
+    int* m_p;
+    static bool throw_on_assign;
+
+    explicit throwing_move(int v) : m_p(new int(v)) {}
+    throwing_move(throwing_move&& other) noexcept(false) : m_p(other.m_p) { other.m_p = nullptr; }
+    throwing_move& operator=(throwing_move&& other) noexcept(false)
+    {
+        if (throw_on_assign) {
+            throw std::runtime_error("assign");
+        }
+        std::swap(m_p, other.m_p);
+        return *this;
+    }
+    ~throwing_move() { delete m_p; }
+};
+bool throwing_move::throw_on_assign = false;
+
+int main()
+{
+    long const baseline = live_allocations;
+    {
+        afh::optional_v2<std::string> a(std::string(64, 'a'));
+        afh::optional_v2<std::string> b(std::string(64, 'b'));
+        a = std::move(b);
+        assert(a.value() == std::string(64, 'b'));
+        assert(b.is_tombstoned());
+    }
+    assert(live_allocations == baseline);
+
+    {
+        afh::optional_v2<throwing_move> a(afh::emplace<throwing_move>(1));
+        afh::optional_v2<throwing_move> b(afh::emplace<throwing_move>(2));
+        a = std::move(b);
+        assert(*a.value().m_p == 2);
+        assert(b.is_tombstoned());
+    }
+    assert(live_allocations == baseline);
+
+    {
+        // The move constructor can throw, so a throwing assignment leaves
+        // both sides with their values.
+        afh::optional_v2<throwing_move> a(afh::emplace<throwing_move>(1));
+        afh::optional_v2<throwing_move> b(afh::emplace<throwing_move>(2));
+        throwing_move::throw_on_assign = true;
+        try {
+            a = std::move(b);
+            assert(false);
+        }
+        catch (std::runtime_error const&) {
+        }
+        throwing_move::throw_on_assign = false;
+        assert(!a.is_tombstoned() && *a.value().m_p == 1);
+        assert(!b.is_tombstoned() && *b.value().m_p == 2);
+    }
+    assert(live_allocations == baseline);
+}
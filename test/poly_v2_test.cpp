@@ -0,0 +1,122 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that poly_v2 finds the Base of what it holds, and that relocating
+// it, by moving or by memcpy, destructs each object that still owns
+// something exactly once.
+#include "poly_v2.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    using afh::test::owners;
+
+    // Has no virtual destructor.
+    struct shape {
+        int m_sides;
+    };
+
+    struct padding {
+        char m_bytes[12] = {};
+    };
+
+    // shape isn't at offset 0, and moving transfers ownership.
+    struct owned_shape : padding, shape {
+        bool m_owns = true;
+
+        explicit owned_shape(int sides) noexcept : shape{ sides } { ++owners; }
+        owned_shape(owned_shape&& other) noexcept : shape(other), m_owns(std::exchange(other.m_owns, false)) {}
+        ~owned_shape() { if (m_owns) --owners; }
+    };
+
+    // Is memcpy'd when relocated.
+    struct boxed_shape : shape {
+        int* m_box;
+
+        static constexpr bool is_trivially_relocatable = true;
+
+        explicit boxed_shape(int sides) : shape{ sides }, m_box(new int(sides)) { ++owners; }
+        boxed_shape(boxed_shape&& other) noexcept : shape(other), m_box(std::exchange(other.m_box, nullptr)) {}
+        ~boxed_shape() { if (m_box) { delete m_box; --owners; } }
+    };
+
+    struct throwing_shape : shape {
+        explicit throwing_shape(int) { throw std::runtime_error("throwing_shape"); }
+    };
+
+    struct too_big : shape {
+        char m_bytes[64];
+    };
+
+    using poly = afh::poly_v2<shape>;
+}
+
+int main()
+{
+    static_assert(sizeof(poly) == 64);
+    static_assert(sizeof(afh::optional_v2<poly>) == sizeof(poly));
+    static_assert(poly::fits<owned_shape> && poly::fits<boxed_shape> && !poly::fits<too_big>);
+    {
+        poly empty;
+        assert(!empty && empty.get() == nullptr);
+
+        poly a(std::in_place_type<owned_shape>, 3);
+        assert(owners == 1 && a->m_sides == 3);
+        assert(static_cast<void*>(a.get()) != static_cast<void*>(&a));
+
+        // Moving relocates and leaves the source empty.
+        poly b(std::move(a));
+        assert(owners == 1 && !a && b->m_sides == 3);
+
+        poly c(boxed_shape(4));
+        assert(owners == 2 && c->m_sides == 4);
+        poly d(std::move(c));
+        assert(owners == 2 && !c && d->m_sides == 4);
+
+        // Assignment destructs the target's object.
+        b = std::move(d);
+        assert(owners == 1 && !d && b->m_sides == 4);
+
+        a.emplace<owned_shape>(5);
+        swap(a, b);
+        assert(owners == 2 && a->m_sides == 4 && b->m_sides == 5);
+
+        // A throwing emplace leaves the poly_v2 empty.
+        bool threw = false;
+        try {
+            b.emplace<throwing_shape>(0);
+        }
+        catch (std::runtime_error const&) {
+            threw = true;
+        }
+        assert(threw && !b && owners == 1);
+
+        b.emplace(afh::emplace<owned_shape>(6));
+        assert(owners == 2 && (*b).m_sides == 6);
+        b = nullptr;
+        assert(owners == 1 && !b);
+    }
+    assert(owners == 0);
+
+    // optional_v2<poly_v2> keeps its tombstone in the descriptor pointer.
+    {
+        afh::optional_v2<poly> opt(afh::emplace<poly>(std::in_place_type<boxed_shape>, 7));
+        assert(owners == 1 && opt.value()->m_sides == 7);
+        poly out(std::move(opt).value());
+        opt.has_been_moved();
+        assert(owners == 1 && out->m_sides == 7);
+    }
+    assert(owners == 0);
+}
@@ -0,0 +1,221 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that relocate_at() and uninitialized_relocate(_n/_backward) keep
+// values, tombstones and their order, including over overlapping ranges,
+// that they memcpy a trivially relocatable type and otherwise move it and
+// drop the husk, and that each object is destructed exactly once.
+#include "relocate.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+    using afh::test::moves;
+
+    long keepers = 0; // live keeper objects
+
+    struct keeper {
+        keeper() noexcept { ++keepers; }
+        keeper(keeper const&) noexcept { ++keepers; }
+        ~keeper() { --keepers; }
+    };
+
+    // Moved when relocated, and its husk only destructs m_keep.
+    struct exempt_owner {
+        owner  m_owner;
+        keeper m_keep;
+
+        explicit exempt_owner(int id) noexcept : m_owner(id) {}
+    };
+}
+
+template <>
+struct afh::destructively_movable_traits<exempt_owner>
+{
+    using Tombstone_functions = void;
+    static constexpr auto destructive_move_exempt = afh::destructive_move_exempt(&exempt_owner::m_keep);
+};
+
+namespace {
+    // Memcpy'd when relocated.
+    struct relocatable_owner {
+        owner m_owner;
+
+        static constexpr bool is_trivially_relocatable = true;
+
+        explicit relocatable_owner(int id) noexcept : m_owner(id) {}
+    };
+
+    int id_of(owner const& value) { return value.m_id; }
+    template <typename T>
+    int id_of(T const& value) { return value.m_owner.m_id; }
+
+    // Uninitialised storage for count slots.
+    template <typename T>
+    class storage
+    {
+    public:
+        using slot = afh::optional_v2<T>;
+
+        explicit storage(std::size_t count)
+            : m_slots(static_cast<slot*>(::operator new(count * sizeof(slot), std::align_val_t(alignof(slot)))))
+        {}
+
+        ~storage() { ::operator delete(m_slots, std::align_val_t(alignof(slot))); }
+
+        slot* operator+(std::size_t i) const noexcept { return m_slots + i; }
+        slot& operator[](std::size_t i) const noexcept { return m_slots[i]; }
+
+    private:
+        slot* m_slots;
+    };
+
+    // Constructs ids 0 to count - 1 at first, with every third slot
+    // tombstoned.  -1 stands for a tombstone.  A tombstone is recreated
+    // without any destructive_move_exempt members, so only husks with
+    // nothing to destruct are tombstoned.
+    template <typename T>
+    std::vector<int> fill(afh::optional_v2<T>* first, int count)
+    {
+        std::vector<int> expected;
+        for (int id = 0; id < count; ++id) {
+            auto* slot = new (first + id) afh::optional_v2<T>(afh::emplace<T>(id));
+            if (afh::optional_v2<T>::has_nothing_to_destruct_after_move && id % 3 == 2) {
+                T taken(std::move(*slot).value());
+                slot->has_been_moved();
+                expected.push_back(-1);
+            }
+            else {
+                expected.push_back(id);
+            }
+        }
+        return expected;
+    }
+
+    template <typename T>
+    std::vector<int> ids(afh::optional_v2<T> const* first, afh::optional_v2<T> const* last)
+    {
+        std::vector<int> result;
+        for (; first != last; ++first) {
+            result.push_back(first->has_value() ? id_of(first->value()) : -1);
+        }
+        return result;
+    }
+
+    template <typename T>
+    long live(std::vector<int> const& expected)
+    {
+        long count = 0;
+        for (int id : expected) {
+            count += id != -1;
+        }
+        return count;
+    }
+
+    // Moves made relocating the values in expected.
+    template <typename T>
+    long relocation_moves(std::vector<int> const& expected)
+    {
+        return afh::is_trivially_relocatable<T> ? 0 : live<T>(expected);
+    }
+
+    template <typename T>
+    void check_relocate_at()
+    {
+        using slot = afh::optional_v2<T>;
+        storage<T> buffer(2);
+        {
+            new (buffer + 0) slot(afh::emplace<T>(7));
+            moves = 0;
+            afh::relocate_at(buffer + 0, buffer + 1);
+            assert(moves == relocation_moves<T>({ 7 }));
+            assert(ids<T>(buffer + 1, buffer + 2) == std::vector<int>{ 7 });
+            assert(owners == 1);
+            std::destroy_at(buffer + 1);
+        }
+        assert(owners == 0);
+        if constexpr (slot::has_nothing_to_destruct_after_move) {
+            // A tombstone is relocated as a tombstone.
+            auto* source = new (buffer + 0) slot(afh::emplace<T>(7));
+            T taken(std::move(*source).value());
+            source->has_been_moved();
+            afh::relocate_at(buffer + 0, buffer + 1);
+            assert(buffer[1].is_tombstoned());
+            std::destroy_at(buffer + 1);
+        }
+        assert(owners == 0);
+    }
+
+    // Shifts 40 slots up and then down by distance, so that the source and
+    // destination overlap when distance < 40.
+    template <typename T>
+    void check_ranges(std::size_t distance)
+    {
+        int const  count = 40;
+        storage<T> buffer(count + distance);
+        auto expected = fill<T>(buffer + 0, count);
+        assert(owners == live<T>(expected));
+
+        moves = 0;
+        auto* d_first = afh::uninitialized_relocate_backward(buffer + 0, buffer + count, buffer + count + distance);
+        assert(d_first == buffer + distance);
+        assert(ids<T>(buffer + distance, buffer + count + distance) == expected);
+        assert(moves == relocation_moves<T>(expected));
+        assert(owners == live<T>(expected));
+
+        moves = 0;
+        auto* d_last = afh::uninitialized_relocate(buffer + distance, buffer + count + distance, buffer + 0);
+        assert(d_last == buffer + count);
+        assert(ids<T>(buffer + 0, buffer + count) == expected);
+        assert(moves == relocation_moves<T>(expected));
+
+        // Moves the second half down onto the first half's place after the
+        // first half has been destroyed.
+        afh::destroy_n(buffer + 0, count / 2);
+        auto ends = afh::uninitialized_relocate_n(buffer + count / 2, count / 2, buffer + 0);
+        assert(ends.first == buffer + count && ends.second == buffer + count / 2);
+        assert(ids<T>(buffer + 0, buffer + count / 2) == std::vector<int>(expected.begin() + count / 2, expected.end()));
+        assert(owners == live<T>(std::vector<int>(expected.begin() + count / 2, expected.end())));
+
+        afh::destroy_n(buffer + 0, count / 2);
+        assert(owners == 0);
+    }
+
+    template <typename T>
+    void check()
+    {
+        check_relocate_at<T>();
+        for (std::size_t distance : { 1, 3, 39, 40, 41 }) {
+            check_ranges<T>(distance);
+        }
+        assert(owners == 0);
+        assert(keepers == 0);
+    }
+}
+
+static_assert(!afh::is_trivially_relocatable<owner>);
+static_assert( afh::is_trivially_relocatable<relocatable_owner>);
+static_assert(!afh::is_trivially_relocatable<exempt_owner>);
+
+int main()
+{
+    check<owner>();
+    check<relocatable_owner>();
+    check<exempt_owner>();
+}
@@ -0,0 +1,143 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that spsc_ring keeps FIFO order and destructs each value exactly
+// once, with a producer and a consumer thread using every push and pop
+// operation across many wraparounds.  Build it with
+// -DAFH_TEST_SANITIZER=thread to run it under ThreadSanitizer.
+#include "spsc_ring.hpp"
+#include "test_types.hpp"
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+
+    using ring = afh::spsc_ring<owner>;
+
+    // Pushes up to batch values at once, which is more than fits.
+    void batches()
+    {
+        ring r(8);
+        for (int i = 0; i != 5; ++i) {
+            assert(r.try_emplace(afh::emplace<owner>(i)));
+        }
+        for (int i = 0; i != 3; ++i) {
+            auto value = r.try_pop();
+            assert(value.has_value() && value.value().m_id == i);
+        }
+        // The producer's cached head is stale, so it must re-read it to see
+        // that 6 slots are free.
+        std::vector<owner> batch;
+        for (int i = 5; i != 15; ++i) {
+            batch.emplace_back(i);
+        }
+        auto rest = r.try_push_n(batch.begin(), batch.end());
+        assert(rest == batch.begin() + 6 && r.size() == 8);
+        assert(!r.try_emplace(afh::emplace<owner>(99)));
+
+        int next = 3;
+        assert(r.consume_n([&next](owner&& value) { assert(value.m_id == next++); }, 100) == 8);
+        assert(next == 11 && r.empty());
+        assert(!r.try_pop().has_value());
+    }
+
+    void threads()
+    {
+        constexpr int total = 200000;
+        constexpr int keep  = 5; // left in the ring for its destructor
+        ring r(16);
+
+        std::thread producer([&r] {
+            std::vector<owner> batch;
+            for (int id = 0, step = 0; id != total; ++step) {
+                bool pushed = false;
+                switch (step % 3) {
+                case 0:
+                    if (r.try_emplace(afh::emplace<owner>(id))) {
+                        ++id;
+                        pushed = true;
+                    }
+                    break;
+                case 1: {
+                    batch.clear();
+                    int size = 1 + step % 23;
+                    for (int i = id; i != id + size && i != total; ++i) {
+                        batch.emplace_back(i);
+                    }
+                    auto rest = r.try_push_n(batch.begin(), batch.end());
+                    id += int(rest - batch.begin());
+                    pushed = rest != batch.begin();
+                    break;
+                }
+                default: {
+                    afh::optional_v2<owner> source(afh::emplace<owner>(id));
+                    if (r.try_relocate(std::addressof(source))) {
+                        new (std::addressof(source)) afh::optional_v2<owner>(afh::tombstone_tag{});
+                        ++id;
+                        pushed = true;
+                    }
+                    break;
+                }
+                }
+                if (!pushed) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        int next = 0;
+        for (int step = 0; next != total - keep; ++step) {
+            std::size_t room = std::size_t(total - keep - next);
+            std::size_t max  = std::min<std::size_t>(1 + step % 29, room);
+            std::size_t done = 0;
+            switch (step % 3) {
+            case 0: {
+                auto value = r.try_pop();
+                if (value.has_value()) {
+                    assert(value.value().m_id == next);
+                    ++next;
+                    done = 1;
+                }
+                break;
+            }
+            case 1:
+                done = r.consume_n([&next](owner&& value) { assert(value.m_id == next); ++next; }, max);
+                break;
+            default:
+                done = r.discard_n(max);
+                next += int(done);
+                break;
+            }
+            if (done == 0) {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        assert(r.size() == std::size_t(keep));
+        assert(owners == keep);
+    }
+}
+
+int main()
+{
+    batches();
+    assert(owners == 0);
+    threads();
+    assert(owners == 0);
+}
@@ -0,0 +1,94 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks the standard library tombstones.  Only destructively_movable.hpp is
+// included, as it must bring in destructively_movable_std.hpp itself.
+#include "destructively_movable.hpp"
+#include <cassert>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if AFH_HAS_STD_TOMBSTONES
+static_assert(sizeof(afh::optional_v2<std::string          >) == sizeof(std::string          ));
+static_assert(sizeof(afh::optional_v2<std::vector<double>  >) == sizeof(std::vector<double>  ));
+static_assert(sizeof(afh::optional_v2<std::unique_ptr<int> >) == sizeof(std::unique_ptr<int> ));
+static_assert(sizeof(afh::optional_v2<std::shared_ptr<int> >) == sizeof(std::shared_ptr<int> ));
+static_assert(sizeof(afh::optional_v2<std::vector<bool>    >) >  sizeof(std::vector<bool>    ));
+#else
+// e.g. with _GLIBCXX_DEBUG, they keep the external tombstone.
+static_assert(sizeof(afh::optional_v2<std::vector<double>  >) >  sizeof(std::vector<double>  ));
+#endif
+
+// An empty T is still a value, a moved from or reset slot is tombstoned and
+// emplacing brings it back.
+template <typename T, typename Make, typename Check>
+void check(Make make, Check check_value)
+{
+    afh::optional_v2<T> empty(T{});
+    assert(empty.has_value());
+
+    afh::optional_v2<T> tombstoned(afh::tombstone_tag{});
+    assert(tombstoned.is_tombstoned());
+
+    afh::optional_v2<T> a(make());
+    assert(a.has_value());
+    check_value(a.value());
+
+    afh::optional_v2<T> b(std::move(a));
+    assert(a.is_tombstoned() && b.has_value());
+    check_value(b.value());
+
+    a = std::move(b);
+    assert(a.has_value() && b.is_tombstoned());
+    check_value(a.value());
+
+    a.reset();
+    assert(a.is_tombstoned());
+    a.emplace(make());
+    assert(a.has_value());
+    check_value(a.value());
+}
+
+int main()
+{
+    check<std::string>(
+        [] { return std::string("short"); },
+        [](std::string const& s) { assert(s == "short"); });
+    check<std::string>(
+        [] { return std::string(100, 'x'); },
+        [](std::string const& s) { assert(s == std::string(100, 'x')); });
+    check<std::wstring>(
+        [] { return std::wstring(40, L'w'); },
+        [](std::wstring const& s) { assert(s == std::wstring(40, L'w')); });
+    check<std::vector<double>>(
+        [] { return std::vector<double>{ 1.0, 2.0, 3.0 }; },
+        [](std::vector<double> const& v) { assert(v.size() == 3 && v[2] == 3.0); });
+    check<std::vector<bool>>(
+        [] { return std::vector<bool>(70, true); },
+        [](std::vector<bool> const& v) { assert(v.size() == 70 && v[69]); });
+    check<std::unique_ptr<int>>(
+        [] { return std::make_unique<int>(42); },
+        [](std::unique_ptr<int> const& p) { assert(p && *p == 42); });
+
+    std::weak_ptr<int> observer;
+    check<std::shared_ptr<int>>(
+        [&observer] { auto p = std::make_shared<int>(7); observer = p; return p; },
+        [&observer](std::shared_ptr<int> const& p) { assert(p && *p == 7 && observer.use_count() == 1); });
+    assert(observer.expired());
+
+    // A default constructed smart pointer is null, but still a value.
+    afh::optional_v2<std::unique_ptr<int>> null(std::unique_ptr<int>{});
+    assert(null.has_value() && !null.value());
+}
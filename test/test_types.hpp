@@ -0,0 +1,75 @@
+#pragma once
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+#ifndef AFH_TEST_TYPES_HPP__
+#define AFH_TEST_TYPES_HPP__
+
+#include <atomic>
+#include <utility>
+
+namespace afh {
+namespace test {
+
+//=============================================================================
+// struct owner;
+//
+//  Owns something until it is moved from, which hands that to the new
+//  object.  owners is the number of objects that own something, so it
+//  stays balanced whether or not a moved from husk is destructed, and is
+//  back to 0 once every owner has been destructed exactly once.  moves counts
+//  the move constructions.
+inline std::atomic<long> owners{ 0 };
+inline std::atomic<long> moves { 0 };
+
+struct owner {
+    int  m_id   = 0;
+    bool m_owns = true;
+
+    owner() noexcept { ++owners; }
+    explicit owner(int id) noexcept : m_id(id) { ++owners; }
+    owner(owner const& other) noexcept : m_id(other.m_id), m_owns(other.m_owns) { if (m_owns) ++owners; }
+    owner(owner&& other) noexcept : m_id(other.m_id), m_owns(std::exchange(other.m_owns, false)) { ++moves; }
+
+    owner& operator=(owner const& other) noexcept
+    {
+        if (this != &other) {
+            release();
+            m_id   = other.m_id;
+            m_owns = other.m_owns;
+            if (m_owns) ++owners;
+        }
+        return *this;
+    }
+
+    owner& operator=(owner&& other) noexcept
+    {
+        if (this != &other) {
+            release();
+            m_id   = other.m_id;
+            m_owns = std::exchange(other.m_owns, false);
+        }
+        return *this;
+    }
+
+    ~owner() { release(); }
+
+private:
+    void release() noexcept
+    {
+        if (std::exchange(m_owns, false)) --owners;
+    }
+};
+
+} // namespace test
+} // namespace afh
+#endif // #ifndef AFH_TEST_TYPES_HPP__
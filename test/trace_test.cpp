@@ -0,0 +1,211 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Checks that a Trace_policy, set in the class or in its traits, is told
+// about each lifecycle event for the right object, and that trace_ring keeps
+// the latest events of each thread in order and can dump them afterwards.
+#include "destructively_movable.hpp"
+#include "relocate.hpp"
+#include "trace_ring.hpp"
+#include "test_types.hpp"
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::trace_event;
+
+    struct event {
+        trace_event          m_event;
+        void const volatile* m_object;
+
+        bool operator==(event const& other) const { return m_event == other.m_event && m_object == other.m_object; }
+    };
+
+    // Records every event it is given.
+    struct recorder
+    {
+        static inline std::vector<event> events;
+        static inline char const*        type = nullptr;
+
+        static void trace(trace_event e, void const volatile* object, char const* name) noexcept
+        {
+            events.push_back({ e, object });
+            type = name;
+        }
+
+        // Returns the events so far and forgets them.
+        static std::vector<event> take() { return std::exchange(events, {}); }
+    };
+
+    // Sets its policy in the class.
+    struct traced {
+        owner m_owner;
+
+        using Trace_policy = recorder;
+
+        explicit traced(int id) noexcept : m_owner(id) {}
+    };
+
+    // Sets its policy in its traits.
+    struct traits_traced {
+        owner m_owner;
+    };
+
+    struct ring_traced {
+        int m_id;
+
+        using Trace_policy = afh::trace_ring<16>;
+
+        explicit ring_traced(int id) noexcept : m_id(id) {}
+        ~ring_traced() {}
+    };
+}
+
+template <>
+struct afh::destructively_movable_traits<traits_traced>
+{
+    using Tombstone_functions = void;
+    using Trace_policy = recorder;
+};
+
+namespace {
+    template <typename T>
+    using slot = afh::optional_v2<T>;
+
+    template <typename T>
+    void const volatile* address(slot<T>& s) { return std::addressof(s); }
+
+    void check_policy()
+    {
+        using E = trace_event;
+        {
+            slot<traced> a(afh::emplace<traced>(1));
+            void const volatile* pa = address(a);
+            assert(recorder::take() == (std::vector<event>{ { E::emplace, pa }, { E::construct, pa } }));
+            assert(recorder::type && std::string(recorder::type).find("traced") != std::string::npos);
+
+            a.reset();
+            assert(recorder::take() == (std::vector<event>{ { E::reset, pa }, { E::tombstone, pa } }));
+
+            a.emplace(2);
+            assert(recorder::take() == (std::vector<event>{ { E::emplace, pa } }));
+
+            // The source of a move is moved out of and tombstoned.
+            slot<traced> b(std::move(a));
+            void const volatile* pb = address(b);
+            assert(recorder::take() == (std::vector<event>{
+                { E::emplace, pb }, { E::move_out, pa }, { E::tombstone, pa }, { E::construct, pb } }));
+
+            traced taken(std::move(b).value());
+            b.has_been_moved();
+            assert(recorder::take() == (std::vector<event>{ { E::move_out, pb }, { E::tombstone, pb } }));
+
+            // A relocation drops the husk left behind.
+            a.emplace(3);
+            recorder::take();
+            alignas(slot<traced>) unsigned char buffer[sizeof(slot<traced>)];
+            auto* c = reinterpret_cast<slot<traced>*>(buffer);
+            afh::relocate_at(std::addressof(a), c);
+            void const volatile* pc = c;
+            assert(recorder::take() == (std::vector<event>{
+                { E::emplace, pc }, { E::move_out, pa }, { E::tombstone, pa }, { E::construct, pc },
+                { E::elided_destruction, pa } }));
+
+            new (std::addressof(a)) slot<traced>(afh::tombstone_tag{});
+            assert(recorder::take() == (std::vector<event>{ { E::construct, pa }, { E::tombstone, pa } }));
+
+            // Destructing a value isn't an event.
+            std::destroy_at(c);
+            assert(recorder::take().empty());
+        }
+        // Both a and b are tombstoned.
+        auto events = recorder::take();
+        assert(events.size() == 2);
+        for (auto& e : events) {
+            assert(e.m_event == trace_event::elided_destruction);
+        }
+        {
+            slot<traits_traced> a(afh::emplace<traits_traced>());
+            assert(recorder::take() == (std::vector<event>{ { E::emplace, address(a) }, { E::construct, address(a) } }));
+        }
+        assert(recorder::take().empty());
+    }
+
+    // Each thread emplaces and resets its own slot cycles times.  Only the
+    // last 16 events of each are kept.
+    void check_ring()
+    {
+        using ring = afh::trace_ring<16>;
+        int const                cycles  = 100;
+        std::size_t const        workers = 3;
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t != workers; ++t) {
+            threads.emplace_back([] {
+                slot<ring_traced> s(afh::tombstone_tag{});
+                for (int i = 0; i < cycles; ++i) {
+                    s.emplace(i);
+                    s.reset();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        auto snapshot = ring::snapshot();
+        // Each thread has a buffer of its own.
+        assert(snapshot.size() == workers);
+        std::size_t records = 0;
+        for (auto& events : snapshot) {
+            assert(events.size() == ring::capacity);
+            records += events.size();
+            // The last event is the slot's elided destruction, after the
+            // emplace, reset and tombstone events of the last cycles.
+            trace_event const cycle[] = { trace_event::emplace, trace_event::reset, trace_event::tombstone };
+            assert(events.back().event == trace_event::elided_destruction);
+            for (std::size_t i = 0; i + 1 < events.size(); ++i) {
+                assert(events[i].event == cycle[i % 3]);
+                assert(events[i].object == events.back().object);
+                assert(events[i].ticks <= events[i + 1].ticks);
+            }
+        }
+        std::ostringstream out;
+        ring::dump(out);
+        std::istringstream in(out.str());
+        std::string line;
+        std::size_t lines = 0;
+        for (; std::getline(in, line); ++lines) {
+            assert(line.find("ring_traced") != std::string::npos);
+        }
+        assert(lines == records);
+        assert(out.str().find("elided_destruction") != std::string::npos);
+
+        ring::clear();
+        for (auto& events : ring::snapshot()) {
+            assert(events.empty());
+        }
+    }
+}
+
+int main()
+{
+    check_policy();
+    check_ring();
+}
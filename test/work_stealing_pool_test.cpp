@@ -0,0 +1,169 @@
+/// \file
+// optional_v2 library
+//
+//  Copyright Adrian Hawryluk 2019.
+//
+//  Use, modification and distribution is subject to the
+//  MIT License. (See accompanying
+//  file LICENSE.txt or copy at
+//  https://opensource.org/licenses/MIT)
+//
+// Project home: https://github.com/Ma-XX-oN/destructive-move
+//
+
+// Stress test for ws_deque and work_stealing_pool.  Build it with
+// -DAFH_TEST_SANITIZER=thread to run it under ThreadSanitizer.
+#include "work_stealing_pool.hpp"
+#include "test_types.hpp"
+#include <atomic>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    using afh::test::owner;
+    using afh::test::owners;
+
+    std::atomic<long> ran{ 0 };
+
+    // Submits two children from inside a task until depth is 0, so 2^depth
+    // leaves run.
+    void spawn(afh::work_stealing_pool<>& pool, int depth)
+    {
+        if (depth == 0) {
+            ++ran;
+            return;
+        }
+        for (int i = 0; i < 2; ++i) {
+            pool.submit([&pool, depth, token = owner()] { spawn(pool, depth - 1); });
+        }
+    }
+
+    // The owner pushes and pops while thieves steal, and every value must be
+    // taken exactly once.
+    void contended_deque()
+    {
+        afh::ws_deque<std::string> deque(8);
+        std::atomic<bool>          done{ false };
+        std::atomic<long>          taken{ 0 };
+        std::vector<std::thread>   thieves;
+        for (int t = 0; t < 3; ++t) {
+            thieves.emplace_back([&] {
+                while (!done) {
+                    auto value = deque.try_steal();
+                    if (value.has_value()) {
+                        taken += std::stol(value.value());
+                    }
+                }
+            });
+        }
+        long expected = 0;
+        for (int i = 0; i < 100000; ) {
+            // Long enough to be heap allocated.
+            if (deque.try_push(std::to_string(i) + std::string(24, ' '))) {
+                expected += i++;
+            }
+            else {
+                auto value = deque.try_pop();
+                if (value.has_value()) {
+                    taken += std::stol(value.value());
+                }
+            }
+        }
+        for (;;) {
+            auto value = deque.try_pop();
+            if (value.has_value()) {
+                taken += std::stol(value.value());
+            }
+            else if (deque.size() == 0) {
+                break;
+            }
+        }
+        done = true;
+        for (auto& thief : thieves) {
+            thief.join();
+        }
+        assert(taken == expected);
+    }
+}
+
+int main()
+{
+    {
+        afh::ws_deque<std::string> deque(4);
+        assert(!deque.try_pop().has_value() && !deque.try_steal().has_value());
+        for (int i = 0; i < 4; ++i) {
+            assert(deque.try_push(std::string(30, char('a' + i))));
+        }
+        assert(!deque.try_push(std::string("full")));
+        assert(deque.try_pop  ().value() == std::string(30, 'd'));
+        assert(deque.try_steal().value() == std::string(30, 'a'));
+        // Destructs the two left.
+    }
+
+    contended_deque();
+
+    // Many workers (more than there are cores here), tasks from outside.
+    {
+        ran = 0;
+        afh::work_stealing_pool<> pool(8, 64);
+        assert(pool.thread_count() == 8);
+        for (int i = 0; i < 20000; ++i) {
+            pool.submit([token = owner()] { ++ran; });
+        }
+        pool.wait_idle();
+        assert(ran == 20000);
+        assert(owners == 0);
+    }
+
+    // Nested submits, with deques small enough to fill up, so that submit()
+    // also runs tasks inline.
+    for (unsigned threads : { 1u, 2u, 4u }) {
+        ran = 0;
+        afh::work_stealing_pool<> pool(threads, 2);
+        for (int i = 0; i < 8; ++i) {
+            pool.submit([&pool] { spawn(pool, 10); });
+        }
+        pool.wait_idle();
+        assert(ran == 8 * 1024);
+        assert(owners == 0);
+    }
+
+    // A full deque runs the task inline, on the submitting worker, before
+    // submit() returns.
+    {
+        afh::work_stealing_pool<> pool(1, 2);
+        std::atomic<bool> done[10] = {};
+        int               inline_runs = 0;
+        pool.submit([&pool, &done, &inline_runs] {
+            for (auto& flag : done) {
+                pool.submit([&flag] { flag = true; });
+                // Only one worker, so a queued task can't have run yet.
+                if (flag) {
+                    ++inline_runs;
+                }
+            }
+        });
+        pool.wait_idle();
+        // The deque holds 2, so the other 8 ran inline.
+        assert(inline_runs == 8);
+        for (auto& flag : done) {
+            assert(flag);
+        }
+    }
+
+    // Destroying the pool with tasks still queued runs them all and destructs
+    // every task.
+    for (int round = 0; round < 20; ++round) {
+        ran = 0;
+        {
+            afh::work_stealing_pool<> pool(4, 16);
+            for (int i = 0; i < 500; ++i) {
+                pool.submit([token = owner()] { ++ran; });
+            }
+        }
+        assert(ran == 500);
+        assert(owners == 0);
+    }
+}